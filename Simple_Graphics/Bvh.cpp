@@ -0,0 +1,751 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#include <emmintrin.h>
+
+//subtrees with more items than this are split across the pool
+static const uint32_t BVH_PARALLEL_ITEMS = 16384;
+//past this depth nodes are split in half instead, which keeps the traversal stacks below from overflowing
+static const uint32_t BVH_MAX_SAH_DEPTH = 64;
+static const int BVH_STACK_SIZE = 128;
+
+static const float BVH_INFINITY = std::numeric_limits<float>::infinity();
+
+struct RayPacket {
+	__m128 originX;
+	__m128 originY;
+	__m128 originZ;
+	__m128 directionX;
+	__m128 directionY;
+	__m128 directionZ;
+	__m128 inverseX;
+	__m128 inverseY;
+	__m128 inverseZ;
+	//closest hit so far, lanes only look for something nearer
+	__m128 distance;
+	__m128 u;
+	__m128 v;
+	__m128i triangle;
+	__m128i instance;
+	//all bits set for the lanes in use
+	__m128 active;
+};
+
+static float surfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+	glm::vec3 size = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+//zero components would make 0 * infinity in the slab tests, a tiny one is as good as parallel
+static glm::vec3 safeInverse(const glm::vec3& direction) {
+	glm::vec3 inverse;
+	for (int axis = 0; axis < 3; axis++) {
+		float component = direction[axis];
+		if (std::fabs(component) < 1e-20f) {
+			component = component < 0.0f ? -1e-20f : 1e-20f;
+		}
+		inverse[axis] = 1.0f / component;
+	}
+
+	return inverse;
+}
+
+/* binned sah over item bounds, shared by both trees. nodes come out with every parent before its children,
+	so refitting can go through them backwards. children are handed out in pairs from an atomic count so
+	subtrees can be built on different workers*/
+class BvhBuilder {
+public:
+	BvhBuilder(const std::vector<glm::vec3>& itemMin, const std::vector<glm::vec3>& itemMax, std::vector<BvhNode>& nodes,
+		std::vector<uint32_t>& order, ThreadPool* pool)
+		: itemMin(itemMin), itemMax(itemMax), nodes(nodes), order(order), pool(pool) {
+	}
+
+	void build() {
+		uint32_t itemCount = static_cast<uint32_t>(itemMin.size());
+
+		order.resize(itemCount);
+		centroids.resize(itemCount);
+		for (uint32_t i = 0; i < itemCount; i++) {
+			order[i] = i;
+			centroids[i] = (itemMin[i] + itemMax[i]) * 0.5f;
+		}
+
+		nodes.clear();
+		if (itemCount == 0) {
+			return;
+		}
+
+		//every leaf has at least one item, so this is the most there can be
+		nodes.resize(2 * size_t(itemCount) - 1);
+		nodeCount = 1;
+		split(0, 0, itemCount, 0);
+		nodes.resize(nodeCount.load());
+	}
+
+private:
+	struct Bin {
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		uint32_t count;
+	};
+
+	void split(uint32_t node, uint32_t begin, uint32_t end, uint32_t depth) {
+		glm::vec3 boundsMin(BVH_INFINITY);
+		glm::vec3 boundsMax(-BVH_INFINITY);
+		glm::vec3 centroidMin(BVH_INFINITY);
+		glm::vec3 centroidMax(-BVH_INFINITY);
+
+		for (uint32_t i = begin; i < end; i++) {
+			uint32_t item = order[i];
+			boundsMin = glm::min(boundsMin, itemMin[item]);
+			boundsMax = glm::max(boundsMax, itemMax[item]);
+			centroidMin = glm::min(centroidMin, centroids[item]);
+			centroidMax = glm::max(centroidMax, centroids[item]);
+		}
+
+		BvhNode& current = nodes[node];
+		current.boundsMin = boundsMin;
+		current.boundsMax = boundsMax;
+		current.first = begin;
+		current.count = end - begin;
+
+		uint32_t count = end - begin;
+		if (count == 1) {
+			return;
+		}
+
+		//small nodes get one bin an item, more would only be empty
+		uint32_t binCount = std::min(BVH_SAH_BINS, count);
+		int bestAxis = -1;
+		uint32_t bestBin = 0;
+		float bestCost = BVH_INFINITY;
+		glm::vec3 extent = centroidMax - centroidMin;
+
+		for (int axis = 0; axis < 3 && depth < BVH_MAX_SAH_DEPTH; axis++) {
+			if (!(extent[axis] > 0.0f)) {
+				continue;
+			}
+
+			Bin bins[BVH_SAH_BINS];
+			for (uint32_t i = 0; i < binCount; i++) {
+				bins[i] = { glm::vec3(BVH_INFINITY), glm::vec3(-BVH_INFINITY), 0 };
+			}
+
+			float scale = binCount / extent[axis];
+			for (uint32_t i = begin; i < end; i++) {
+				uint32_t item = order[i];
+				Bin& bin = bins[binOf(centroids[item][axis], centroidMin[axis], scale, binCount)];
+				bin.boundsMin = glm::min(bin.boundsMin, itemMin[item]);
+				bin.boundsMax = glm::max(bin.boundsMax, itemMax[item]);
+				bin.count++;
+			}
+
+			//cost of everything up to and including bin i on one side, then of everything after it on the other
+			float leftCost[BVH_SAH_BINS];
+			glm::vec3 sweepMin(BVH_INFINITY);
+			glm::vec3 sweepMax(-BVH_INFINITY);
+			uint32_t sweepCount = 0;
+			for (uint32_t i = 0; i < binCount; i++) {
+				sweepMin = glm::min(sweepMin, bins[i].boundsMin);
+				sweepMax = glm::max(sweepMax, bins[i].boundsMax);
+				sweepCount += bins[i].count;
+				leftCost[i] = sweepCount * surfaceArea(sweepMin, sweepMax);
+			}
+
+			sweepMin = glm::vec3(BVH_INFINITY);
+			sweepMax = glm::vec3(-BVH_INFINITY);
+			sweepCount = 0;
+			for (uint32_t i = binCount - 1; i > 0; i--) {
+				sweepMin = glm::min(sweepMin, bins[i].boundsMin);
+				sweepMax = glm::max(sweepMax, bins[i].boundsMax);
+				sweepCount += bins[i].count;
+
+				float cost = leftCost[i - 1] + sweepCount * surfaceArea(sweepMin, sweepMax);
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = i - 1;
+				}
+			}
+		}
+
+		//an inner node costs about as much as testing one more item
+		float area = surfaceArea(boundsMin, boundsMax);
+		if (count <= BVH_LEAF_SIZE && (bestAxis < 0 || bestCost + area >= count * area)) {
+			return;
+		}
+
+		uint32_t middle = begin + count / 2;
+		if (bestAxis >= 0) {
+			float scale = binCount / extent[bestAxis];
+			auto left = std::partition(order.begin() + begin, order.begin() + end, [&](uint32_t item) {
+				return binOf(centroids[item][bestAxis], centroidMin[bestAxis], scale, binCount) <= bestBin;
+			});
+			middle = static_cast<uint32_t>(left - order.begin());
+
+			if (middle == begin || middle == end) {
+				middle = begin + count / 2;
+			}
+		}
+
+		uint32_t children = nodeCount.fetch_add(2);
+		current.first = children;
+		current.count = 0;
+
+		if (pool != nullptr && count > BVH_PARALLEL_ITEMS) {
+			pool->parallelFor(2, 1, [&](size_t first, size_t last) {
+				for (size_t child = first; child < last; child++) {
+					if (child == 0) {
+						split(children, begin, middle, depth + 1);
+					}
+					else {
+						split(children + 1, middle, end, depth + 1);
+					}
+				}
+			});
+		}
+		else {
+			split(children, begin, middle, depth + 1);
+			split(children + 1, middle, end, depth + 1);
+		}
+	}
+
+	static uint32_t binOf(float value, float start, float scale, uint32_t binCount) {
+		float bin = (value - start) * scale;
+		return std::min(static_cast<uint32_t>(std::max(bin, 0.0f)), binCount - 1);
+	}
+
+	const std::vector<glm::vec3>& itemMin;
+	const std::vector<glm::vec3>& itemMax;
+	std::vector<BvhNode>& nodes;
+	std::vector<uint32_t>& order;
+	std::vector<glm::vec3> centroids;
+	ThreadPool* pool;
+	std::atomic<uint32_t> nodeCount{ 0 };
+};
+
+//entry distance into the box, or infinity when the ray misses it or it is further than the closest hit so far
+static float rayEntersBox(const BvhNode& node, const glm::vec3& origin, const glm::vec3& inverse, float distance) {
+	glm::vec3 toMin = (node.boundsMin - origin) * inverse;
+	glm::vec3 toMax = (node.boundsMax - origin) * inverse;
+	glm::vec3 entry = glm::min(toMin, toMax);
+	glm::vec3 exit = glm::max(toMin, toMax);
+
+	float enter = std::max(std::max(entry.x, entry.y), std::max(entry.z, 0.0f));
+	float leave = std::min(std::min(exit.x, exit.y), std::min(exit.z, distance));
+
+	return enter <= leave ? enter : BVH_INFINITY;
+}
+
+//two sided moller trumbore, hit is only written when the triangle is nearer than it
+static bool rayHitsTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3* corner, RayHit& hit) {
+	const glm::vec3& edge1 = corner[1];
+	const glm::vec3& edge2 = corner[2];
+
+	glm::vec3 p = glm::cross(direction, edge2);
+	float determinant = glm::dot(edge1, p);
+	if (determinant == 0.0f) {
+		return false;
+	}
+	float inverse = 1.0f / determinant;
+
+	glm::vec3 s = origin - corner[0];
+	float u = glm::dot(s, p) * inverse;
+	if (u < 0.0f || u > 1.0f) {
+		return false;
+	}
+
+	glm::vec3 q = glm::cross(s, edge1);
+	float v = glm::dot(direction, q) * inverse;
+	if (v < 0.0f || u + v > 1.0f) {
+		return false;
+	}
+
+	float t = glm::dot(edge2, q) * inverse;
+	if (t <= 0.0f || t >= hit.distance) {
+		return false;
+	}
+
+	hit.distance = t;
+	hit.u = u;
+	hit.v = v;
+	return true;
+}
+
+/* the walk both trees share, nearer children are visited first so hits cut off the rest of the tree early.
+	leaf(first, count) tests the items and returns true to stop straight away*/
+template<class Leaf>
+static void traverse(const std::vector<BvhNode>& nodes, const glm::vec3& origin, const glm::vec3& direction, const float& distance, Leaf leaf) {
+	if (nodes.empty()) {
+		return;
+	}
+
+	glm::vec3 inverse = safeInverse(direction);
+	if (rayEntersBox(nodes[0], origin, inverse, distance) == BVH_INFINITY) {
+		return;
+	}
+
+	uint32_t stack[BVH_STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const BvhNode& node = nodes[stack[--top]];
+
+		if (node.count > 0) {
+			if (leaf(node.first, node.count)) {
+				return;
+			}
+			continue;
+		}
+
+		float left = rayEntersBox(nodes[node.first], origin, inverse, distance);
+		float right = rayEntersBox(nodes[node.first + 1], origin, inverse, distance);
+
+		uint32_t nearChild = node.first;
+		uint32_t farChild = node.first + 1;
+		if (right < left) {
+			std::swap(left, right);
+			std::swap(nearChild, farChild);
+		}
+
+		if (right != BVH_INFINITY) {
+			stack[top++] = farChild;
+		}
+		if (left != BVH_INFINITY) {
+			stack[top++] = nearChild;
+		}
+	}
+}
+
+static inline __m128 blend(__m128 mask, __m128 a, __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128i blend(__m128 mask, __m128i a, __m128i b) {
+	__m128i integerMask = _mm_castps_si128(mask);
+	return _mm_or_si128(_mm_and_si128(integerMask, a), _mm_andnot_si128(integerMask, b));
+}
+
+//the lanes that hit the box, entry gets where each of them goes in
+static inline int packetEntersBox(const BvhNode& node, const RayPacket& packet, __m128& entry) {
+	__m128 nearX = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.x), packet.originX), packet.inverseX);
+	__m128 nearY = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.y), packet.originY), packet.inverseY);
+	__m128 nearZ = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.z), packet.originZ), packet.inverseZ);
+	__m128 farX = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.x), packet.originX), packet.inverseX);
+	__m128 farY = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.y), packet.originY), packet.inverseY);
+	__m128 farZ = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.z), packet.originZ), packet.inverseZ);
+
+	__m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(nearX, farX), _mm_min_ps(nearY, farY)), _mm_max_ps(_mm_min_ps(nearZ, farZ), _mm_setzero_ps()));
+	__m128 leave = _mm_min_ps(_mm_min_ps(_mm_max_ps(nearX, farX), _mm_max_ps(nearY, farY)), _mm_min_ps(_mm_max_ps(nearZ, farZ), packet.distance));
+
+	__m128 hits = _mm_and_ps(_mm_cmple_ps(enter, leave), packet.active);
+	entry = blend(hits, enter, _mm_set1_ps(BVH_INFINITY));
+
+	return _mm_movemask_ps(hits);
+}
+
+static inline float nearestLane(__m128 values) {
+	values = _mm_min_ps(values, _mm_shuffle_ps(values, values, _MM_SHUFFLE(2, 3, 0, 1)));
+	values = _mm_min_ps(values, _mm_shuffle_ps(values, values, _MM_SHUFFLE(1, 0, 3, 2)));
+	return _mm_cvtss_f32(values);
+}
+
+//the same as rayHitsTriangle for every lane
+static inline void packetHitsTriangle(RayPacket& packet, const glm::vec3* corner, uint32_t triangle) {
+	__m128 edge1X = _mm_set1_ps(corner[1].x);
+	__m128 edge1Y = _mm_set1_ps(corner[1].y);
+	__m128 edge1Z = _mm_set1_ps(corner[1].z);
+	__m128 edge2X = _mm_set1_ps(corner[2].x);
+	__m128 edge2Y = _mm_set1_ps(corner[2].y);
+	__m128 edge2Z = _mm_set1_ps(corner[2].z);
+
+	__m128 pX = _mm_sub_ps(_mm_mul_ps(packet.directionY, edge2Z), _mm_mul_ps(packet.directionZ, edge2Y));
+	__m128 pY = _mm_sub_ps(_mm_mul_ps(packet.directionZ, edge2X), _mm_mul_ps(packet.directionX, edge2Z));
+	__m128 pZ = _mm_sub_ps(_mm_mul_ps(packet.directionX, edge2Y), _mm_mul_ps(packet.directionY, edge2X));
+
+	__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, pX), _mm_mul_ps(edge1Y, pY)), _mm_mul_ps(edge1Z, pZ));
+	__m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+	__m128 sX = _mm_sub_ps(packet.originX, _mm_set1_ps(corner[0].x));
+	__m128 sY = _mm_sub_ps(packet.originY, _mm_set1_ps(corner[0].y));
+	__m128 sZ = _mm_sub_ps(packet.originZ, _mm_set1_ps(corner[0].z));
+
+	__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sX, pX), _mm_mul_ps(sY, pY)), _mm_mul_ps(sZ, pZ)), inverse);
+
+	__m128 qX = _mm_sub_ps(_mm_mul_ps(sY, edge1Z), _mm_mul_ps(sZ, edge1Y));
+	__m128 qY = _mm_sub_ps(_mm_mul_ps(sZ, edge1X), _mm_mul_ps(sX, edge1Z));
+	__m128 qZ = _mm_sub_ps(_mm_mul_ps(sX, edge1Y), _mm_mul_ps(sY, edge1X));
+
+	__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(packet.directionX, qX), _mm_mul_ps(packet.directionY, qY)), _mm_mul_ps(packet.directionZ, qZ)), inverse);
+	__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qX), _mm_mul_ps(edge2Y, qY)), _mm_mul_ps(edge2Z, qZ)), inverse);
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 hit = _mm_and_ps(packet.active, _mm_cmpneq_ps(determinant, zero));
+	hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+	hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+	hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, packet.distance)));
+
+	if (_mm_movemask_ps(hit) == 0) {
+		return;
+	}
+
+	packet.distance = blend(hit, t, packet.distance);
+	packet.u = blend(hit, u, packet.u);
+	packet.v = blend(hit, v, packet.v);
+	packet.triangle = blend(hit, _mm_set1_epi32(static_cast<int>(triangle)), packet.triangle);
+}
+
+//the packet version of traverse, a node is visited when any lane still in the search enters it
+template<class Leaf>
+static void traversePacket(const std::vector<BvhNode>& nodes, RayPacket& packet, Leaf leaf) {
+	if (nodes.empty()) {
+		return;
+	}
+
+	__m128 entry;
+	if (packetEntersBox(nodes[0], packet, entry) == 0) {
+		return;
+	}
+
+	uint32_t stack[BVH_STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const BvhNode& node = nodes[stack[--top]];
+
+		if (node.count > 0) {
+			leaf(node.first, node.count);
+			continue;
+		}
+
+		__m128 leftEntry;
+		__m128 rightEntry;
+		int left = packetEntersBox(nodes[node.first], packet, leftEntry);
+		int right = packetEntersBox(nodes[node.first + 1], packet, rightEntry);
+
+		//nearest by the nearest lane, the lanes mostly agree in a coherent packet
+		bool rightFirst = right != 0 && (left == 0 || nearestLane(rightEntry) < nearestLane(leftEntry));
+		uint32_t nearChild = rightFirst ? node.first + 1 : node.first;
+		uint32_t farChild = rightFirst ? node.first : node.first + 1;
+		int nearMask = rightFirst ? right : left;
+		int farMask = rightFirst ? left : right;
+
+		if (farMask != 0) {
+			stack[top++] = farChild;
+		}
+		if (nearMask != 0) {
+			stack[top++] = nearChild;
+		}
+	}
+}
+
+static RayPacket makePacket(const Ray* rays, const RayHit* hits, uint32_t count) {
+	alignas(16) float values[10][4] = {};
+	alignas(16) uint32_t active[4] = {};
+
+	for (uint32_t lane = 0; lane < 4; lane++) {
+		//unused lanes copy the first so they stay finite
+		const Ray& ray = rays[lane < count ? lane : 0];
+		glm::vec3 inverse = safeInverse(ray.direction);
+
+		for (int axis = 0; axis < 3; axis++) {
+			values[axis][lane] = ray.origin[axis];
+			values[3 + axis][lane] = ray.direction[axis];
+			values[6 + axis][lane] = inverse[axis];
+		}
+		values[9][lane] = lane < count ? hits[lane].distance : 0.0f;
+		active[lane] = lane < count ? ~0u : 0u;
+	}
+
+	RayPacket packet;
+	packet.originX = _mm_load_ps(values[0]);
+	packet.originY = _mm_load_ps(values[1]);
+	packet.originZ = _mm_load_ps(values[2]);
+	packet.directionX = _mm_load_ps(values[3]);
+	packet.directionY = _mm_load_ps(values[4]);
+	packet.directionZ = _mm_load_ps(values[5]);
+	packet.inverseX = _mm_load_ps(values[6]);
+	packet.inverseY = _mm_load_ps(values[7]);
+	packet.inverseZ = _mm_load_ps(values[8]);
+	packet.distance = _mm_load_ps(values[9]);
+	packet.u = _mm_setzero_ps();
+	packet.v = _mm_setzero_ps();
+	packet.triangle = _mm_set1_epi32(-1);
+	packet.instance = _mm_set1_epi32(-1);
+	packet.active = _mm_castsi128_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(active)));
+
+	return packet;
+}
+
+MeshBvh::MeshBvh(const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, ThreadPool* pool) {
+	size_t triangleCount = indexCount / 3;
+
+	auto position = [&](uint32_t vertex) {
+		const float* p = reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + vertex * positionStride);
+		return glm::vec3(p[0], p[1], p[2]);
+	};
+
+	std::vector<glm::vec3> triangleMin(triangleCount);
+	std::vector<glm::vec3> triangleMax(triangleCount);
+	for (size_t i = 0; i < triangleCount; i++) {
+		glm::vec3 a = position(indices[i * 3 + 0]);
+		glm::vec3 b = position(indices[i * 3 + 1]);
+		glm::vec3 c = position(indices[i * 3 + 2]);
+
+		triangleMin[i] = glm::min(a, glm::min(b, c));
+		triangleMax[i] = glm::max(a, glm::max(b, c));
+	}
+
+	BvhBuilder(triangleMin, triangleMax, nodes, triangleNumbers, pool).build();
+
+	corners.resize(triangleCount * 3);
+	for (size_t i = 0; i < triangleCount; i++) {
+		const uint32_t* triangle = indices + size_t(triangleNumbers[i]) * 3;
+		glm::vec3 a = position(triangle[0]);
+
+		corners[i * 3 + 0] = a;
+		corners[i * 3 + 1] = position(triangle[1]) - a;
+		corners[i * 3 + 2] = position(triangle[2]) - a;
+	}
+}
+
+glm::vec3 MeshBvh::boundsMin() const {
+	return nodes.empty() ? glm::vec3(0.0f) : nodes[0].boundsMin;
+}
+
+glm::vec3 MeshBvh::boundsMax() const {
+	return nodes.empty() ? glm::vec3(0.0f) : nodes[0].boundsMax;
+}
+
+bool MeshBvh::intersect(const Ray& ray, RayHit& hit) const {
+	bool found = false;
+
+	traverse(nodes, ray.origin, ray.direction, hit.distance, [&](uint32_t first, uint32_t count) {
+		for (uint32_t i = first; i < first + count; i++) {
+			if (rayHitsTriangle(ray.origin, ray.direction, &corners[size_t(i) * 3], hit)) {
+				hit.triangle = triangleNumbers[i];
+				found = true;
+			}
+		}
+		return false;
+	});
+
+	return found;
+}
+
+bool MeshBvh::occluded(const Ray& ray) const {
+	RayHit hit = { ray.maxDistance, ~0u, ~0u, 0.0f, 0.0f };
+	bool found = false;
+
+	traverse(nodes, ray.origin, ray.direction, hit.distance, [&](uint32_t first, uint32_t count) {
+		for (uint32_t i = first; i < first + count && !found; i++) {
+			found = rayHitsTriangle(ray.origin, ray.direction, &corners[size_t(i) * 3], hit);
+		}
+		return found;
+	});
+
+	return found;
+}
+
+void MeshBvh::intersectPacket(RayPacket& packet) const {
+	traversePacket(nodes, packet, [&](uint32_t first, uint32_t count) {
+		for (uint32_t i = first; i < first + count; i++) {
+			packetHitsTriangle(packet, &corners[size_t(i) * 3], triangleNumbers[i]);
+		}
+	});
+}
+
+//world bounds of every instance, the mesh's box with all 8 corners moved
+void SceneBvh::updateInstances(const std::vector<BvhInstance>& placed) {
+	instances.resize(placed.size());
+	instanceMin.resize(placed.size());
+	instanceMax.resize(placed.size());
+
+	for (size_t i = 0; i < placed.size(); i++) {
+		const BvhInstance& instance = placed[i];
+		instances[i].mesh = instance.mesh;
+		instances[i].inverse = glm::inverse(instance.transform);
+
+		if (instance.mesh == nullptr || instance.mesh->triangleCount() == 0) {
+			//a point where it is, never entered by the walk since nothing is tested inside
+			instanceMin[i] = instanceMax[i] = glm::vec3(instance.transform[3]);
+			continue;
+		}
+
+		glm::vec3 localMin = instance.mesh->boundsMin();
+		glm::vec3 localMax = instance.mesh->boundsMax();
+		glm::vec3 worldMin(BVH_INFINITY);
+		glm::vec3 worldMax(-BVH_INFINITY);
+
+		for (int corner = 0; corner < 8; corner++) {
+			glm::vec3 local((corner & 1) ? localMax.x : localMin.x, (corner & 2) ? localMax.y : localMin.y, (corner & 4) ? localMax.z : localMin.z);
+			glm::vec3 world = glm::vec3(instance.transform * glm::vec4(local, 1.0f));
+			worldMin = glm::min(worldMin, world);
+			worldMax = glm::max(worldMax, world);
+		}
+
+		instanceMin[i] = worldMin;
+		instanceMax[i] = worldMax;
+	}
+}
+
+void SceneBvh::build(const std::vector<BvhInstance>& placed, ThreadPool* pool) {
+	updateInstances(placed);
+	BvhBuilder(instanceMin, instanceMax, nodes, order, pool).build();
+}
+
+void SceneBvh::refit(const std::vector<BvhInstance>& placed) {
+	if (placed.size() != instances.size()) {
+		build(placed);
+		return;
+	}
+
+	updateInstances(placed);
+
+	//children always come after their parent
+	for (size_t i = nodes.size(); i-- > 0;) {
+		BvhNode& node = nodes[i];
+
+		if (node.count > 0) {
+			node.boundsMin = glm::vec3(BVH_INFINITY);
+			node.boundsMax = glm::vec3(-BVH_INFINITY);
+
+			for (uint32_t item = node.first; item < node.first + node.count; item++) {
+				node.boundsMin = glm::min(node.boundsMin, instanceMin[order[item]]);
+				node.boundsMax = glm::max(node.boundsMax, instanceMax[order[item]]);
+			}
+		}
+		else {
+			node.boundsMin = glm::min(nodes[node.first].boundsMin, nodes[node.first + 1].boundsMin);
+			node.boundsMax = glm::max(nodes[node.first].boundsMax, nodes[node.first + 1].boundsMax);
+		}
+	}
+}
+
+RayHit SceneBvh::intersect(const Ray& ray) const {
+	RayHit hit = { ray.maxDistance, ~0u, ~0u, 0.0f, 0.0f };
+
+	traverse(nodes, ray.origin, ray.direction, hit.distance, [&](uint32_t first, uint32_t count) {
+		for (uint32_t item = first; item < first + count; item++) {
+			uint32_t index = order[item];
+			const Instance& instance = instances[index];
+			if (instance.mesh == nullptr) {
+				continue;
+			}
+
+			Ray local = ray;
+			local.origin = glm::vec3(instance.inverse * glm::vec4(ray.origin, 1.0f));
+			local.direction = glm::vec3(instance.inverse * glm::vec4(ray.direction, 0.0f));
+
+			if (instance.mesh->intersect(local, hit)) {
+				hit.instance = index;
+			}
+		}
+		return false;
+	});
+
+	return hit;
+}
+
+bool SceneBvh::occluded(const Ray& ray) const {
+	float distance = ray.maxDistance;
+	bool found = false;
+
+	traverse(nodes, ray.origin, ray.direction, distance, [&](uint32_t first, uint32_t count) {
+		for (uint32_t item = first; item < first + count && !found; item++) {
+			const Instance& instance = instances[order[item]];
+			if (instance.mesh == nullptr) {
+				continue;
+			}
+
+			Ray local = ray;
+			local.origin = glm::vec3(instance.inverse * glm::vec4(ray.origin, 1.0f));
+			local.direction = glm::vec3(instance.inverse * glm::vec4(ray.direction, 0.0f));
+			found = instance.mesh->occluded(local);
+		}
+		return found;
+	});
+
+	return found;
+}
+
+void SceneBvh::intersect4(const Ray* rays, RayHit* hits, uint32_t count) const {
+	count = std::min(count, 4u);
+	for (uint32_t lane = 0; lane < count; lane++) {
+		hits[lane] = { rays[lane].maxDistance, ~0u, ~0u, 0.0f, 0.0f };
+	}
+	if (count == 0) {
+		return;
+	}
+
+	RayPacket packet = makePacket(rays, hits, count);
+
+	traversePacket(nodes, packet, [&](uint32_t first, uint32_t leafCount) {
+		for (uint32_t item = first; item < first + leafCount; item++) {
+			uint32_t index = order[item];
+			const Instance& instance = instances[index];
+			if (instance.mesh == nullptr) {
+				continue;
+			}
+
+			//every lane moved into the mesh's space, origins as points and directions as vectors
+			const glm::mat4& m = instance.inverse;
+			RayPacket local = packet;
+			local.originX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][0]), packet.originX), _mm_mul_ps(_mm_set1_ps(m[1][0]), packet.originY)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2][0]), packet.originZ), _mm_set1_ps(m[3][0])));
+			local.originY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][1]), packet.originX), _mm_mul_ps(_mm_set1_ps(m[1][1]), packet.originY)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2][1]), packet.originZ), _mm_set1_ps(m[3][1])));
+			local.originZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][2]), packet.originX), _mm_mul_ps(_mm_set1_ps(m[1][2]), packet.originY)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2][2]), packet.originZ), _mm_set1_ps(m[3][2])));
+			local.directionX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][0]), packet.directionX), _mm_mul_ps(_mm_set1_ps(m[1][0]), packet.directionY)),
+				_mm_mul_ps(_mm_set1_ps(m[2][0]), packet.directionZ));
+			local.directionY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][1]), packet.directionX), _mm_mul_ps(_mm_set1_ps(m[1][1]), packet.directionY)),
+				_mm_mul_ps(_mm_set1_ps(m[2][1]), packet.directionZ));
+			local.directionZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][2]), packet.directionX), _mm_mul_ps(_mm_set1_ps(m[1][2]), packet.directionY)),
+				_mm_mul_ps(_mm_set1_ps(m[2][2]), packet.directionZ));
+
+			//same as safeInverse, a tiny component is as good as a zero one
+			__m128 tiny = _mm_set1_ps(1e-20f);
+			__m128 signMask = _mm_set1_ps(-0.0f);
+			__m128* directions[3] = { &local.directionX, &local.directionY, &local.directionZ };
+			__m128* inverses[3] = { &local.inverseX, &local.inverseY, &local.inverseZ };
+			for (int axis = 0; axis < 3; axis++) {
+				__m128 direction = *directions[axis];
+				__m128 magnitude = _mm_andnot_ps(signMask, direction);
+				__m128 clamped = _mm_or_ps(_mm_max_ps(magnitude, tiny), _mm_and_ps(signMask, direction));
+				*inverses[axis] = _mm_div_ps(_mm_set1_ps(1.0f), clamped);
+			}
+
+			instance.mesh->intersectPacket(local);
+
+			//distances along the rays are the same in both spaces, so the lanes that got nearer take the hit
+			__m128 nearer = _mm_cmplt_ps(local.distance, packet.distance);
+			packet.distance = blend(nearer, local.distance, packet.distance);
+			packet.u = blend(nearer, local.u, packet.u);
+			packet.v = blend(nearer, local.v, packet.v);
+			packet.triangle = blend(nearer, local.triangle, packet.triangle);
+			packet.instance = blend(nearer, _mm_set1_epi32(static_cast<int>(index)), packet.instance);
+		}
+	});
+
+	alignas(16) float distance[4];
+	alignas(16) float u[4];
+	alignas(16) float v[4];
+	alignas(16) uint32_t triangle[4];
+	alignas(16) uint32_t instance[4];
+	_mm_store_ps(distance, packet.distance);
+	_mm_store_ps(u, packet.u);
+	_mm_store_ps(v, packet.v);
+	_mm_store_si128(reinterpret_cast<__m128i*>(triangle), packet.triangle);
+	_mm_store_si128(reinterpret_cast<__m128i*>(instance), packet.instance);
+
+	for (uint32_t lane = 0; lane < count; lane++) {
+		hits[lane] = { distance[lane], instance[lane], triangle[lane], u[lane], v[lane] };
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ThreadPool.h"
+
+/* bounding volume hierarchies for ray queries on the cpu, for picking, collision and visibility.
+	MeshBvh holds one mesh's triangles in the mesh's own space, SceneBvh holds placed instances of meshes and is refit as they move.
+	both are built with binned sah, and rays are traced either one at a time or four at once with sse sharing one walk of the tree*/
+
+//most triangles or instances in a leaf
+static const uint32_t BVH_LEAF_SIZE = 4;
+//buckets the sah cost is evaluated over along each axis
+static const uint32_t BVH_SAH_BINS = 16;
+
+struct Ray {
+	glm::vec3 origin;
+	//does not have to be normalized, hit distances are in multiples of it
+	glm::vec3 direction;
+	float maxDistance;
+};
+
+//instance and triangle are ~0u when nothing was hit
+struct RayHit {
+	float distance;
+	uint32_t instance;
+	uint32_t triangle;
+	//barycentrics, the weights of the triangle's second and third corners
+	float u;
+	float v;
+};
+
+struct BvhNode {
+	glm::vec3 boundsMin;
+	//inner nodes have their children here and right after, leaves their first item
+	uint32_t first;
+	glm::vec3 boundsMax;
+	//items in a leaf, 0 for inner nodes
+	uint32_t count;
+};
+
+//sse rays the packet walks use, only the .cpp needs to see inside
+struct RayPacket;
+
+class MeshBvh {
+public:
+	/* over a triangle list, positions are 3 floats positionStride bytes apart. the triangles are copied in the order
+		the leaves use them, so the mesh does not have to stay around. big subtrees are built across the pool if one is given*/
+	MeshBvh(const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, ThreadPool* pool = nullptr);
+
+	//closest hit nearer than hit.distance, which is where the search stops. triangle numbers are the mesh's own
+	bool intersect(const Ray& ray, RayHit& hit) const;
+	bool occluded(const Ray& ray) const;
+
+	size_t nodeCount() const { return nodes.size(); }
+	size_t triangleCount() const { return triangleNumbers.size(); }
+	//of everything, in the mesh's space
+	glm::vec3 boundsMin() const;
+	glm::vec3 boundsMax() const;
+
+private:
+	friend class SceneBvh;
+
+	void intersectPacket(RayPacket& packet) const;
+
+	std::vector<BvhNode> nodes;
+	//first corner then the two edges from it, three to a triangle
+	std::vector<glm::vec3> corners;
+	std::vector<uint32_t> triangleNumbers;
+};
+
+//a mesh placed in the scene, instances with no mesh are never hit
+struct BvhInstance {
+	const MeshBvh* mesh;
+	glm::mat4 transform;
+};
+
+class SceneBvh {
+public:
+	//sah over the instances' bounds in world space, hits give the instance's place in the vector
+	void build(const std::vector<BvhInstance>& instances, ThreadPool* pool = nullptr);
+	/* new transforms for the instances the tree was built with, only the bounds are updated so it costs far less than a build.
+		the tree gets worse the further things move from where they were when it was built*/
+	void refit(const std::vector<BvhInstance>& instances);
+
+	RayHit intersect(const Ray& ray) const;
+	//four rays sharing one walk of the tree, only the first count are read and written
+	void intersect4(const Ray* rays, RayHit* hits, uint32_t count) const;
+	bool occluded(const Ray& ray) const;
+
+	size_t size() const { return instances.size(); }
+
+private:
+	struct Instance {
+		const MeshBvh* mesh;
+		//takes world space rays into the mesh's space, distances along them stay the same
+		glm::mat4 inverse;
+	};
+
+	void updateInstances(const std::vector<BvhInstance>& placed);
+
+	std::vector<Instance> instances;
+	std::vector<glm::vec3> instanceMin;
+	std::vector<glm::vec3> instanceMax;
+	std::vector<BvhNode> nodes;
+	//instance numbers in the order the leaves use them
+	std::vector<uint32_t> order;
+};
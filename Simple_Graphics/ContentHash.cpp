@@ -0,0 +1,23 @@
+#include "ContentHash.h"
+
+#include "MappedFile.h"
+
+static const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+static const uint64_t FNV_PRIME = 1099511628211ull;
+
+uint64_t hashBytes(const unsigned char* data, size_t size) {
+	uint64_t hash = FNV_OFFSET_BASIS;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+uint64_t hashFileContents(const std::string& path) {
+	MappedFile file(path);
+
+	return hashBytes(file.data(), file.size());
+}
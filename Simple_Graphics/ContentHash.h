@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//64 bit fnv-1a, not for anything adversarial, just to tell when two files hold the same bytes
+uint64_t hashBytes(const unsigned char* data, size_t size);
+
+//hashes the whole file through a mapping, throws if it cannot be opened
+uint64_t hashFileContents(const std::string& path);
@@ -0,0 +1,111 @@
+#include "KtxTexture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+//the fixed part at the front of every ktx2 file, the identifier is kept in it so the 64 bit fields land aligned
+struct Ktx2Header {
+	unsigned char identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+
+struct Ktx2LevelIndex {
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+static_assert(sizeof(Ktx2Header) == 80, "ktx2 header has to match the file layout");
+static_assert(sizeof(Ktx2LevelIndex) == 24, "ktx2 level index has to match the file layout");
+
+bool hasKtx2Extension(const std::string& path) {
+	static const std::string extension = ".ktx2";
+
+	return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+KtxTexture loadKtx2(const std::string& path) {
+	KtxTexture texture;
+	texture.file = MappedFile(path);
+
+	const unsigned char* data = texture.file.data();
+	size_t size = texture.file.size();
+
+	Ktx2Header header;
+
+	if (size < sizeof(header)) {
+		throw std::runtime_error(path + " is not a ktx2 file!");
+	}
+
+	memcpy(&header, data, sizeof(header));
+
+	if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+		throw std::runtime_error(path + " is not a ktx2 file!");
+	}
+
+	//basis and zstd both need a decoder that is not part of this project, the levels have to be stored as they are
+	if (header.supercompressionScheme != 0) {
+		throw std::runtime_error(path + " uses supercompression, only uncompressed ktx2 levels can be loaded!");
+	}
+
+	//undefined is what basis universal files use, they need transcoding first
+	if (header.vkFormat == 0) {
+		throw std::runtime_error(path + " has no vulkan format!");
+	}
+
+	if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1) {
+		throw std::runtime_error(path + " is not a single 2d texture!");
+	}
+
+	texture.vkFormat = header.vkFormat;
+	texture.width = header.pixelWidth;
+	texture.height = header.pixelHeight;
+
+	//0 asks for the mips to be generated at load, only the base level is in the file then
+	uint32_t levelCount = std::max(header.levelCount, 1u);
+	if (levelCount > mipLevelCount(texture.width, texture.height)) {
+		throw std::runtime_error(path + " has more levels than its size allows!");
+	}
+
+	size_t levelIndexOffset = sizeof(Ktx2Header);
+	if (levelIndexOffset + levelCount * sizeof(Ktx2LevelIndex) > size) {
+		throw std::runtime_error(path + " is truncated!");
+	}
+
+	for (uint32_t i = 0; i < levelCount; i++) {
+		Ktx2LevelIndex levelIndex;
+		memcpy(&levelIndex, data + levelIndexOffset + i * sizeof(Ktx2LevelIndex), sizeof(levelIndex));
+
+		if (levelIndex.byteLength == 0 || levelIndex.byteOffset > size || levelIndex.byteLength > size - levelIndex.byteOffset) {
+			throw std::runtime_error(path + " is truncated!");
+		}
+
+		MipLevel level;
+		level.offset = static_cast<size_t>(levelIndex.byteOffset);
+		level.size = static_cast<size_t>(levelIndex.byteLength);
+		level.width = std::max(texture.width >> i, 1u);
+		level.height = std::max(texture.height >> i, 1u);
+
+		texture.levels.push_back(level);
+	}
+
+	return texture;
+}
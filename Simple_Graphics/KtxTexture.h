@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "TextureProcessing.h"
+
+/* a ktx2 texture is uploaded exactly as it is stored, in whatever format it was written in.
+	the level offsets point straight into the mapped file, so nothing is decoded or copied to get it ready*/
+struct KtxTexture {
+	MappedFile file;
+	//a VkFormat, kept as the raw value so this does not need the vulkan headers
+	uint32_t vkFormat = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<MipLevel> levels;
+};
+
+bool hasKtx2Extension(const std::string& path);
+
+//throws if the file is missing, is not ktx2, or needs something this loader does not do (supercompression, arrays, cubemaps, 3d)
+KtxTexture loadKtx2(const std::string& path);
@@ -0,0 +1,128 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("failed to open " + path + "!");
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		throw std::runtime_error("failed to get the size of " + path + "!");
+	}
+
+	//an empty file cannot be mapped, it is just left as an empty view
+	if (fileSize.QuadPart > 0) {
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		if (mapping != nullptr) {
+			view = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			//the view keeps the mapping alive on its own
+			CloseHandle(mapping);
+		}
+
+		if (view == nullptr) {
+			CloseHandle(file);
+			throw std::runtime_error("failed to map " + path + "!");
+		}
+
+		length = static_cast<size_t>(fileSize.QuadPart);
+	}
+
+	CloseHandle(file);
+}
+
+void MappedFile::unmap() {
+	if (view != nullptr) {
+		UnmapViewOfFile(view);
+	}
+}
+
+void MappedFile::prefetch() const {
+	if (view != nullptr) {
+		WIN32_MEMORY_RANGE_ENTRY range = { const_cast<unsigned char*>(view), length };
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	}
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+	int file = open(path.c_str(), O_RDONLY);
+
+	if (file < 0) {
+		throw std::runtime_error("failed to open " + path + "!");
+	}
+
+	struct stat fileInfo;
+	if (fstat(file, &fileInfo) != 0) {
+		close(file);
+		throw std::runtime_error("failed to get the size of " + path + "!");
+	}
+
+	//an empty file cannot be mapped, it is just left as an empty view
+	if (fileInfo.st_size > 0) {
+		void* mapped = mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+
+		if (mapped == MAP_FAILED) {
+			close(file);
+			throw std::runtime_error("failed to map " + path + "!");
+		}
+
+		view = static_cast<const unsigned char*>(mapped);
+		length = static_cast<size_t>(fileInfo.st_size);
+	}
+
+	//the mapping stays valid after the descriptor is closed
+	close(file);
+}
+
+void MappedFile::unmap() {
+	if (view != nullptr) {
+		munmap(const_cast<unsigned char*>(view), length);
+	}
+}
+
+void MappedFile::prefetch() const {
+	if (view != nullptr) {
+		madvise(const_cast<unsigned char*>(view), length, MADV_WILLNEED);
+	}
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+	unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	: view(std::exchange(other.view, nullptr)), length(std::exchange(other.length, 0)) {
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		unmap();
+		view = std::exchange(other.view, nullptr);
+		length = std::exchange(other.length, 0);
+	}
+
+	return *this;
+}
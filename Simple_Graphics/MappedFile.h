@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/* read only view of a whole file. the os pages it in as it is touched,
+	so nothing is read or copied up front and the pages can go straight into a staging buffer*/
+class MappedFile {
+public:
+	MappedFile() = default;
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	//asks the os to start reading the pages in the background, worth doing on a worker before the main thread copies
+	void prefetch() const;
+
+	const unsigned char* data() const {
+		return view;
+	}
+
+	size_t size() const {
+		return length;
+	}
+
+private:
+	void unmap();
+
+	const unsigned char* view = nullptr;
+	size_t length = 0;
+};
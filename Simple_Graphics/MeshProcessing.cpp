@@ -0,0 +1,875 @@
+#include "MeshProcessing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+static const uint32_t UNUSED = ~0u;
+
+/* the cache is a fifo, so a vertex is still in it while fewer than cacheSize misses have happened since it went in.
+	cacheTime holds the miss count when each vertex last went in, starting timestamp past cacheSize makes every vertex a miss*/
+struct FifoCache {
+	std::vector<uint32_t> cacheTime;
+	uint32_t timestamp;
+	uint32_t cacheSize;
+
+	FifoCache(size_t vertexCount, uint32_t size) : cacheTime(vertexCount, 0), timestamp(size + 1), cacheSize(size) {
+	}
+
+	bool contains(uint32_t vertex) const {
+		return timestamp - cacheTime[vertex] <= cacheSize;
+	}
+
+	//true if the vertex had to be transformed
+	bool access(uint32_t vertex) {
+		if (contains(vertex)) {
+			return false;
+		}
+
+		cacheTime[vertex] = timestamp++;
+		return true;
+	}
+
+	void clear() {
+		timestamp += cacheSize + 1;
+	}
+};
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize) {
+	VertexCacheStats stats = {};
+
+	if (indices.empty()) {
+		return stats;
+	}
+
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> referenced(vertexCount, false);
+	size_t transformed = 0;
+	size_t uniqueVertices = 0;
+
+	for (uint32_t index : indices) {
+		if (cache.access(index)) {
+			transformed++;
+		}
+
+		if (!referenced[index]) {
+			referenced[index] = true;
+			uniqueVertices++;
+		}
+	}
+
+	stats.acmr = static_cast<float>(transformed) / (indices.size() / 3);
+	stats.atvr = static_cast<float>(transformed) / uniqueVertices;
+
+	return stats;
+}
+
+std::vector<uint32_t> optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize) {
+	size_t triangleCount = indices.size() / 3;
+	std::vector<uint32_t> clusters;
+
+	//triangles around each vertex, and how many of them are still to be emitted
+	std::vector<uint32_t> live(vertexCount, 0);
+	for (uint32_t index : indices) {
+		live[index]++;
+	}
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) {
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + live[v];
+	}
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++) {
+		adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	size_t cursor = 0;
+	bool jumped = false;
+
+	//recently used vertices first, only when none of those have triangles left does it move on through the input
+	auto skipDeadEnd = [&]() -> uint32_t {
+		while (!deadEnd.empty()) {
+			uint32_t vertex = deadEnd.back();
+			deadEnd.pop_back();
+
+			if (live[vertex] > 0) {
+				return vertex;
+			}
+		}
+
+		while (cursor < vertexCount) {
+			if (live[cursor] > 0) {
+				jumped = true;
+				return static_cast<uint32_t>(cursor++);
+			}
+			cursor++;
+		}
+
+		return UNUSED;
+	};
+
+	uint32_t fanning = skipDeadEnd();
+
+	while (fanning != UNUSED) {
+		if (jumped) {
+			clusters.push_back(static_cast<uint32_t>(output.size() / 3));
+			jumped = false;
+		}
+
+		candidates.clear();
+
+		//emit every triangle left around the fanning vertex
+		for (uint32_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++) {
+			uint32_t triangle = adjacency[a];
+
+			if (emitted[triangle]) {
+				continue;
+			}
+
+			for (int corner = 0; corner < 3; corner++) {
+				uint32_t vertex = indices[triangle * 3 + corner];
+
+				output.push_back(vertex);
+				deadEnd.push_back(vertex);
+				candidates.push_back(vertex);
+
+				live[vertex]--;
+				cache.access(vertex);
+			}
+
+			emitted[triangle] = true;
+		}
+
+		//the oldest neighbour that will still be in the cache once all of its own triangles are out
+		uint32_t next = UNUSED;
+		int64_t bestPriority = -1;
+
+		for (uint32_t vertex : candidates) {
+			if (live[vertex] == 0) {
+				continue;
+			}
+
+			int64_t priority = 0;
+			uint32_t age = cache.timestamp - cache.cacheTime[vertex];
+
+			if (age + 2 * live[vertex] <= cacheSize) {
+				priority = age;
+			}
+
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+
+		fanning = next != UNUSED ? next : skipDeadEnd();
+	}
+
+	indices.swap(output);
+	return clusters;
+}
+
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<uint32_t>& clusters, const float* positions, size_t positionStride,
+	size_t vertexCount, float acmrThreshold, uint32_t cacheSize) {
+	size_t triangleCount = indices.size() / 3;
+
+	if (triangleCount == 0) {
+		return;
+	}
+
+	auto position = [&](uint32_t vertex, int axis) {
+		return *reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + vertex * positionStride + axis * sizeof(float));
+	};
+
+	//a split is allowed wherever the triangles since the last one are within the threshold of the whole cluster's cache reuse
+	std::vector<uint32_t> hardStarts = clusters;
+	if (hardStarts.empty() || hardStarts[0] != 0) {
+		hardStarts.insert(hardStarts.begin(), 0);
+	}
+
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<uint32_t> starts;
+
+	for (size_t c = 0; c < hardStarts.size(); c++) {
+		size_t begin = hardStarts[c];
+		size_t end = c + 1 < hardStarts.size() ? hardStarts[c + 1] : triangleCount;
+
+		cache.clear();
+		size_t clusterTransformed = 0;
+		for (size_t i = begin * 3; i < end * 3; i++) {
+			clusterTransformed += cache.access(indices[i]) ? 1 : 0;
+		}
+
+		float clusterAcmr = static_cast<float>(clusterTransformed) / (end - begin);
+
+		starts.push_back(static_cast<uint32_t>(begin));
+		cache.clear();
+
+		size_t transformed = 0;
+		size_t splitStart = begin;
+
+		for (size_t t = begin; t < end; t++) {
+			for (int corner = 0; corner < 3; corner++) {
+				transformed += cache.access(indices[t * 3 + corner]) ? 1 : 0;
+			}
+
+			float runningAcmr = static_cast<float>(transformed) / (t + 1 - splitStart);
+
+			if (t + 1 < end && runningAcmr <= clusterAcmr * acmrThreshold) {
+				starts.push_back(static_cast<uint32_t>(t + 1));
+				splitStart = t + 1;
+				transformed = 0;
+				cache.clear();
+			}
+		}
+	}
+
+	//area weighted centre and normal of every cluster, and of the whole mesh
+	struct ClusterInfo {
+		uint32_t begin;
+		uint32_t end;
+		float sortKey;
+	};
+
+	std::vector<ClusterInfo> infos(starts.size());
+	std::vector<float> centroids(starts.size() * 3, 0.0f);
+	std::vector<float> normals(starts.size() * 3, 0.0f);
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+
+	for (size_t c = 0; c < starts.size(); c++) {
+		infos[c].begin = starts[c];
+		infos[c].end = c + 1 < starts.size() ? starts[c + 1] : static_cast<uint32_t>(triangleCount);
+
+		float clusterArea = 0.0f;
+
+		for (uint32_t t = infos[c].begin; t < infos[c].end; t++) {
+			uint32_t a = indices[t * 3 + 0];
+			uint32_t b = indices[t * 3 + 1];
+			uint32_t d = indices[t * 3 + 2];
+
+			float ab[3];
+			float ad[3];
+			for (int axis = 0; axis < 3; axis++) {
+				ab[axis] = position(b, axis) - position(a, axis);
+				ad[axis] = position(d, axis) - position(a, axis);
+			}
+
+			float cross[3] = {
+				ab[1] * ad[2] - ab[2] * ad[1],
+				ab[2] * ad[0] - ab[0] * ad[2],
+				ab[0] * ad[1] - ab[1] * ad[0]
+			};
+
+			float area = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+
+			for (int axis = 0; axis < 3; axis++) {
+				float centre = (position(a, axis) + position(b, axis) + position(d, axis)) / 3.0f;
+
+				centroids[c * 3 + axis] += centre * area;
+				normals[c * 3 + axis] += cross[axis];
+				meshCentroid[axis] += centre * area;
+			}
+
+			clusterArea += area;
+		}
+
+		if (clusterArea > 0.0f) {
+			for (int axis = 0; axis < 3; axis++) {
+				centroids[c * 3 + axis] /= clusterArea;
+			}
+		}
+
+		meshArea += clusterArea;
+	}
+
+	if (meshArea > 0.0f) {
+		for (int axis = 0; axis < 3; axis++) {
+			meshCentroid[axis] /= meshArea;
+		}
+	}
+
+	for (size_t c = 0; c < infos.size(); c++) {
+		float* normal = &normals[c * 3];
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+		infos[c].sortKey = 0.0f;
+		if (length > 0.0f) {
+			for (int axis = 0; axis < 3; axis++) {
+				infos[c].sortKey += (centroids[c * 3 + axis] - meshCentroid[axis]) * normal[axis] / length;
+			}
+		}
+	}
+
+	//furthest out first, those are the clusters most likely to cover the others
+	std::stable_sort(infos.begin(), infos.end(), [](const ClusterInfo& a, const ClusterInfo& b) {
+		return a.sortKey > b.sortKey;
+	});
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	for (const ClusterInfo& info : infos) {
+		output.insert(output.end(), indices.begin() + info.begin * 3, indices.begin() + info.end * 3);
+	}
+
+	indices.swap(output);
+}
+
+std::vector<uint32_t> optimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertexCount) {
+	std::vector<uint32_t> remap(vertexCount, UNUSED);
+	uint32_t next = 0;
+
+	for (uint32_t& index : indices) {
+		if (remap[index] == UNUSED) {
+			remap[index] = next++;
+		}
+
+		index = remap[index];
+	}
+
+	//anything never drawn goes on the end so the table still covers every vertex
+	for (uint32_t& slot : remap) {
+		if (slot == UNUSED) {
+			slot = next++;
+		}
+	}
+
+	return remap;
+}
+
+//plane equations summed as a symmetric 4x4 matrix, weighted by triangle area so big triangles count for more
+struct Quadric {
+	double a2, b2, c2, d2;
+	double ab, ac, ad, bc, bd, cd;
+	double weight;
+
+	void addPlane(double a, double b, double c, double d, double w) {
+		a2 += a * a * w;
+		b2 += b * b * w;
+		c2 += c * c * w;
+		d2 += d * d * w;
+		ab += a * b * w;
+		ac += a * c * w;
+		ad += a * d * w;
+		bc += b * c * w;
+		bd += b * d * w;
+		cd += c * d * w;
+		weight += w;
+	}
+
+	void add(const Quadric& other) {
+		a2 += other.a2;
+		b2 += other.b2;
+		c2 += other.c2;
+		d2 += other.d2;
+		ab += other.ab;
+		ac += other.ac;
+		ad += other.ad;
+		bc += other.bc;
+		bd += other.bd;
+		cd += other.cd;
+		weight += other.weight;
+	}
+
+	//average squared distance from the point to the planes
+	double evaluate(double x, double y, double z) const {
+		double error = a2 * x * x + b2 * y * y + c2 * z * z + d2
+			+ 2.0 * (ab * x * y + ac * x * z + bc * y * z + ad * x + bd * y + cd * z);
+
+		return weight > 0.0 ? std::abs(error) / weight : 0.0;
+	}
+};
+
+std::vector<uint32_t> simplifyMesh(const std::vector<uint32_t>& indices, const float* positions, size_t positionStride, size_t vertexCount,
+	size_t targetIndexCount, float targetError, float* resultError) {
+	auto position = [&](uint32_t vertex) {
+		return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + vertex * positionStride);
+	};
+
+	std::vector<uint32_t> result = indices;
+	double maxError = 0.0;
+
+	//vertices at the same position are one point of the surface, split only because their uvs differ
+	std::vector<uint32_t> byPosition(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; i++) {
+		byPosition[i] = i;
+	}
+
+	std::sort(byPosition.begin(), byPosition.end(), [&](uint32_t a, uint32_t b) {
+		return std::lexicographical_compare(position(a), position(a) + 3, position(b), position(b) + 3);
+	});
+
+	std::vector<uint32_t> welded(vertexCount);
+	std::vector<char> locked(vertexCount, 0);
+
+	for (size_t i = 0; i < vertexCount;) {
+		size_t end = i + 1;
+		while (end < vertexCount && std::equal(position(byPosition[i]), position(byPosition[i]) + 3, position(byPosition[end]))) {
+			end++;
+		}
+
+		//a uv seam, moving either side would tear it open
+		for (size_t j = i; j < end; j++) {
+			welded[byPosition[j]] = byPosition[i];
+			locked[byPosition[j]] = end - i > 1 ? 1 : 0;
+		}
+
+		i = end;
+	}
+
+	//edges of the welded mesh with one triangle are open borders, more than two is not a surface, both stay put
+	std::unordered_map<uint64_t, uint32_t> edgeUses;
+	for (size_t t = 0; t + 2 < result.size(); t += 3) {
+		for (int e = 0; e < 3; e++) {
+			uint32_t a = welded[result[t + e]];
+			uint32_t b = welded[result[t + (e + 1) % 3]];
+
+			edgeUses[(static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b)]++;
+		}
+	}
+
+	for (size_t t = 0; t + 2 < result.size(); t += 3) {
+		for (int e = 0; e < 3; e++) {
+			uint32_t a = welded[result[t + e]];
+			uint32_t b = welded[result[t + (e + 1) % 3]];
+
+			if (edgeUses[(static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b)] != 2) {
+				locked[result[t + e]] = 1;
+				locked[result[t + (e + 1) % 3]] = 1;
+			}
+		}
+	}
+
+	std::vector<Quadric> quadrics(vertexCount, Quadric());
+	for (size_t t = 0; t + 2 < result.size(); t += 3) {
+		const float* p0 = position(result[t + 0]);
+		const float* p1 = position(result[t + 1]);
+		const float* p2 = position(result[t + 2]);
+
+		double u[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		double v[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		double normal[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+		double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+		if (length == 0.0) {
+			continue;
+		}
+
+		double a = normal[0] / length;
+		double b = normal[1] / length;
+		double c = normal[2] / length;
+		double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+
+		for (int corner = 0; corner < 3; corner++) {
+			quadrics[result[t + corner]].addPlane(a, b, c, d, length * 0.5);
+		}
+	}
+
+	struct Collapse {
+		uint32_t from;
+		uint32_t to;
+		double error;
+	};
+
+	std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+	std::vector<uint32_t> vertexTriangles;
+	std::vector<uint32_t> collapseTo(vertexCount);
+	std::vector<char> changed(vertexCount);
+	std::vector<Collapse> collapses;
+	double errorLimit = static_cast<double>(targetError) * targetError;
+
+	//every pass collapses as many edges as it can without two of them touching the same triangles, cheapest first
+	while (result.size() > targetIndexCount) {
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (uint32_t index : result) {
+			triangleOffsets[index + 1]++;
+		}
+		for (size_t i = 0; i < vertexCount; i++) {
+			triangleOffsets[i + 1] += triangleOffsets[i];
+		}
+
+		vertexTriangles.resize(result.size());
+		std::vector<uint32_t> filled(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (size_t i = 0; i < result.size(); i++) {
+			vertexTriangles[filled[result[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		collapses.clear();
+		for (size_t t = 0; t + 2 < result.size(); t += 3) {
+			for (int e = 0; e < 3; e++) {
+				uint32_t a = result[t + e];
+				uint32_t b = result[t + (e + 1) % 3];
+
+				for (int direction = 0; direction < 2; direction++) {
+					uint32_t from = direction == 0 ? a : b;
+					uint32_t to = direction == 0 ? b : a;
+
+					if (locked[from]) {
+						continue;
+					}
+
+					Quadric combined = quadrics[from];
+					combined.add(quadrics[to]);
+
+					const float* p = position(to);
+					collapses.push_back({ from, to, combined.evaluate(p[0], p[1], p[2]) });
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+			return a.error < b.error;
+		});
+
+		for (size_t i = 0; i < vertexCount; i++) {
+			collapseTo[i] = static_cast<uint32_t>(i);
+		}
+		std::fill(changed.begin(), changed.end(), 0);
+
+		size_t trianglesLeft = result.size() / 3;
+		size_t trianglesWanted = targetIndexCount / 3;
+		bool collapsed = false;
+
+		for (const Collapse& collapse : collapses) {
+			if (collapse.error > errorLimit || trianglesLeft <= trianglesWanted) {
+				break;
+			}
+
+			if (changed[collapse.from] || changed[collapse.to]) {
+				continue;
+			}
+
+			size_t sharedTriangles = 0;
+			bool valid = true;
+			std::vector<uint32_t> fromNeighbours;
+			std::vector<uint32_t> toNeighbours;
+
+			for (uint32_t i = triangleOffsets[collapse.from]; i < triangleOffsets[collapse.from + 1] && valid; i++) {
+				const uint32_t* triangle = &result[vertexTriangles[i] * 3];
+
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+					sharedTriangles++;
+					continue;
+				}
+
+				//the triangles that stay must not turn over once from is moved onto to
+				double before[3];
+				double after[3];
+				for (int pass = 0; pass < 2; pass++) {
+					const float* corners[3];
+					for (int corner = 0; corner < 3; corner++) {
+						uint32_t vertex = triangle[corner];
+						corners[corner] = position(pass == 1 && vertex == collapse.from ? collapse.to : vertex);
+
+						if (vertex != collapse.from) {
+							fromNeighbours.push_back(vertex);
+						}
+					}
+
+					double u[3] = { corners[1][0] - corners[0][0], corners[1][1] - corners[0][1], corners[1][2] - corners[0][2] };
+					double v[3] = { corners[2][0] - corners[0][0], corners[2][1] - corners[0][1], corners[2][2] - corners[0][2] };
+					double* normal = pass == 0 ? before : after;
+					normal[0] = u[1] * v[2] - u[2] * v[1];
+					normal[1] = u[2] * v[0] - u[0] * v[2];
+					normal[2] = u[0] * v[1] - u[1] * v[0];
+				}
+
+				if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0) {
+					valid = false;
+				}
+			}
+
+			if (!valid || sharedTriangles == 0) {
+				continue;
+			}
+
+			//the ends may only share the neighbours across the triangles being removed, anything else would pinch the surface
+			for (uint32_t i = triangleOffsets[collapse.to]; i < triangleOffsets[collapse.to + 1]; i++) {
+				const uint32_t* triangle = &result[vertexTriangles[i] * 3];
+				toNeighbours.insert(toNeighbours.end(), triangle, triangle + 3);
+			}
+
+			std::sort(fromNeighbours.begin(), fromNeighbours.end());
+			fromNeighbours.erase(std::unique(fromNeighbours.begin(), fromNeighbours.end()), fromNeighbours.end());
+			std::sort(toNeighbours.begin(), toNeighbours.end());
+			toNeighbours.erase(std::unique(toNeighbours.begin(), toNeighbours.end()), toNeighbours.end());
+
+			size_t common = 0;
+			for (uint32_t vertex : fromNeighbours) {
+				if (vertex != collapse.to && std::binary_search(toNeighbours.begin(), toNeighbours.end(), vertex)) {
+					common++;
+				}
+			}
+
+			if (common != sharedTriangles) {
+				continue;
+			}
+
+			collapseTo[collapse.from] = collapse.to;
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			maxError = std::max(maxError, collapse.error);
+			trianglesLeft -= sharedTriangles;
+			collapsed = true;
+
+			//everything around from has new triangles now, so the adjacency of this pass no longer holds for it
+			changed[collapse.to] = 1;
+			for (uint32_t i = triangleOffsets[collapse.from]; i < triangleOffsets[collapse.from + 1]; i++) {
+				const uint32_t* triangle = &result[vertexTriangles[i] * 3];
+				changed[triangle[0]] = 1;
+				changed[triangle[1]] = 1;
+				changed[triangle[2]] = 1;
+			}
+		}
+
+		if (!collapsed) {
+			break;
+		}
+
+		size_t write = 0;
+		for (size_t t = 0; t + 2 < result.size(); t += 3) {
+			uint32_t a = collapseTo[result[t + 0]];
+			uint32_t b = collapseTo[result[t + 1]];
+			uint32_t c = collapseTo[result[t + 2]];
+
+			if (a != b && b != c && a != c) {
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+		}
+
+		result.resize(write);
+	}
+
+	if (resultError != nullptr) {
+		*resultError = static_cast<float>(std::sqrt(maxError));
+	}
+
+	return result;
+}
+
+std::vector<IndexRange> splitIndexRanges(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& vertexSources, uint32_t maxVertices) {
+	std::vector<IndexRange> ranges;
+	std::vector<uint32_t> local(vertexCount, UNUSED);
+	//old vertices given a place in the current range, so local can be reset without walking all of it
+	std::vector<uint32_t> used;
+	IndexRange range = { 0, 0, 0 };
+
+	vertexSources.clear();
+
+	for (uint32_t triangle = 0; triangle + 2 < indices.size(); triangle += 3) {
+		uint32_t added = 0;
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			if (local[indices[triangle + corner]] == UNUSED) {
+				added++;
+			}
+		}
+
+		if (used.size() + added > maxVertices) {
+			range.indexCount = triangle - range.firstIndex;
+			ranges.push_back(range);
+
+			for (uint32_t vertex : used) {
+				local[vertex] = UNUSED;
+			}
+			used.clear();
+
+			range = { triangle, 0, static_cast<uint32_t>(vertexSources.size()) };
+		}
+
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			uint32_t& index = indices[triangle + corner];
+
+			if (local[index] == UNUSED) {
+				local[index] = static_cast<uint32_t>(used.size());
+				used.push_back(index);
+				vertexSources.push_back(index);
+			}
+
+			index = local[index];
+		}
+	}
+
+	range.indexCount = static_cast<uint32_t>(indices.size()) - range.firstIndex;
+	ranges.push_back(range);
+
+	return ranges;
+}
+
+static void computeMeshletBounds(Meshlet& meshlet, const std::vector<uint32_t>& indices, const float* positions, size_t positionStride) {
+	auto position = [&](uint32_t index) {
+		return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + (meshlet.firstVertex + index) * positionStride);
+	};
+
+	float boundsMin[3] = { position(indices[meshlet.firstIndex])[0], position(indices[meshlet.firstIndex])[1], position(indices[meshlet.firstIndex])[2] };
+	float boundsMax[3] = { boundsMin[0], boundsMin[1], boundsMin[2] };
+
+	for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			boundsMin[axis] = std::min(boundsMin[axis], position(indices[i])[axis]);
+			boundsMax[axis] = std::max(boundsMax[axis], position(indices[i])[axis]);
+		}
+	}
+
+	meshlet.radius = 0.0f;
+	for (int axis = 0; axis < 3; axis++) {
+		meshlet.center[axis] = (boundsMin[axis] + boundsMax[axis]) * 0.5f;
+	}
+
+	for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++) {
+		const float* p = position(indices[i]);
+		float offset[3] = { p[0] - meshlet.center[0], p[1] - meshlet.center[1], p[2] - meshlet.center[2] };
+
+		meshlet.radius = std::max(meshlet.radius, std::sqrt(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]));
+	}
+
+	//unit normals of every triangle, the axis is their average and the cutoff comes from the one furthest from it
+	std::vector<float> normals;
+	float axis[3] = { 0.0f, 0.0f, 0.0f };
+
+	for (uint32_t t = meshlet.firstIndex; t + 2 < meshlet.firstIndex + meshlet.indexCount; t += 3) {
+		const float* p0 = position(indices[t + 0]);
+		const float* p1 = position(indices[t + 1]);
+		const float* p2 = position(indices[t + 2]);
+
+		float u[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float v[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		float normal[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+		if (length == 0.0f) {
+			continue;
+		}
+
+		for (int a = 0; a < 3; a++) {
+			normals.push_back(normal[a] / length);
+			axis[a] += normal[a] / length;
+		}
+	}
+
+	float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	float minimumDot = 1.0f;
+
+	for (int a = 0; a < 3; a++) {
+		meshlet.coneAxis[a] = axisLength > 0.0f ? axis[a] / axisLength : 0.0f;
+	}
+
+	for (size_t n = 0; n < normals.size(); n += 3) {
+		minimumDot = std::min(minimumDot, normals[n] * meshlet.coneAxis[0] + normals[n + 1] * meshlet.coneAxis[1] + normals[n + 2] * meshlet.coneAxis[2]);
+	}
+
+	//normals spread over more than about a hemisphere, some triangle always faces the eye
+	meshlet.coneCutoff = axisLength > 0.0f && minimumDot > 0.1f ? std::sqrt(1.0f - minimumDot * minimumDot) : 1.0f;
+}
+
+std::vector<Meshlet> buildMeshlets(const std::vector<uint32_t>& indices, const IndexRange& range, const float* positions, size_t positionStride,
+	uint32_t maxVertices, uint32_t maxTriangles) {
+	std::vector<Meshlet> meshlets;
+	//few enough that looking through them is cheaper than a table over the whole range
+	std::vector<uint32_t> used;
+	Meshlet meshlet = {};
+	meshlet.firstIndex = range.firstIndex;
+	meshlet.firstVertex = range.firstVertex;
+
+	uint32_t end = range.firstIndex + range.indexCount;
+
+	for (uint32_t t = range.firstIndex; t + 2 < end; t += 3) {
+		uint32_t added = 0;
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			if (std::find(used.begin(), used.end(), indices[t + corner]) == used.end()) {
+				added++;
+			}
+		}
+
+		if (used.size() + added > maxVertices || meshlet.indexCount / 3 == maxTriangles) {
+			computeMeshletBounds(meshlet, indices, positions, positionStride);
+			meshlets.push_back(meshlet);
+
+			meshlet.firstIndex = t;
+			meshlet.indexCount = 0;
+			used.clear();
+		}
+
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			if (std::find(used.begin(), used.end(), indices[t + corner]) == used.end()) {
+				used.push_back(indices[t + corner]);
+			}
+		}
+
+		meshlet.indexCount += 3;
+	}
+
+	if (meshlet.indexCount > 0) {
+		computeMeshletBounds(meshlet, indices, positions, positionStride);
+		meshlets.push_back(meshlet);
+	}
+
+	return meshlets;
+}
+
+uint16_t quantizeUnorm16(float value) {
+	return static_cast<uint16_t>(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f + 0.5f);
+}
+
+uint16_t quantizeHalf(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+	uint32_t magnitude = bits & 0x7fffffff;
+
+	//infinity, or nan with a mantissa bit kept so it stays nan
+	if (magnitude >= 0x7f800000) {
+		return sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0);
+	}
+
+	//65520 and up round past the largest half
+	if (magnitude >= 0x477ff000) {
+		return sign | 0x7c00;
+	}
+
+	//under 2^-14 there is no exponent left, the mantissa is just the value in steps of 2^-24
+	if (magnitude < 0x38800000) {
+		float small;
+		memcpy(&small, &magnitude, sizeof(small));
+		return sign | static_cast<uint16_t>(std::nearbyint(small * 16777216.0f));
+	}
+
+	//rebias the exponent from 127 to 15 and round the 23 mantissa bits down to 10, ties to even
+	uint32_t rounded = magnitude + 0xfff + ((magnitude >> 13) & 1);
+	return sign | static_cast<uint16_t>((rounded - 0x38000000) >> 13);
+}
+
+float dequantizeHalf(uint16_t value) {
+	uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1f;
+	uint32_t mantissa = value & 0x3ff;
+
+	float result;
+
+	if (exponent == 0) {
+		result = std::ldexp(static_cast<float>(mantissa), -24);
+	}
+	else {
+		uint32_t bits = exponent == 31 ? 0x7f800000 | (mantissa << 13) : ((exponent + 112) << 23) | (mantissa << 13);
+		memcpy(&result, &bits, sizeof(result));
+	}
+
+	uint32_t resultBits;
+	memcpy(&resultBits, &result, sizeof(resultBits));
+	resultBits |= sign;
+	memcpy(&result, &resultBits, sizeof(result));
+
+	return result;
+}
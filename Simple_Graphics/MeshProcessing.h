@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* cpu side mesh work done at import, nothing here needs a device.
+	everything works on triangle lists of indices, positions are read as 3 floats at the given stride*/
+
+//size of the fifo cache the stats and the reordering assume, about what current gpus behave like
+static const uint32_t VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats {
+	//average vertices transformed per triangle, 0.5 is the best a big grid can do, 3 is no reuse at all
+	float acmr;
+	//transformed vertices over unique vertices, 1 means each one is only shaded once
+	float atvr;
+};
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+/* tipsify, reorders triangles so neighbouring ones share vertices while they are still in the cache.
+	returns the first triangle of every cluster it had to jump to a new part of the mesh for*/
+std::vector<uint32_t> optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+/* splits the clusters from optimizeVertexCache further wherever that costs little cache reuse,
+	then draws the ones facing out from the middle of the mesh first so they hide what is behind them*/
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<uint32_t>& clusters, const float* positions, size_t positionStride,
+	size_t vertexCount, float acmrThreshold = 1.05f, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+/* renumbers vertices in the order the indices first use them so fetches walk through memory.
+	the indices are rewritten, the returned table gives the new place of each old vertex*/
+std::vector<uint32_t> optimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertexCount);
+
+/* quadric error simplification that collapses edges onto one of their ends, so no vertices are made and uvs stay exact.
+	vertices on a uv seam or an open border are never moved, seams do not tear and outlines do not shrink.
+	stops at targetIndexCount or before a collapse would move the surface further than targetError,
+	resultError gets how far it did move in the units of the positions*/
+std::vector<uint32_t> simplifyMesh(const std::vector<uint32_t>& indices, const float* positions, size_t positionStride, size_t vertexCount,
+	size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+//a run of indices drawn with its own base vertex, the indices in it count from firstVertex
+struct IndexRange {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t firstVertex;
+};
+
+//most vertices 16 bit indices can reach, primitive restart is never enabled so 0xffff is usable too
+static const uint32_t SHORT_INDEX_VERTEX_LIMIT = 65536;
+
+/* cuts the triangles into ranges that each use at most maxVertices vertices, keeping the order they are drawn in.
+	a vertex used by more than one range is duplicated, vertexSources gets the old vertex behind every vertex of the new array.
+	vertices no triangle uses are left out*/
+std::vector<IndexRange> splitIndexRanges(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& vertexSources,
+	uint32_t maxVertices = SHORT_INDEX_VERTEX_LIMIT);
+
+//what a meshlet is cut to, 124 keeps the triangle count a multiple of 4 with room for a mesh shader's primitive limit
+static const uint32_t MESHLET_MAX_VERTICES = 64;
+static const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+/* a run of triangles in the index buffer and what it can be culled by.
+	the cone holds all the triangles' normals, the meshlet faces away from any eye where
+	dot(center - eye, coneAxis) >= coneCutoff * length(center - eye) + radius*/
+struct Meshlet {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t firstVertex;
+	float center[3];
+	float radius;
+	float coneAxis[3];
+	float coneCutoff;
+};
+
+/* cuts the triangles of the range into meshlets in the order they are drawn, so the cache ordering done before keeps them compact.
+	the range's indices are read from firstVertex on in positions*/
+std::vector<Meshlet> buildMeshlets(const std::vector<uint32_t>& indices, const IndexRange& range, const float* positions, size_t positionStride,
+	uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+//nearest 16 bit unorm, the value is clamped to 0-1 first
+uint16_t quantizeUnorm16(float value);
+
+//ieee half float rounded to nearest even, too big goes to infinity and nan stays nan
+uint16_t quantizeHalf(float value);
+float dequantizeHalf(uint16_t value);
@@ -0,0 +1,318 @@
+#include "SceneFile.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "MappedFile.h"
+
+static const char SCENE_MAGIC[8] = { 'S', 'G', 'S', 'C', 'E', 'N', 'E', '2' };
+//files from before instances had parents, their records are the same without the parent on the end
+static const char SCENE_MAGIC_1[8] = { 'S', 'G', 'S', 'C', 'E', 'N', 'E', '1' };
+static const size_t SCENE_INSTANCE_SIZE_1 = 48;
+
+/* binary layout, everything little endian:
+	the header, then each mesh path and each texture path as a uint32_t length and its bytes,
+	padding up to a multiple of 4, then instanceCount SceneInstance records*/
+struct SceneBinaryHeader {
+	char magic[8];
+	uint32_t meshCount;
+	uint32_t textureCount;
+	uint32_t instanceCount;
+	uint32_t reserved;
+};
+
+static_assert(sizeof(SceneBinaryHeader) == 24, "scene header has to match the file layout");
+static_assert(sizeof(SceneInstance) == 52, "scene instance has to match the file layout");
+
+static SceneDescription loadSceneBinary(const std::string& path, const MappedFile& file, size_t instanceSize) {
+	const unsigned char* data = file.data();
+	size_t size = file.size();
+
+	SceneBinaryHeader header;
+	memcpy(&header, data, sizeof(header));
+
+	SceneDescription scene;
+	size_t offset = sizeof(header);
+
+	auto readString = [&]() {
+		uint32_t length;
+		if (offset + sizeof(length) > size) {
+			throw std::runtime_error(path + " ends in the middle of its asset paths!");
+		}
+		memcpy(&length, data + offset, sizeof(length));
+		offset += sizeof(length);
+
+		if (offset + length > size) {
+			throw std::runtime_error(path + " ends in the middle of its asset paths!");
+		}
+		std::string value(reinterpret_cast<const char*>(data + offset), length);
+		offset += length;
+
+		return value;
+	};
+
+	for (uint32_t i = 0; i < header.meshCount; i++) {
+		scene.meshes.push_back(readString());
+	}
+	for (uint32_t i = 0; i < header.textureCount; i++) {
+		scene.textures.push_back(readString());
+	}
+
+	offset = (offset + 3) & ~size_t(3);
+
+	if (offset + instanceSize * size_t(header.instanceCount) > size) {
+		throw std::runtime_error(path + " has fewer instances than its header says!");
+	}
+
+	scene.instances.resize(header.instanceCount);
+	if (instanceSize == sizeof(SceneInstance)) {
+		memcpy(scene.instances.data(), data + offset, sizeof(SceneInstance) * scene.instances.size());
+	}
+	else {
+		for (size_t i = 0; i < scene.instances.size(); i++) {
+			memcpy(&scene.instances[i], data + offset + i * instanceSize, instanceSize);
+			scene.instances[i].parent = SCENE_NO_PARENT;
+		}
+	}
+
+	for (size_t i = 0; i < scene.instances.size(); i++) {
+		const SceneInstance& instance = scene.instances[i];
+
+		if (instance.mesh >= scene.meshes.size() || instance.texture >= scene.textures.size()) {
+			throw std::runtime_error(path + " has an instance of a mesh or texture it does not list!");
+		}
+		if (instance.parent != SCENE_NO_PARENT && instance.parent >= i) {
+			throw std::runtime_error(path + " has an instance attached to one that does not come before it!");
+		}
+	}
+
+	return scene;
+}
+
+static SceneDescription loadSceneText(const std::string& path, const MappedFile& file) {
+	const char* text = reinterpret_cast<const char*>(file.data());
+	const char* end = text + file.size();
+
+	SceneDescription scene;
+	std::unordered_map<std::string, uint32_t> meshNames;
+	std::unordered_map<std::string, uint32_t> textureNames;
+
+	std::vector<std::string> tokens;
+	std::string line;
+	uint32_t lineNumber = 0;
+
+	while (text < end) {
+		const char* lineEnd = static_cast<const char*>(memchr(text, '\n', end - text));
+		if (lineEnd == nullptr) {
+			lineEnd = end;
+		}
+
+		line.assign(text, lineEnd);
+		text = lineEnd + 1;
+		lineNumber++;
+
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) {
+			line.resize(comment);
+		}
+
+		tokens.clear();
+		size_t position = 0;
+		while (true) {
+			position = line.find_first_not_of(" \t\r", position);
+			if (position == std::string::npos) {
+				break;
+			}
+
+			size_t tokenEnd = line.find_first_of(" \t\r", position);
+			tokens.push_back(line.substr(position, tokenEnd - position));
+			position = tokenEnd;
+		}
+
+		if (tokens.empty()) {
+			continue;
+		}
+
+		std::string where = path + ":" + std::to_string(lineNumber);
+
+		if (tokens[0] == "mesh" || tokens[0] == "texture") {
+			if (tokens.size() != 3) {
+				throw std::runtime_error(where + " should be " + tokens[0] + " <name> <path>!");
+			}
+
+			bool isMesh = tokens[0] == "mesh";
+			auto& names = isMesh ? meshNames : textureNames;
+			auto& paths = isMesh ? scene.meshes : scene.textures;
+
+			names[tokens[1]] = static_cast<uint32_t>(paths.size());
+			paths.push_back(tokens[2]);
+		}
+		else if (tokens[0] == "instance") {
+			bool isStatic = tokens.size() > 12 && tokens[12] == "static";
+			size_t parentToken = isStatic ? 13 : 12;
+			bool hasParent = tokens.size() == parentToken + 2 && tokens[parentToken] == "parent";
+
+			if (tokens.size() != parentToken + (hasParent ? 2 : 0)) {
+				throw std::runtime_error(where + " should be instance <mesh> <texture> <location> <rotation> <scale> [static] [parent <instance>]!");
+			}
+
+			auto mesh = meshNames.find(tokens[1]);
+			auto texture = textureNames.find(tokens[2]);
+			if (mesh == meshNames.end() || texture == textureNames.end()) {
+				throw std::runtime_error(where + " uses a mesh or texture that has not been declared!");
+			}
+
+			float values[9];
+			for (int i = 0; i < 9; i++) {
+				char* parsedEnd;
+				values[i] = strtof(tokens[3 + i].c_str(), &parsedEnd);
+
+				if (*parsedEnd != '\0') {
+					throw std::runtime_error(where + " has " + tokens[3 + i] + " where a number should be!");
+				}
+			}
+
+			SceneInstance instance = {};
+			instance.mesh = mesh->second;
+			instance.texture = texture->second;
+			memcpy(instance.location, values + 0, sizeof(instance.location));
+			memcpy(instance.rotation, values + 3, sizeof(instance.rotation));
+			memcpy(instance.scale, values + 6, sizeof(instance.scale));
+			instance.flags = isStatic ? SCENE_INSTANCE_STATIC : 0;
+			instance.parent = SCENE_NO_PARENT;
+
+			if (hasParent) {
+				char* parsedEnd;
+				unsigned long parent = strtoul(tokens[parentToken + 1].c_str(), &parsedEnd, 10);
+
+				if (*parsedEnd != '\0' || parent >= scene.instances.size()) {
+					throw std::runtime_error(where + " is attached to " + tokens[parentToken + 1] + ", which is not an instance before it!");
+				}
+				instance.parent = static_cast<uint32_t>(parent);
+			}
+
+			scene.instances.push_back(instance);
+		}
+		else {
+			throw std::runtime_error(where + " starts with " + tokens[0] + ", not mesh, texture or instance!");
+		}
+	}
+
+	return scene;
+}
+
+SceneDescription loadScene(const std::string& path) {
+	MappedFile file(path);
+
+	if (file.size() >= sizeof(SceneBinaryHeader) && memcmp(file.data(), SCENE_MAGIC, sizeof(SCENE_MAGIC)) == 0) {
+		return loadSceneBinary(path, file, sizeof(SceneInstance));
+	}
+	if (file.size() >= sizeof(SceneBinaryHeader) && memcmp(file.data(), SCENE_MAGIC_1, sizeof(SCENE_MAGIC_1)) == 0) {
+		return loadSceneBinary(path, file, SCENE_INSTANCE_SIZE_1);
+	}
+
+	return loadSceneText(path, file);
+}
+
+void writeSceneText(const std::string& path, const SceneDescription& scene) {
+	std::ofstream file(path);
+
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to create " + path + "!");
+	}
+
+	//enough digits that every float reads back the same
+	file.precision(std::numeric_limits<float>::max_digits10);
+
+	//the paths' indices double as their names
+	for (size_t i = 0; i < scene.meshes.size(); i++) {
+		file << "mesh m" << i << " " << scene.meshes[i] << "\n";
+	}
+	for (size_t i = 0; i < scene.textures.size(); i++) {
+		file << "texture t" << i << " " << scene.textures[i] << "\n";
+	}
+
+	for (const SceneInstance& instance : scene.instances) {
+		file << "instance m" << instance.mesh << " t" << instance.texture;
+
+		for (float value : instance.location) {
+			file << " " << value;
+		}
+		for (float value : instance.rotation) {
+			file << " " << value;
+		}
+		for (float value : instance.scale) {
+			file << " " << value;
+		}
+
+		if (instance.flags & SCENE_INSTANCE_STATIC) {
+			file << " static";
+		}
+		if (instance.parent != SCENE_NO_PARENT) {
+			file << " parent " << instance.parent;
+		}
+		file << "\n";
+	}
+}
+
+void writeSceneBinary(const std::string& path, const SceneDescription& scene) {
+	std::ofstream file(path, std::ios::binary);
+
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to create " + path + "!");
+	}
+
+	SceneBinaryHeader header = {};
+	memcpy(header.magic, SCENE_MAGIC, sizeof(SCENE_MAGIC));
+	header.meshCount = static_cast<uint32_t>(scene.meshes.size());
+	header.textureCount = static_cast<uint32_t>(scene.textures.size());
+	header.instanceCount = static_cast<uint32_t>(scene.instances.size());
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	size_t offset = sizeof(header);
+
+	for (const auto* paths : { &scene.meshes, &scene.textures }) {
+		for (const std::string& assetPath : *paths) {
+			uint32_t length = static_cast<uint32_t>(assetPath.size());
+			file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+			file.write(assetPath.data(), length);
+			offset += sizeof(length) + length;
+		}
+	}
+
+	static const char padding[4] = {};
+	file.write(padding, ((offset + 3) & ~size_t(3)) - offset);
+
+	file.write(reinterpret_cast<const char*>(scene.instances.data()), sizeof(SceneInstance) * scene.instances.size());
+}
+
+SceneDescription generateGridScene(const std::vector<std::string>& meshes, const std::vector<std::string>& textures, uint32_t instanceCount, bool isStatic) {
+	SceneDescription scene;
+	scene.meshes = meshes;
+	scene.textures = textures;
+
+	uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(instanceCount))));
+	float spacing = 2.5f;
+
+	for (uint32_t i = 0; i < instanceCount; i++) {
+		SceneInstance instance = {};
+		instance.mesh = i % meshes.size();
+		instance.texture = i % textures.size();
+
+		instance.location[0] = (static_cast<float>(i % side) - side * 0.5f) * spacing;
+		instance.location[1] = (static_cast<float>(i / side) - side * 0.5f) * spacing;
+		instance.rotation[0] = 60.0f;
+		instance.scale[0] = instance.scale[1] = instance.scale[2] = 0.05f;
+		instance.flags = isStatic ? SCENE_INSTANCE_STATIC : 0;
+		instance.parent = SCENE_NO_PARENT;
+
+		scene.instances.push_back(instance);
+	}
+
+	return scene;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* a scene lists the meshes and textures it uses once, then every instance of them by index.
+	the text form has one entry per line, # starts a comment:
+		mesh <name> <path>
+		texture <name> <path>
+		instance <mesh name> <texture name> <x> <y> <z> <rx> <ry> <rz> <sx> <sy> <sz> [static] [parent <instance number>]
+	names have to be declared before an instance uses them and nothing can contain spaces. a child's transform is relative
+	to its parent, which is numbered from 0 in the order the instances are listed and has to come before it.
+	the binary form holds the same with the instances as fixed size records that are copied straight out of the file*/
+
+//instance flags
+static const uint32_t SCENE_INSTANCE_STATIC = 1;
+static const uint32_t SCENE_NO_PARENT = ~0u;
+
+struct SceneInstance {
+	uint32_t mesh;
+	uint32_t texture;
+	float location[3];
+	//x is the spin in degrees a second, or a fixed angle for static instances
+	float rotation[3];
+	float scale[3];
+	uint32_t flags;
+	//an earlier instance this one is attached to, SCENE_NO_PARENT for none
+	uint32_t parent;
+};
+
+struct SceneDescription {
+	std::vector<std::string> meshes;
+	std::vector<std::string> textures;
+	std::vector<SceneInstance> instances;
+};
+
+//either form, the binary one is told apart by its magic. throws if the file cannot be read or is malformed
+SceneDescription loadScene(const std::string& path);
+
+void writeSceneText(const std::string& path, const SceneDescription& scene);
+void writeSceneBinary(const std::string& path, const SceneDescription& scene);
+
+//a square grid on the x y plane cycling through the meshes and textures, for benchmarking
+SceneDescription generateGridScene(const std::vector<std::string>& meshes, const std::vector<std::string>& textures, uint32_t instanceCount, bool isStatic);
@@ -0,0 +1,579 @@
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//msvc allows avx2 intrinsics anywhere, gcc and clang only in functions built for it
+#if defined(__GNUC__) || defined(__clang__)
+#define RASTER_AVX2 __attribute__((target("avx2")))
+#else
+#define RASTER_AVX2
+#endif
+
+//triangles each setup task bins, and vertices each transform task does
+static const size_t SETUP_GRAIN = 4096;
+static const size_t TRANSFORM_GRAIN = 16384;
+
+//edge values are clamped to this at the corner of a tile, it is far more than they can change across one
+static const int64_t EDGE_LIMIT = int64_t(1) << 30;
+
+//clip planes as dot(plane, position) >= 0, the guard band ones are filled in for the screen size
+enum ClipPlane {
+	CLIP_NEAR,
+	CLIP_FAR,
+	CLIP_LEFT,
+	CLIP_RIGHT,
+	CLIP_TOP,
+	CLIP_BOTTOM,
+	CLIP_PLANE_COUNT
+};
+
+//edge functions at the top left pixel of the area being drawn and how they step, in 1/256 square pixels
+struct EdgeSetup {
+	int32_t row[3];
+	int32_t stepX[3];
+	int32_t stepY[3];
+};
+
+static bool detectAvx2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+
+	//the os has to save the ymm registers too
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+		return false;
+	}
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool SoftwareRasterizer::usesAvx2() {
+	static const bool supported = detectAvx2();
+	return supported;
+}
+
+SoftwareRasterizer::SoftwareRasterizer(uint32_t width, uint32_t height) : width(width), height(height) {
+	tilesX = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+	tilesY = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+
+	guardX = RASTER_GUARD_BAND / (width * 0.5f);
+	guardY = RASTER_GUARD_BAND / (height * 0.5f);
+
+	color.resize(size_t(width) * height);
+	depth.resize(size_t(width) * height);
+}
+
+//the plane through three values at three points, so it can be evaluated anywhere on the screen
+static glm::vec3 attributePlane(const float* x, const float* y, float a0, float a1, float a2) {
+	float dx1 = x[1] - x[0];
+	float dy1 = y[1] - y[0];
+	float dx2 = x[2] - x[0];
+	float dy2 = y[2] - y[0];
+	float area = dx1 * dy2 - dx2 * dy1;
+
+	float da1 = a1 - a0;
+	float da2 = a2 - a0;
+
+	glm::vec3 plane;
+	plane.x = (da1 * dy2 - da2 * dy1) / area;
+	plane.y = (da2 * dx1 - da1 * dx2) / area;
+	plane.z = a0 - plane.x * x[0] - plane.y * y[0];
+
+	return plane;
+}
+
+void SoftwareRasterizer::emitTriangle(const ClipVertex* vertices, const MipChain* texture, SetupChunk& chunk) {
+	RasterTriangle triangle;
+	float inverseW[3];
+	float sampleX[3];
+	float sampleY[3];
+
+	for (int i = 0; i < 3; i++) {
+		const glm::vec4& position = vertices[i].position;
+		inverseW[i] = 1.0f / position.w;
+
+		//the viewport transform, y already points down the screen
+		float screenX = (position.x * inverseW[i] * 0.5f + 0.5f) * width;
+		float screenY = (position.y * inverseW[i] * 0.5f + 0.5f) * height;
+
+		triangle.x[i] = static_cast<int32_t>(std::floor(screenX * 16.0f + 0.5f));
+		triangle.y[i] = static_cast<int32_t>(std::floor(screenY * 16.0f + 0.5f));
+	}
+
+	/* twice the area with y down, vulkan's counter clockwise front faces come out negative.
+		back faces and ones with no area are dropped, front faces are turned around so inside is positive*/
+	int64_t area = int64_t(triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0])
+		- int64_t(triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+	if (area >= 0) {
+		return;
+	}
+
+	int order[3] = { 0, 2, 1 };
+	std::swap(triangle.x[1], triangle.x[2]);
+	std::swap(triangle.y[1], triangle.y[2]);
+
+	//pixels whose centre, at 8/16, lies inside the bounds
+	int32_t minX = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+	int32_t minY = std::min(triangle.y[0], std::min(triangle.y[1], triangle.y[2]));
+	int32_t maxX = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+	int32_t maxY = std::max(triangle.y[0], std::max(triangle.y[1], triangle.y[2]));
+
+	triangle.minX = std::max((minX - 8 + 15) >> 4, 0);
+	triangle.minY = std::max((minY - 8 + 15) >> 4, 0);
+	triangle.maxX = std::min((maxX - 8) >> 4, static_cast<int32_t>(width) - 1);
+	triangle.maxY = std::min((maxY - 8) >> 4, static_cast<int32_t>(height) - 1);
+
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+		return;
+	}
+
+	//the planes are laid over the snapped positions, moved half a pixel so whole pixel numbers land on centres
+	float z[3];
+	float u[3];
+	float v[3];
+	float w[3];
+	for (int i = 0; i < 3; i++) {
+		const ClipVertex& vertex = vertices[order[i]];
+		sampleX[i] = triangle.x[i] / 16.0f - 0.5f;
+		sampleY[i] = triangle.y[i] / 16.0f - 0.5f;
+
+		w[i] = inverseW[order[i]];
+		z[i] = vertex.position.z * w[i];
+		u[i] = vertex.texCoord.x * w[i];
+		v[i] = vertex.texCoord.y * w[i];
+	}
+
+	triangle.depth = attributePlane(sampleX, sampleY, z[0], z[1], z[2]);
+	triangle.inverseW = attributePlane(sampleX, sampleY, w[0], w[1], w[2]);
+	triangle.uOverW = attributePlane(sampleX, sampleY, u[0], u[1], u[2]);
+	triangle.vOverW = attributePlane(sampleX, sampleY, v[0], v[1], v[2]);
+	triangle.texture = texture;
+
+	uint32_t index = static_cast<uint32_t>(chunk.triangles.size());
+	chunk.triangles.push_back(triangle);
+
+	for (int32_t tileY = triangle.minY / RASTER_TILE_SIZE; tileY <= triangle.maxY / RASTER_TILE_SIZE; tileY++) {
+		for (int32_t tileX = triangle.minX / RASTER_TILE_SIZE; tileX <= triangle.maxX / RASTER_TILE_SIZE; tileX++) {
+			chunk.tiles[tileY * tilesX + tileX].push_back(index);
+		}
+	}
+}
+
+/* only triangles that cross the near or far plane or reach past the guard band are clipped,
+	the rest of the screen edges are left to the bounds and the edge functions*/
+void SoftwareRasterizer::setupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, const MipChain* texture, SetupChunk& chunk) {
+	const glm::vec4 planes[CLIP_PLANE_COUNT] = {
+		glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
+		glm::vec4(0.0f, 0.0f, -1.0f, 1.0f),
+		glm::vec4(1.0f, 0.0f, 0.0f, guardX),
+		glm::vec4(-1.0f, 0.0f, 0.0f, guardX),
+		glm::vec4(0.0f, 1.0f, 0.0f, guardY),
+		glm::vec4(0.0f, -1.0f, 0.0f, guardY),
+	};
+
+	const ClipVertex* corners[3] = { &a, &b, &c };
+	uint32_t outside[3] = {};
+
+	for (int i = 0; i < 3; i++) {
+		for (int plane = 0; plane < CLIP_PLANE_COUNT; plane++) {
+			if (glm::dot(planes[plane], corners[i]->position) < 0.0f) {
+				outside[i] |= 1u << plane;
+			}
+		}
+	}
+
+	//wholly behind one plane
+	if (outside[0] & outside[1] & outside[2]) {
+		return;
+	}
+
+	if ((outside[0] | outside[1] | outside[2]) == 0) {
+		ClipVertex triangle[3] = { a, b, c };
+		emitTriangle(triangle, texture, chunk);
+		return;
+	}
+
+	//each plane can add at most one corner
+	ClipVertex polygon[3 + CLIP_PLANE_COUNT];
+	ClipVertex clipped[3 + CLIP_PLANE_COUNT];
+	int count = 3;
+	polygon[0] = a;
+	polygon[1] = b;
+	polygon[2] = c;
+
+	uint32_t crossed = outside[0] | outside[1] | outside[2];
+
+	for (int plane = 0; plane < CLIP_PLANE_COUNT && count >= 3; plane++) {
+		if (!(crossed & (1u << plane))) {
+			continue;
+		}
+
+		int clippedCount = 0;
+		for (int i = 0; i < count; i++) {
+			const ClipVertex& from = polygon[i];
+			const ClipVertex& to = polygon[(i + 1) % count];
+			float fromDistance = glm::dot(planes[plane], from.position);
+			float toDistance = glm::dot(planes[plane], to.position);
+
+			if (fromDistance >= 0.0f) {
+				clipped[clippedCount++] = from;
+			}
+
+			if ((fromDistance >= 0.0f) != (toDistance >= 0.0f)) {
+				float t = fromDistance / (fromDistance - toDistance);
+
+				ClipVertex& crossing = clipped[clippedCount++];
+				crossing.position = from.position + (to.position - from.position) * t;
+				crossing.texCoord = from.texCoord + (to.texCoord - from.texCoord) * t;
+			}
+		}
+
+		std::copy(clipped, clipped + clippedCount, polygon);
+		count = clippedCount;
+	}
+
+	//a fan keeps the winding of the original triangle
+	for (int i = 1; i + 1 < count; i++) {
+		ClipVertex triangle[3] = { polygon[0], polygon[i], polygon[i + 1] };
+		emitTriangle(triangle, texture, chunk);
+	}
+}
+
+//false when the triangle misses the whole area, which is never more than a tile across
+static bool setupEdges(const int32_t* x, const int32_t* y, int32_t startX, int32_t startY, EdgeSetup& edges) {
+	int64_t sampleX = int64_t(startX) * 16 + 8;
+	int64_t sampleY = int64_t(startY) * 16 + 8;
+
+	for (int edge = 0; edge < 3; edge++) {
+		int from = edge;
+		int to = (edge + 1) % 3;
+
+		int64_t a = int64_t(y[from]) - y[to];
+		int64_t b = int64_t(x[to]) - x[from];
+		int64_t value = a * (sampleX - x[from]) + b * (sampleY - y[from]);
+
+		//top left rule, a centre exactly on an edge only belongs to the triangle if it is a top or left edge
+		bool topLeft = a > 0 || (a == 0 && b > 0);
+		if (!topLeft) {
+			value -= 1;
+		}
+
+		if (value < -EDGE_LIMIT) {
+			return false;
+		}
+
+		edges.row[edge] = static_cast<int32_t>(std::min(value, EDGE_LIMIT));
+		edges.stepX[edge] = static_cast<int32_t>(a * 16);
+		edges.stepY[edge] = static_cast<int32_t>(b * 16);
+	}
+
+	return true;
+}
+
+//texel of a repeating level, x and y can be one past either side
+static inline uint32_t fetchTexel(const uint32_t* texels, int32_t x, int32_t y, int32_t levelWidth, int32_t levelHeight) {
+	x = x < 0 ? levelWidth - 1 : (x >= levelWidth ? 0 : x);
+	y = y < 0 ? levelHeight - 1 : (y >= levelHeight ? 0 : y);
+
+	return texels[size_t(y) * levelWidth + x];
+}
+
+/* bilinear from the level the screen space footprint of the pixel asks for, rounded to the nearest one.
+	the derivatives come from the planes, so there is no need to shade pixels in quads*/
+static uint32_t sampleTexture(const MipChain& texture, float u, float v, float footprint) {
+	uint32_t level = 0;
+	if (footprint > 1.0f) {
+		float lod = std::log2(footprint);
+		level = std::min(static_cast<uint32_t>(lod + 0.5f), static_cast<uint32_t>(texture.levels.size()) - 1);
+	}
+
+	const MipLevel& mip = texture.levels[level];
+	const uint32_t* texels = reinterpret_cast<const uint32_t*>(texture.data.data() + mip.offset);
+	int32_t levelWidth = static_cast<int32_t>(mip.width);
+	int32_t levelHeight = static_cast<int32_t>(mip.height);
+
+	//wrapped first so huge uvs do not overflow the texel numbers
+	u -= std::floor(u);
+	v -= std::floor(v);
+
+	float texelX = u * levelWidth - 0.5f;
+	float texelY = v * levelHeight - 0.5f;
+	float floorX = std::floor(texelX);
+	float floorY = std::floor(texelY);
+
+	int32_t x0 = static_cast<int32_t>(floorX);
+	int32_t y0 = static_cast<int32_t>(floorY);
+	uint32_t fractionX = static_cast<uint32_t>((texelX - floorX) * 256.0f);
+	uint32_t fractionY = static_cast<uint32_t>((texelY - floorY) * 256.0f);
+
+	uint32_t topLeft = fetchTexel(texels, x0, y0, levelWidth, levelHeight);
+	uint32_t topRight = fetchTexel(texels, x0 + 1, y0, levelWidth, levelHeight);
+	uint32_t bottomLeft = fetchTexel(texels, x0, y0 + 1, levelWidth, levelHeight);
+	uint32_t bottomRight = fetchTexel(texels, x0 + 1, y0 + 1, levelWidth, levelHeight);
+
+	uint32_t result = 0;
+	for (uint32_t shift = 0; shift < 32; shift += 8) {
+		uint32_t top = ((topLeft >> shift) & 0xff) * (256 - fractionX) + ((topRight >> shift) & 0xff) * fractionX;
+		uint32_t bottom = ((bottomLeft >> shift) & 0xff) * (256 - fractionX) + ((bottomRight >> shift) & 0xff) * fractionX;
+		uint32_t channel = (top * (256 - fractionY) + bottom * fractionY + 32768) >> 16;
+
+		result |= channel << shift;
+	}
+
+	return result;
+}
+
+//the depth test has passed, perspective correct uvs and the texture
+static inline void shadePixel(const RasterTriangle& triangle, int32_t x, int32_t y, uint32_t& pixel) {
+	if (triangle.texture == nullptr) {
+		pixel = 0xffffffff;
+		return;
+	}
+
+	float pixelX = static_cast<float>(x);
+	float pixelY = static_cast<float>(y);
+
+	const glm::vec3& q = triangle.inverseW;
+	const glm::vec3& s = triangle.uOverW;
+	const glm::vec3& t = triangle.vOverW;
+
+	float w = 1.0f / (q.x * pixelX + q.y * pixelY + q.z);
+	float u = (s.x * pixelX + s.y * pixelY + s.z) * w;
+	float v = (t.x * pixelX + t.y * pixelY + t.z) * w;
+
+	//d(s/q) = (ds - s/q dq) / q
+	const MipChain& texture = *triangle.texture;
+	float dudx = (s.x - u * q.x) * w * texture.width;
+	float dvdx = (t.x - v * q.x) * w * texture.height;
+	float dudy = (s.y - u * q.y) * w * texture.width;
+	float dvdy = (t.y - v * q.y) * w * texture.height;
+	float footprint = std::sqrt(std::max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy));
+
+	pixel = sampleTexture(texture, u, v, footprint);
+}
+
+static void rasterizeScalar(const RasterTriangle& triangle, const EdgeSetup& edges, int32_t startX, int32_t startY, int32_t endX, int32_t endY,
+	uint32_t* color, float* depth, uint32_t pitch) {
+	int32_t row[3] = { edges.row[0], edges.row[1], edges.row[2] };
+
+	for (int32_t y = startY; y <= endY; y++) {
+		int32_t e0 = row[0];
+		int32_t e1 = row[1];
+		int32_t e2 = row[2];
+
+		for (int32_t x = startX; x <= endX; x++) {
+			if ((e0 | e1 | e2) >= 0) {
+				float z = triangle.depth.x * x + triangle.depth.y * y + triangle.depth.z;
+				size_t pixel = size_t(y) * pitch + x;
+
+				if (z < depth[pixel]) {
+					depth[pixel] = z;
+					shadePixel(triangle, x, y, color[pixel]);
+				}
+			}
+
+			e0 += edges.stepX[0];
+			e1 += edges.stepX[1];
+			e2 += edges.stepX[2];
+		}
+
+		for (int edge = 0; edge < 3; edge++) {
+			row[edge] += edges.stepY[edge];
+		}
+	}
+}
+
+/* 8 pixels of a row at once, coverage is the sign bits of the three edge values or'd together.
+	the depth test is done for all 8 too and only the pixels that pass are shaded*/
+RASTER_AVX2 static void rasterizeAvx2(const RasterTriangle& triangle, const EdgeSetup& edges, int32_t startX, int32_t startY, int32_t endX, int32_t endY,
+	uint32_t* color, float* depth, uint32_t pitch) {
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	const __m256 laneOffsets = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+
+	__m256i laneSteps[3];
+	__m256i spanSteps[3];
+	for (int edge = 0; edge < 3; edge++) {
+		laneSteps[edge] = _mm256_mullo_epi32(lanes, _mm256_set1_epi32(edges.stepX[edge]));
+		spanSteps[edge] = _mm256_set1_epi32(edges.stepX[edge] * 8);
+	}
+
+	__m256 depthStep = _mm256_set1_ps(triangle.depth.x * 8.0f);
+	__m256 depthLanes = _mm256_mul_ps(laneOffsets, _mm256_set1_ps(triangle.depth.x));
+
+	int32_t row[3] = { edges.row[0], edges.row[1], edges.row[2] };
+
+	for (int32_t y = startY; y <= endY; y++) {
+		__m256i e0 = _mm256_add_epi32(_mm256_set1_epi32(row[0]), laneSteps[0]);
+		__m256i e1 = _mm256_add_epi32(_mm256_set1_epi32(row[1]), laneSteps[1]);
+		__m256i e2 = _mm256_add_epi32(_mm256_set1_epi32(row[2]), laneSteps[2]);
+
+		float rowDepth = triangle.depth.x * startX + triangle.depth.y * y + triangle.depth.z;
+		__m256 z = _mm256_add_ps(_mm256_set1_ps(rowDepth), depthLanes);
+
+		for (int32_t x = startX; x <= endX; x += 8) {
+			int32_t count = std::min(endX - x + 1, 8);
+			int covered = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_or_si256(_mm256_or_si256(e0, e1), e2))) & ((1 << count) - 1);
+
+			if (covered) {
+				size_t pixel = size_t(y) * pitch + x;
+
+				//masked so the last span of the screen never reads past the row
+				__m256i inRow = _mm256_cmpgt_epi32(_mm256_set1_epi32(count), lanes);
+				__m256 stored = _mm256_maskload_ps(depth + pixel, inRow);
+				int passed = covered & _mm256_movemask_ps(_mm256_cmp_ps(z, stored, _CMP_LT_OQ));
+
+				if (passed) {
+					__m256i writeMask = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(passed), laneBits), laneBits);
+					_mm256_maskstore_ps(depth + pixel, writeMask, z);
+
+					for (int lane = 0; lane < count; lane++) {
+						if (passed & (1 << lane)) {
+							shadePixel(triangle, x + lane, y, color[pixel + lane]);
+						}
+					}
+				}
+			}
+
+			e0 = _mm256_add_epi32(e0, spanSteps[0]);
+			e1 = _mm256_add_epi32(e1, spanSteps[1]);
+			e2 = _mm256_add_epi32(e2, spanSteps[2]);
+			z = _mm256_add_ps(z, depthStep);
+		}
+
+		for (int edge = 0; edge < 3; edge++) {
+			row[edge] += edges.stepY[edge];
+		}
+	}
+}
+
+//clears the tile then replays every chunk's triangles for it in the order they were drawn
+void SoftwareRasterizer::rasterizeTile(uint32_t tile) {
+	int32_t tileX = static_cast<int32_t>(tile % tilesX) * RASTER_TILE_SIZE;
+	int32_t tileY = static_cast<int32_t>(tile / tilesX) * RASTER_TILE_SIZE;
+	int32_t tileEndX = std::min(tileX + RASTER_TILE_SIZE, static_cast<int32_t>(width)) - 1;
+	int32_t tileEndY = std::min(tileY + RASTER_TILE_SIZE, static_cast<int32_t>(height)) - 1;
+
+	for (int32_t y = tileY; y <= tileEndY; y++) {
+		size_t rowStart = size_t(y) * width;
+		//opaque black, the same clear colour the render pass uses
+		std::fill(color.begin() + rowStart + tileX, color.begin() + rowStart + tileEndX + 1, 0xff000000u);
+		std::fill(depth.begin() + rowStart + tileX, depth.begin() + rowStart + tileEndX + 1, 1.0f);
+	}
+
+	bool avx2 = usesAvx2() && !forceScalar;
+
+	for (const SetupChunk& chunk : chunks) {
+		for (uint32_t index : chunk.tiles[tile]) {
+			const RasterTriangle& triangle = chunk.triangles[index];
+
+			int32_t startX = std::max(triangle.minX, tileX);
+			int32_t startY = std::max(triangle.minY, tileY);
+			int32_t endX = std::min(triangle.maxX, tileEndX);
+			int32_t endY = std::min(triangle.maxY, tileEndY);
+
+			EdgeSetup edges;
+			if (!setupEdges(triangle.x, triangle.y, startX, startY, edges)) {
+				continue;
+			}
+
+			if (avx2) {
+				rasterizeAvx2(triangle, edges, startX, startY, endX, endY, color.data(), depth.data(), width);
+			}
+			else {
+				rasterizeScalar(triangle, edges, startX, startY, endX, endY, color.data(), depth.data(), width);
+			}
+		}
+	}
+}
+
+void SoftwareRasterizer::render(const std::vector<RasterDraw>& draws, ThreadPool& pool) {
+	vertexStarts.assign(1, 0);
+	triangleStarts.assign(1, 0);
+	for (const RasterDraw& draw : draws) {
+		vertexStarts.push_back(vertexStarts.back() + draw.vertexCount);
+		triangleStarts.push_back(triangleStarts.back() + draw.indexCount / 3);
+	}
+
+	size_t vertexCount = vertexStarts.back();
+	size_t triangleCount = triangleStarts.back();
+
+	//the draw that the first item of a task belongs to, empty draws are skipped over
+	auto firstDraw = [](const std::vector<size_t>& starts, size_t item) {
+		return static_cast<size_t>(std::upper_bound(starts.begin(), starts.end(), item) - starts.begin()) - 1;
+	};
+
+	clipVertices.resize(vertexCount);
+	pool.parallelFor(vertexCount, TRANSFORM_GRAIN, [&](size_t begin, size_t end) {
+		size_t drawIndex = firstDraw(vertexStarts, begin);
+
+		for (size_t i = begin; i < end; i++) {
+			while (i >= vertexStarts[drawIndex + 1]) {
+				drawIndex++;
+			}
+
+			const RasterDraw& draw = draws[drawIndex];
+			size_t vertex = i - vertexStarts[drawIndex];
+			const float* position = draw.positions + vertex * draw.stride;
+
+			clipVertices[i].position = draw.mvp * glm::vec4(position[0], position[1], position[2], 1.0f);
+			clipVertices[i].texCoord = glm::vec2(0.0f);
+			if (draw.texCoords != nullptr) {
+				clipVertices[i].texCoord = glm::vec2(draw.texCoords[vertex * draw.stride], draw.texCoords[vertex * draw.stride + 1]);
+			}
+		}
+	});
+
+	//one chunk per setup task, the chunk and tile vectors keep their memory from frame to frame
+	size_t chunkCount = (triangleCount + SETUP_GRAIN - 1) / SETUP_GRAIN;
+	if (chunks.size() < chunkCount) {
+		chunks.resize(chunkCount);
+	}
+	for (SetupChunk& chunk : chunks) {
+		chunk.triangles.clear();
+		chunk.tiles.resize(size_t(tilesX) * tilesY);
+		for (auto& tile : chunk.tiles) {
+			tile.clear();
+		}
+	}
+
+	pool.parallelFor(triangleCount, SETUP_GRAIN, [&](size_t begin, size_t end) {
+		SetupChunk& chunk = chunks[begin / SETUP_GRAIN];
+		size_t drawIndex = firstDraw(triangleStarts, begin);
+
+		for (size_t i = begin; i < end; i++) {
+			while (i >= triangleStarts[drawIndex + 1]) {
+				drawIndex++;
+			}
+
+			const RasterDraw& draw = draws[drawIndex];
+			const uint32_t* indices = draw.indices + (i - triangleStarts[drawIndex]) * 3;
+			const ClipVertex* vertices = clipVertices.data() + vertexStarts[drawIndex];
+
+			setupTriangle(vertices[indices[0]], vertices[indices[1]], vertices[indices[2]], draw.texture, chunk);
+		}
+	});
+
+	//each tile belongs to one worker, so nothing is shared while they draw
+	pool.parallelFor(size_t(tilesX) * tilesY, 1, [&](size_t begin, size_t end) {
+		for (size_t tile = begin; tile < end; tile++) {
+			rasterizeTile(static_cast<uint32_t>(tile));
+		}
+	});
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ThreadPool.h"
+#include "TextureProcessing.h"
+
+/* draws triangles on the cpu for machines without a gpu, following the same rules as the graphics pipeline:
+	counter clockwise front faces with the back faces culled, a less than depth test against 1 and the colour
+	straight from a bilinear repeating texture. the screen is cut into tiles, each triangle is binned into the tiles
+	its bounds touch and then every tile is rasterized by one worker with edge functions, 8 pixels at a time when the cpu has avx2.
+	nothing here needs vulkan*/
+
+//pixels along each side of a tile
+static const int32_t RASTER_TILE_SIZE = 64;
+//pixels a triangle can reach past the middle of the screen before it is clipped, keeps the edge functions inside 32 bits in a tile
+static const float RASTER_GUARD_BAND = 2048.0f;
+
+//one draw call, positions are 3 floats and uvs 2 read every stride floats like a vertex buffer
+struct RasterDraw {
+	const float* positions;
+	const float* texCoords;
+	size_t stride;
+	size_t vertexCount;
+	const uint32_t* indices;
+	size_t indexCount;
+	//rgba8 levels down to 1x1, null draws white
+	const MipChain* texture;
+	//to clip space, z from 0 to 1 and y flipped like the vulkan projection
+	glm::mat4 mvp;
+};
+
+//what setup leaves for the tiles, wound so that the edge functions are positive inside
+struct RasterTriangle {
+	//1/16 pixel fixed point
+	int32_t x[3];
+	int32_t y[3];
+	//pixels whose centre might be covered, already inside the screen
+	int32_t minX;
+	int32_t minY;
+	int32_t maxX;
+	int32_t maxY;
+	//planes over the pixel grid, value = x * plane.x + y * plane.y + plane.z at the centre of pixel x y
+	glm::vec3 depth;
+	glm::vec3 inverseW;
+	glm::vec3 uOverW;
+	glm::vec3 vOverW;
+	const MipChain* texture;
+};
+
+class SoftwareRasterizer {
+public:
+	SoftwareRasterizer(uint32_t width, uint32_t height);
+
+	//clears to black and depth 1, then draws everything in order
+	void render(const std::vector<RasterDraw>& draws, ThreadPool& pool);
+
+	//rgba8 top row first, the same layout the captures are written in
+	const std::vector<uint32_t>& colorBuffer() const { return color; }
+	uint32_t getWidth() const { return width; }
+	uint32_t getHeight() const { return height; }
+
+	//picked once from cpuid, the scalar loop is used otherwise
+	static bool usesAvx2();
+	//for comparing the two, only turns avx2 off
+	bool forceScalar = false;
+
+private:
+	struct ClipVertex {
+		glm::vec4 position;
+		glm::vec2 texCoord;
+	};
+
+	//what one setup task produced, kept apart so the tiles can replay the chunks in draw order without locking
+	struct SetupChunk {
+		std::vector<RasterTriangle> triangles;
+		//indices into triangles for each tile
+		std::vector<std::vector<uint32_t>> tiles;
+	};
+
+	void setupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, const MipChain* texture, SetupChunk& chunk);
+	void emitTriangle(const ClipVertex* vertices, const MipChain* texture, SetupChunk& chunk);
+	void rasterizeTile(uint32_t tile);
+
+	uint32_t width;
+	uint32_t height;
+	uint32_t tilesX;
+	uint32_t tilesY;
+	//how far the guard band reaches in clip space, as a multiple of w
+	float guardX;
+	float guardY;
+
+	std::vector<uint32_t> color;
+	std::vector<float> depth;
+
+	//where each draw's vertices and triangles start once every draw's are numbered together
+	std::vector<size_t> vertexStarts;
+	std::vector<size_t> triangleStarts;
+	std::vector<ClipVertex> clipVertices;
+	std::vector<SetupChunk> chunks;
+};
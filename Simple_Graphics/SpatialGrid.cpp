@@ -0,0 +1,267 @@
+#include "SpatialGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//cube coordinates are packed 21 bits to an axis into the hash keys, centred on the origin
+static const int32_t SPATIAL_COORDINATE_BIAS = 1 << 20;
+static const int32_t SPATIAL_COORDINATE_MAX = (1 << 21) - 1;
+
+static uint64_t packCell(const glm::ivec3& cell) {
+	return (static_cast<uint64_t>(cell.x + SPATIAL_COORDINATE_BIAS) << 42) |
+		(static_cast<uint64_t>(cell.y + SPATIAL_COORDINATE_BIAS) << 21) |
+		static_cast<uint64_t>(cell.z + SPATIAL_COORDINATE_BIAS);
+}
+
+static glm::ivec3 unpackCell(uint64_t key) {
+	return glm::ivec3(static_cast<int32_t>((key >> 42) & SPATIAL_COORDINATE_MAX) - SPATIAL_COORDINATE_BIAS,
+		static_cast<int32_t>((key >> 21) & SPATIAL_COORDINATE_MAX) - SPATIAL_COORDINATE_BIAS,
+		static_cast<int32_t>(key & SPATIAL_COORDINATE_MAX) - SPATIAL_COORDINATE_BIAS);
+}
+
+//points past the edge of what the keys can hold all land in the outermost cubes
+static glm::ivec3 cellOf(const glm::vec3& point, float cellSize) {
+	glm::vec3 cell = glm::floor(point / cellSize);
+	cell = glm::clamp(cell, static_cast<float>(-SPATIAL_COORDINATE_BIAS), static_cast<float>(SPATIAL_COORDINATE_BIAS - 1));
+
+	return glm::ivec3(cell);
+}
+
+SpatialGrid::SpatialGrid() {
+	for (uint32_t i = 0; i < SPATIAL_LEVELS; i++) {
+		levels[i].cellSize = SPATIAL_CELL_SIZE * static_cast<float>(1u << i);
+		levels[i].reach = levels[i].cellSize * 0.5f;
+	}
+}
+
+uint32_t SpatialGrid::insert(const glm::vec3& center, float radius, uint32_t value) {
+	uint32_t handle;
+	if (!freeItems.empty()) {
+		handle = freeItems.back();
+		freeItems.pop_back();
+	}
+	else {
+		handle = static_cast<uint32_t>(items.size());
+		items.emplace_back();
+	}
+
+	Item& item = items[handle];
+	item.center = center;
+	item.radius = radius;
+	item.value = value;
+	item.queryNumber = queryNumber;
+
+	place(handle);
+
+	return handle;
+}
+
+//most moves stay inside the same cube, and then only the sphere is written
+void SpatialGrid::move(uint32_t handle, const glm::vec3& center, float radius) {
+	Item& item = items[handle];
+	uint32_t level = levelFor(radius);
+
+	item.center = center;
+	item.radius = radius;
+
+	if (level == item.level && packCell(cellOf(center, levels[level].cellSize)) == item.cell) {
+		return;
+	}
+
+	unplace(handle);
+	place(handle);
+}
+
+void SpatialGrid::remove(uint32_t handle) {
+	unplace(handle);
+	freeItems.push_back(handle);
+}
+
+void SpatialGrid::queryFrustums(const glm::mat4* viewProjections, uint32_t count, std::vector<uint32_t>& values) {
+	queryNumber++;
+
+	for (uint32_t f = 0; f < count; f++) {
+		const glm::mat4& viewProjection = viewProjections[f];
+
+		//frustum planes are sums and differences of the rows, depth goes from 0 to 1
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++) {
+			rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		}
+
+		std::array<glm::vec4, 6> planes = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2] };
+		for (auto& plane : planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+
+		//the cubes to look at are the ones around the frustum's corners
+		glm::mat4 inverse = glm::inverse(viewProjection);
+		glm::vec3 boxMin = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 boxMax = glm::vec3(-std::numeric_limits<float>::max());
+		for (int corner = 0; corner < 8; corner++) {
+			glm::vec4 point = inverse * glm::vec4(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : 0.0f, 1.0f);
+			glm::vec3 position = glm::vec3(point) / point.w;
+
+			boxMin = glm::min(boxMin, position);
+			boxMax = glm::max(boxMax, position);
+		}
+
+		for (const Level& level : levels) {
+			if (level.cells.empty()) {
+				continue;
+			}
+
+			gatherCells(level, boxMin, boxMax);
+
+			for (const GatheredCell& cell : gathered) {
+				glm::vec3 cellMin = glm::vec3(cell.coordinates.x, cell.coordinates.y, cell.coordinates.z) * level.cellSize - level.reach;
+				glm::vec3 cellMax = cellMin + level.cellSize + 2.0f * level.reach;
+
+				//whole cubes are thrown out or taken in when they are on one side of every plane
+				bool outside = false;
+				bool inside = true;
+				for (const auto& plane : planes) {
+					glm::vec3 normal = glm::vec3(plane);
+					glm::vec3 farthest;
+					glm::vec3 nearest;
+					for (int axis = 0; axis < 3; axis++) {
+						farthest[axis] = normal[axis] > 0.0f ? cellMax[axis] : cellMin[axis];
+						nearest[axis] = normal[axis] > 0.0f ? cellMin[axis] : cellMax[axis];
+					}
+
+					if (glm::dot(normal, farthest) + plane.w < 0.0f) {
+						outside = true;
+						break;
+					}
+					inside = inside && glm::dot(normal, nearest) + plane.w >= 0.0f;
+				}
+
+				if (outside) {
+					continue;
+				}
+
+				for (uint32_t handle : *cell.handles) {
+					const Item& item = items[handle];
+
+					bool visible = true;
+					for (size_t p = 0; p < planes.size() && visible && !inside; p++) {
+						visible = glm::dot(glm::vec3(planes[p]), item.center) + planes[p].w >= -item.radius;
+					}
+
+					if (visible && firstSighting(handle)) {
+						values.push_back(item.value);
+					}
+				}
+			}
+		}
+	}
+}
+
+void SpatialGrid::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& values) {
+	queryNumber++;
+
+	for (const Level& level : levels) {
+		if (level.cells.empty()) {
+			continue;
+		}
+
+		gatherCells(level, center - radius, center + radius);
+
+		for (const GatheredCell& cell : gathered) {
+			for (uint32_t handle : *cell.handles) {
+				const Item& item = items[handle];
+				glm::vec3 offset = item.center - center;
+
+				if (glm::dot(offset, offset) <= (radius + item.radius) * (radius + item.radius) && firstSighting(handle)) {
+					values.push_back(item.value);
+				}
+			}
+		}
+	}
+}
+
+void SpatialGrid::place(uint32_t handle) {
+	Item& item = items[handle];
+	item.level = levelFor(item.radius);
+
+	Level& level = levels[item.level];
+	level.reach = std::max(level.reach, item.radius);
+	item.cell = packCell(cellOf(item.center, level.cellSize));
+
+	std::vector<uint32_t>& cell = level.cells[item.cell];
+	item.slot = static_cast<uint32_t>(cell.size());
+	cell.push_back(handle);
+}
+
+//the last one in the cube takes the place of the one leaving, and empty cubes are dropped so they are not gone through again
+void SpatialGrid::unplace(uint32_t handle) {
+	const Item& item = items[handle];
+	Level& level = levels[item.level];
+
+	auto found = level.cells.find(item.cell);
+	std::vector<uint32_t>& cell = found->second;
+
+	uint32_t last = cell.back();
+	cell[item.slot] = last;
+	items[last].slot = item.slot;
+	cell.pop_back();
+
+	if (cell.empty()) {
+		level.cells.erase(found);
+	}
+}
+
+//the finest level whose cubes are at least as big across as the sphere
+uint32_t SpatialGrid::levelFor(float radius) const {
+	uint32_t level = 0;
+	while (level + 1 < SPATIAL_LEVELS && levels[level].cellSize < radius * 2.0f) {
+		level++;
+	}
+
+	return level;
+}
+
+void SpatialGrid::gatherCells(const Level& level, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+	gathered.clear();
+
+	//a sphere from a cube can reach this far out of it, so the cubes holding the centres are the ones in the box grown by that
+	glm::ivec3 first = cellOf(boxMin - level.reach, level.cellSize);
+	glm::ivec3 last = cellOf(boxMax + level.reach, level.cellSize);
+	double volume = (last.x - first.x + 1.0) * (last.y - first.y + 1.0) * (last.z - first.z + 1.0);
+
+	//a huge box over a sparse level is cheaper to answer by going through the cubes that are there
+	if (volume > static_cast<double>(level.cells.size())) {
+		for (const auto& cell : level.cells) {
+			glm::ivec3 coordinates = unpackCell(cell.first);
+			bool within = coordinates.x >= first.x && coordinates.y >= first.y && coordinates.z >= first.z &&
+				coordinates.x <= last.x && coordinates.y <= last.y && coordinates.z <= last.z;
+
+			if (within) {
+				gathered.push_back({ coordinates, &cell.second });
+			}
+		}
+		return;
+	}
+
+	for (int32_t z = first.z; z <= last.z; z++) {
+		for (int32_t y = first.y; y <= last.y; y++) {
+			for (int32_t x = first.x; x <= last.x; x++) {
+				auto found = level.cells.find(packCell(glm::ivec3(x, y, z)));
+
+				if (found != level.cells.end()) {
+					gathered.push_back({ glm::ivec3(x, y, z), &found->second });
+				}
+			}
+		}
+	}
+}
+
+bool SpatialGrid::firstSighting(uint32_t handle) {
+	if (items[handle].queryNumber == queryNumber) {
+		return false;
+	}
+
+	items[handle].queryNumber = queryNumber;
+	return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/* a loose grid over bounding spheres for finding what is in view or near a point without going through everything.
+	there are several levels of cubes, each twice the size of the one below, and a sphere lives in the one cube of the finest
+	level at least as big across as it is that holds its centre. only cubes with something in them are kept, in a hash map per level,
+	so the grid has no edges and costs nothing where the scene is empty. spheres are put in, moved and taken out one at a time*/
+
+//size of the cubes of the finest level
+static const float SPATIAL_CELL_SIZE = 2.0f;
+//levels of cubes, anything bigger than the top level's cubes goes in them anyway
+static const uint32_t SPATIAL_LEVELS = 12;
+
+class SpatialGrid {
+public:
+	SpatialGrid();
+
+	//value is handed back by the queries, the handle is what the sphere is moved and removed by
+	uint32_t insert(const glm::vec3& center, float radius, uint32_t value);
+	void move(uint32_t handle, const glm::vec3& center, float radius);
+	void remove(uint32_t handle);
+
+	/* the values of the spheres at least partly inside any of the frustums, each one once, appended to values.
+		frustums are given as view projection matrices with depth from 0 to 1*/
+	void queryFrustums(const glm::mat4* viewProjections, uint32_t count, std::vector<uint32_t>& values);
+	//the values of the spheres that touch this one
+	void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& values);
+
+	size_t size() const { return items.size() - freeItems.size(); }
+
+private:
+	struct Item {
+		glm::vec3 center;
+		float radius;
+		uint32_t value;
+		uint32_t level;
+		uint64_t cell;
+		//place in the cell's list
+		uint32_t slot;
+		//the query that last returned it, so spheres seen by several frustums are only returned once
+		uint32_t queryNumber;
+	};
+
+	struct Level {
+		std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+		float cellSize;
+		//how far a sphere can reach out of its cube, half a cube except at the top where anything can end up
+		float reach;
+	};
+
+	struct GatheredCell {
+		glm::ivec3 coordinates;
+		const std::vector<uint32_t>* handles;
+	};
+
+	void place(uint32_t handle);
+	void unplace(uint32_t handle);
+	uint32_t levelFor(float radius) const;
+	//the cubes of a level whose spheres could reach into the box, either by looking each one up or by going through the level
+	void gatherCells(const Level& level, const glm::vec3& boxMin, const glm::vec3& boxMax);
+	//marks the item as seen by this query, false if it already was
+	bool firstSighting(uint32_t handle);
+
+	std::vector<Item> items;
+	std::vector<uint32_t> freeItems;
+	std::array<Level, SPATIAL_LEVELS> levels;
+	uint32_t queryNumber = 0;
+	//what gatherCells found, kept to save allocating every query
+	std::vector<GatheredCell> gathered;
+};
@@ -0,0 +1,806 @@
+#include "TextureCompression.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <emmintrin.h>
+
+#include "stb_image.h"
+
+//one 4x4 block split into channels so four pixels can be compared against the palette at once
+struct alignas(16) Block {
+	float r[16];
+	float g[16];
+	float b[16];
+	float a[16];
+};
+
+//where each of the 16 bc7 indices sits between the two end points, out of 64
+static const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+uint32_t blockSize(BlockFormat format) {
+	return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+std::string compressedTexturePath(const std::string& texturePath, BlockFormat format) {
+	static const char* suffixes[] = { ".bc1.dds", ".bc3.dds", ".bc7.dds" };
+
+	size_t slash = texturePath.find_last_of("/\\");
+	size_t dot = texturePath.find_last_of('.');
+	std::string stem = dot != std::string::npos && (slash == std::string::npos || dot > slash) ? texturePath.substr(0, dot) : texturePath;
+
+	return stem + suffixes[static_cast<int>(format)];
+}
+
+static void loadBlock(const unsigned char* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, Block& block) {
+	for (uint32_t y = 0; y < 4; y++) {
+		for (uint32_t x = 0; x < 4; x++) {
+			//blocks hanging off the edge repeat the last row/column, those texels are never sampled anyway
+			uint32_t pixelX = std::min(blockX * 4 + x, width - 1);
+			uint32_t pixelY = std::min(blockY * 4 + y, height - 1);
+			const unsigned char* pixel = rgba + (static_cast<size_t>(pixelY) * width + pixelX) * 4;
+			uint32_t i = y * 4 + x;
+
+			block.r[i] = pixel[0];
+			block.g[i] = pixel[1];
+			block.b[i] = pixel[2];
+			block.a[i] = pixel[3];
+		}
+	}
+}
+
+/* picks the closest palette entry for every pixel, four pixels per step.
+	returns the total weighted squared error so different end points can be compared.
+	pixels left out by include keep whatever index they had and add nothing to the error, null includes every pixel*/
+static float fitIndices(const Block& block, const float (*palette)[4], int paletteSize, const float weights[4], const bool* include, uint8_t indices[16]) {
+	const __m128 weightR = _mm_set1_ps(weights[0]);
+	const __m128 weightG = _mm_set1_ps(weights[1]);
+	const __m128 weightB = _mm_set1_ps(weights[2]);
+	const __m128 weightA = _mm_set1_ps(weights[3]);
+
+	float total = 0.0f;
+
+	for (int i = 0; i < 16; i += 4) {
+		__m128 r = _mm_load_ps(&block.r[i]);
+		__m128 g = _mm_load_ps(&block.g[i]);
+		__m128 b = _mm_load_ps(&block.b[i]);
+		__m128 a = _mm_load_ps(&block.a[i]);
+
+		__m128 bestError = _mm_set1_ps(FLT_MAX);
+		__m128i bestIndex = _mm_setzero_si128();
+
+		for (int p = 0; p < paletteSize; p++) {
+			__m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[p][0]));
+			__m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[p][1]));
+			__m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[p][2]));
+			__m128 da = _mm_sub_ps(a, _mm_set1_ps(palette[p][3]));
+
+			__m128 error = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_mul_ps(dr, dr), weightR), _mm_mul_ps(_mm_mul_ps(dg, dg), weightG)),
+				_mm_add_ps(_mm_mul_ps(_mm_mul_ps(db, db), weightB), _mm_mul_ps(_mm_mul_ps(da, da), weightA)));
+
+			//sse2 has no blend, so select with and/andnot on the compare mask
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(error, bestError));
+			bestError = _mm_min_ps(error, bestError);
+			bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIndex));
+		}
+
+		alignas(16) int32_t chosen[4];
+		alignas(16) float errors[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(chosen), bestIndex);
+		_mm_store_ps(errors, bestError);
+
+		for (int j = 0; j < 4; j++) {
+			if (include && !include[i + j]) {
+				continue;
+			}
+
+			indices[i + j] = static_cast<uint8_t>(chosen[j]);
+			total += errors[j];
+		}
+	}
+
+	return total;
+}
+
+//end points along the direction the included pixels vary the most, only the first channelCount channels are looked at
+static void principalEndpoints(const Block& block, const bool include[16], int channelCount, float endpoint0[4], float endpoint1[4]) {
+	const float* channels[4] = { block.r, block.g, block.b, block.a };
+
+	float mean[4] = {};
+	int count = 0;
+
+	for (int i = 0; i < 16; i++) {
+		if (include[i]) {
+			for (int c = 0; c < 4; c++) {
+				mean[c] += channels[c][i];
+			}
+			count++;
+		}
+	}
+
+	if (count == 0) {
+		for (int c = 0; c < 4; c++) {
+			endpoint0[c] = endpoint1[c] = 0.0f;
+		}
+		return;
+	}
+
+	for (int c = 0; c < 4; c++) {
+		mean[c] /= count;
+		endpoint0[c] = endpoint1[c] = mean[c];
+	}
+
+	float covariance[4][4] = {};
+
+	for (int i = 0; i < 16; i++) {
+		if (!include[i]) {
+			continue;
+		}
+
+		for (int j = 0; j < channelCount; j++) {
+			for (int k = 0; k < channelCount; k++) {
+				covariance[j][k] += (channels[j][i] - mean[j]) * (channels[k][i] - mean[k]);
+			}
+		}
+	}
+
+	//start from the row of the channel that varies most, the all ones vector can be orthogonal to the answer
+	int widest = 0;
+	for (int c = 1; c < channelCount; c++) {
+		if (covariance[c][c] > covariance[widest][widest]) {
+			widest = c;
+		}
+	}
+
+	float axis[4] = {};
+	for (int c = 0; c < channelCount; c++) {
+		axis[c] = covariance[widest][c];
+	}
+
+	//power iteration, a few steps is plenty for 16 points
+	for (int iteration = 0; iteration < 8; iteration++) {
+		float next[4] = {};
+		float largest = 0.0f;
+
+		for (int j = 0; j < channelCount; j++) {
+			for (int k = 0; k < channelCount; k++) {
+				next[j] += covariance[j][k] * axis[k];
+			}
+			largest = std::max(largest, std::fabs(next[j]));
+		}
+
+		if (largest < 1e-6f) {
+			break;
+		}
+
+		for (int c = 0; c < channelCount; c++) {
+			axis[c] = next[c] / largest;
+		}
+	}
+
+	float length = 0.0f;
+	for (int c = 0; c < channelCount; c++) {
+		length += axis[c] * axis[c];
+	}
+
+	//every pixel is the same, both end points stay on the mean
+	if (length < 1e-12f) {
+		return;
+	}
+
+	length = std::sqrt(length);
+	for (int c = 0; c < channelCount; c++) {
+		axis[c] /= length;
+	}
+
+	float minProjection = FLT_MAX;
+	float maxProjection = -FLT_MAX;
+
+	for (int i = 0; i < 16; i++) {
+		if (!include[i]) {
+			continue;
+		}
+
+		float projection = 0.0f;
+		for (int c = 0; c < channelCount; c++) {
+			projection += (channels[c][i] - mean[c]) * axis[c];
+		}
+
+		minProjection = std::min(minProjection, projection);
+		maxProjection = std::max(maxProjection, projection);
+	}
+
+	for (int c = 0; c < channelCount; c++) {
+		endpoint0[c] = std::min(255.0f, std::max(0.0f, mean[c] + minProjection * axis[c]));
+		endpoint1[c] = std::min(255.0f, std::max(0.0f, mean[c] + maxProjection * axis[c]));
+	}
+}
+
+/* least squares end points for a fixed set of indices, indexWeights says where each index sits between them.
+	false if the indices do not pin the end points down, e.g. every pixel picked the same one*/
+static bool refitEndpoints(const Block& block, const uint8_t indices[16], const float* indexWeights, const bool include[16], int channelCount, float endpoint0[4], float endpoint1[4]) {
+	const float* channels[4] = { block.r, block.g, block.b, block.a };
+
+	float aa = 0.0f;
+	float ab = 0.0f;
+	float bb = 0.0f;
+	float ax[4] = {};
+	float bx[4] = {};
+
+	for (int i = 0; i < 16; i++) {
+		if (!include[i]) {
+			continue;
+		}
+
+		float b = indexWeights[indices[i]];
+		float a = 1.0f - b;
+
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+
+		for (int c = 0; c < channelCount; c++) {
+			ax[c] += a * channels[c][i];
+			bx[c] += b * channels[c][i];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if (std::fabs(determinant) < 1e-6f) {
+		return false;
+	}
+
+	for (int c = 0; c < channelCount; c++) {
+		endpoint0[c] = std::min(255.0f, std::max(0.0f, (bb * ax[c] - ab * bx[c]) / determinant));
+		endpoint1[c] = std::min(255.0f, std::max(0.0f, (aa * bx[c] - ab * ax[c]) / determinant));
+	}
+
+	return true;
+}
+
+static void writeLittleEndian(uint8_t* output, uint64_t value, int bytes) {
+	for (int i = 0; i < bytes; i++) {
+		output[i] = static_cast<uint8_t>(value >> (i * 8));
+	}
+}
+
+static uint16_t to565(const float color[4]) {
+	int r = std::min(31, std::max(0, static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f)));
+	int g = std::min(63, std::max(0, static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f)));
+	int b = std::min(31, std::max(0, static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f)));
+
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+//same bit replication the decoder does going back up to 8 bits
+static void from565(uint16_t color, float expanded[4]) {
+	int r = (color >> 11) & 31;
+	int g = (color >> 5) & 63;
+	int b = color & 31;
+
+	expanded[0] = static_cast<float>((r << 3) | (r >> 2));
+	expanded[1] = static_cast<float>((g << 2) | (g >> 4));
+	expanded[2] = static_cast<float>((b << 3) | (b >> 2));
+	expanded[3] = 255.0f;
+}
+
+struct Bc1Block {
+	uint16_t color0;
+	uint16_t color1;
+	uint8_t indices[16];
+	float error;
+};
+
+static Bc1Block evaluateBc1(const Block& block, uint16_t color0, uint16_t color1, const bool opaque[16], bool threeColor) {
+	//the order of the end points is what tells the decoder which mode the block is in
+	if (threeColor ? color0 > color1 : color0 < color1) {
+		std::swap(color0, color1);
+	}
+
+	Bc1Block result;
+	result.color0 = color0;
+	result.color1 = color1;
+
+	bool fourColor = color0 > color1;
+
+	float palette[4][4];
+	from565(color0, palette[0]);
+	from565(color1, palette[1]);
+
+	for (int c = 0; c < 3; c++) {
+		if (fourColor) {
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+		else {
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0f;
+			palette[3][c] = 0.0f;
+		}
+	}
+	palette[2][3] = 255.0f;
+	palette[3][3] = fourColor ? 255.0f : 0.0f;
+
+	//transparent pixels always take index 3, whatever colour they had, and the opaque ones are fitted to the rest of the palette
+	const float weights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+	int paletteSize = fourColor ? 4 : 3;
+
+	for (int i = 0; i < 16; i++) {
+		result.indices[i] = 3;
+	}
+
+	result.error = fitIndices(block, palette, paletteSize, weights, opaque, result.indices);
+
+	return result;
+}
+
+//the colour half of bc3 never has transparency, bc1 gets the 1 bit alpha mode when a pixel needs it
+static void encodeBc1(const Block& source, bool allowTransparent, uint8_t* output) {
+	Block block = source;
+	bool opaque[16];
+	bool threeColor = false;
+
+	for (int i = 0; i < 16; i++) {
+		opaque[i] = !allowTransparent || block.a[i] >= 128.0f;
+		threeColor = threeColor || !opaque[i];
+
+		if (allowTransparent) {
+			block.a[i] = opaque[i] ? 255.0f : 0.0f;
+		}
+	}
+
+	float endpoint0[4];
+	float endpoint1[4];
+	principalEndpoints(block, opaque, 3, endpoint0, endpoint1);
+
+	Bc1Block best = evaluateBc1(block, to565(endpoint0), to565(endpoint1), opaque, threeColor);
+
+	static const float fourColorWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	static const float threeColorWeights[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+
+	if (refitEndpoints(block, best.indices, best.color0 > best.color1 ? fourColorWeights : threeColorWeights, opaque, 3, endpoint0, endpoint1)) {
+		Bc1Block refit = evaluateBc1(block, to565(endpoint0), to565(endpoint1), opaque, threeColor);
+		if (refit.error < best.error) {
+			best = refit;
+		}
+	}
+
+	uint32_t indexBits = 0;
+	for (int i = 0; i < 16; i++) {
+		indexBits |= static_cast<uint32_t>(best.indices[i]) << (i * 2);
+	}
+
+	writeLittleEndian(output, best.color0, 2);
+	writeLittleEndian(output + 2, best.color1, 2);
+	writeLittleEndian(output + 4, indexBits, 4);
+}
+
+static void encodeAlphaBlock(const Block& block, uint8_t* output) {
+	float minAlpha = 255.0f;
+	float maxAlpha = 0.0f;
+
+	for (int i = 0; i < 16; i++) {
+		minAlpha = std::min(minAlpha, block.a[i]);
+		maxAlpha = std::max(maxAlpha, block.a[i]);
+	}
+
+	//alpha0 > alpha1 gives the 8 value mode, equal values only need index 0
+	uint8_t alpha0 = static_cast<uint8_t>(maxAlpha + 0.5f);
+	uint8_t alpha1 = static_cast<uint8_t>(minAlpha + 0.5f);
+
+	float palette[8][4] = {};
+	palette[0][3] = alpha0;
+	palette[1][3] = alpha1;
+
+	for (int i = 2; i < 8; i++) {
+		palette[i][3] = ((8 - i) * alpha0 + (i - 1) * alpha1) / 7.0f;
+	}
+
+	const float weights[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	uint8_t indices[16];
+	fitIndices(block, palette, alpha0 > alpha1 ? 8 : 1, weights, nullptr, indices);
+
+	uint64_t indexBits = 0;
+	for (int i = 0; i < 16; i++) {
+		indexBits |= static_cast<uint64_t>(indices[i]) << (i * 3);
+	}
+
+	output[0] = alpha0;
+	output[1] = alpha1;
+	writeLittleEndian(output + 2, indexBits, 6);
+}
+
+struct Bc7Block {
+	int endpoint0[4];
+	int endpoint1[4];
+	int pBit0;
+	int pBit1;
+	uint8_t indices[16];
+	float error;
+};
+
+//7 bits per channel plus a low bit shared by the whole end point, keep whichever low bit lands closer
+static void quantizeBc7Endpoint(const float endpoint[4], int quantized[4], int& pBit) {
+	float bestError = FLT_MAX;
+
+	for (int p = 0; p < 2; p++) {
+		int candidate[4];
+		float error = 0.0f;
+
+		for (int c = 0; c < 4; c++) {
+			candidate[c] = std::min(127, std::max(0, static_cast<int>((endpoint[c] - p) / 2.0f + 0.5f)));
+			float difference = static_cast<float>((candidate[c] << 1) | p) - endpoint[c];
+			error += difference * difference;
+		}
+
+		if (error < bestError) {
+			bestError = error;
+			pBit = p;
+			std::copy(candidate, candidate + 4, quantized);
+		}
+	}
+}
+
+static Bc7Block evaluateBc7(const Block& block, const float endpoint0[4], const float endpoint1[4]) {
+	Bc7Block result;
+	quantizeBc7Endpoint(endpoint0, result.endpoint0, result.pBit0);
+	quantizeBc7Endpoint(endpoint1, result.endpoint1, result.pBit1);
+
+	float palette[16][4];
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 4; c++) {
+			int a = (result.endpoint0[c] << 1) | result.pBit0;
+			int b = (result.endpoint1[c] << 1) | result.pBit1;
+			palette[i][c] = static_cast<float>(((64 - BC7_WEIGHTS[i]) * a + BC7_WEIGHTS[i] * b + 32) >> 6);
+		}
+	}
+
+	const float weights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	result.error = fitIndices(block, palette, 16, weights, nullptr, result.indices);
+
+	return result;
+}
+
+struct BitWriter {
+	uint8_t* data;
+	int position;
+
+	void write(uint32_t value, int bits) {
+		for (int i = 0; i < bits; i++, position++) {
+			if ((value >> i) & 1) {
+				data[position >> 3] |= static_cast<uint8_t>(1 << (position & 7));
+			}
+		}
+	}
+};
+
+/* only mode 6 is used, one subset with rgba end points and 4 bit indices.
+	it handles smooth colour and alpha well, the partitioned modes would only help blocks with hard edges*/
+static void encodeBc7(const Block& block, uint8_t* output) {
+	bool all[16];
+	std::fill(all, all + 16, true);
+
+	float endpoint0[4];
+	float endpoint1[4];
+	principalEndpoints(block, all, 4, endpoint0, endpoint1);
+
+	Bc7Block best = evaluateBc7(block, endpoint0, endpoint1);
+
+	float indexWeights[16];
+	for (int i = 0; i < 16; i++) {
+		indexWeights[i] = BC7_WEIGHTS[i] / 64.0f;
+	}
+
+	if (refitEndpoints(block, best.indices, indexWeights, all, 4, endpoint0, endpoint1)) {
+		Bc7Block refit = evaluateBc7(block, endpoint0, endpoint1);
+		if (refit.error < best.error) {
+			best = refit;
+		}
+	}
+
+	//the first index is stored without its top bit, so it has to be in the lower half
+	if (best.indices[0] >= 8) {
+		std::swap(best.endpoint0, best.endpoint1);
+		std::swap(best.pBit0, best.pBit1);
+		for (int i = 0; i < 16; i++) {
+			best.indices[i] = static_cast<uint8_t>(15 - best.indices[i]);
+		}
+	}
+
+	memset(output, 0, 16);
+	BitWriter writer = { output, 0 };
+
+	//mode is unary, six zeros then a one
+	writer.write(1 << 6, 7);
+
+	for (int c = 0; c < 4; c++) {
+		writer.write(best.endpoint0[c], 7);
+		writer.write(best.endpoint1[c], 7);
+	}
+
+	writer.write(best.pBit0, 1);
+	writer.write(best.pBit1, 1);
+
+	writer.write(best.indices[0], 3);
+	for (int i = 1; i < 16; i++) {
+		writer.write(best.indices[i], 4);
+	}
+}
+
+MipChain compressMipChain(const MipChain& rgba, BlockFormat format, ThreadPool* pool) {
+	MipChain blocks;
+	blocks.width = rgba.width;
+	blocks.height = rgba.height;
+
+	size_t totalSize = 0;
+	for (const auto& level : rgba.levels) {
+		size_t blocksX = (level.width + 3) / 4;
+		size_t blocksY = (level.height + 3) / 4;
+
+		MipLevel blockLevel = { totalSize, blocksX * blocksY * blockSize(format), level.width, level.height };
+		blocks.levels.push_back(blockLevel);
+		totalSize += blockLevel.size;
+	}
+
+	blocks.data.resize(totalSize);
+
+	for (size_t i = 0; i < rgba.levels.size(); i++) {
+		const MipLevel& level = rgba.levels[i];
+		const unsigned char* pixels = rgba.data.data() + level.offset;
+		unsigned char* destination = blocks.data.data() + blocks.levels[i].offset;
+		uint32_t blocksX = (level.width + 3) / 4;
+		uint32_t blocksY = (level.height + 3) / 4;
+
+		auto encodeRows = [&](size_t begin, size_t end) {
+			Block block;
+
+			for (size_t y = begin; y < end; y++) {
+				for (uint32_t x = 0; x < blocksX; x++) {
+					loadBlock(pixels, level.width, level.height, x, static_cast<uint32_t>(y), block);
+					unsigned char* output = destination + (y * blocksX + x) * blockSize(format);
+
+					switch (format) {
+					case BlockFormat::BC1:
+						encodeBc1(block, true, output);
+						break;
+					case BlockFormat::BC3:
+						encodeAlphaBlock(block, output);
+						encodeBc1(block, false, output + 8);
+						break;
+					case BlockFormat::BC7:
+						encodeBc7(block, output);
+						break;
+					}
+				}
+			}
+		};
+
+		if (pool != nullptr) {
+			//a few hundred blocks per chunk, every block is independent so the rest is just scheduling
+			pool->parallelFor(blocksY, std::max<size_t>(1, 256 / blocksX), encodeRows);
+		}
+		else {
+			encodeRows(0, blocksY);
+		}
+	}
+
+	return blocks;
+}
+
+//only the parts of the dds layout needed for a 2d block compressed texture with mips
+struct DdsPixelFormat {
+	uint32_t size;
+	uint32_t flags;
+	uint32_t fourCC;
+	uint32_t rgbBitCount;
+	uint32_t rBitMask;
+	uint32_t gBitMask;
+	uint32_t bBitMask;
+	uint32_t aBitMask;
+};
+
+struct DdsHeader {
+	uint32_t size;
+	uint32_t flags;
+	uint32_t height;
+	uint32_t width;
+	uint32_t pitchOrLinearSize;
+	uint32_t depth;
+	uint32_t mipMapCount;
+	uint32_t reserved1[11];
+	DdsPixelFormat pixelFormat;
+	uint32_t caps;
+	uint32_t caps2;
+	uint32_t caps3;
+	uint32_t caps4;
+	uint32_t reserved2;
+};
+
+struct DdsHeaderDx10 {
+	uint32_t dxgiFormat;
+	uint32_t resourceDimension;
+	uint32_t miscFlag;
+	uint32_t arraySize;
+	uint32_t miscFlags2;
+};
+
+static_assert(sizeof(DdsHeader) == 124, "dds header has to match the file layout");
+static_assert(sizeof(DdsHeaderDx10) == 20, "dx10 header has to match the file layout");
+
+static constexpr uint32_t makeFourCC(char a, char b, char c, char d) {
+	return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+}
+
+static const uint32_t DDS_MAGIC = makeFourCC('D', 'D', 'S', ' ');
+static const uint32_t FOURCC_DXT1 = makeFourCC('D', 'X', 'T', '1');
+static const uint32_t FOURCC_DXT5 = makeFourCC('D', 'X', 'T', '5');
+static const uint32_t FOURCC_DX10 = makeFourCC('D', 'X', '1', '0');
+
+static const uint32_t DDSD_CAPS = 0x1;
+static const uint32_t DDSD_HEIGHT = 0x2;
+static const uint32_t DDSD_WIDTH = 0x4;
+static const uint32_t DDSD_PIXELFORMAT = 0x1000;
+static const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+static const uint32_t DDSD_LINEARSIZE = 0x80000;
+static const uint32_t DDPF_FOURCC = 0x4;
+static const uint32_t DDSCAPS_COMPLEX = 0x8;
+static const uint32_t DDSCAPS_TEXTURE = 0x1000;
+static const uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+static const uint32_t DXGI_FORMAT_BC1_TYPELESS = 70;
+static const uint32_t DXGI_FORMAT_BC1_UNORM_SRGB = 72;
+static const uint32_t DXGI_FORMAT_BC3_TYPELESS = 76;
+static const uint32_t DXGI_FORMAT_BC3_UNORM_SRGB = 78;
+static const uint32_t DXGI_FORMAT_BC7_TYPELESS = 97;
+static const uint32_t DXGI_FORMAT_BC7_UNORM = 98;
+static const uint32_t DXGI_FORMAT_BC7_UNORM_SRGB = 99;
+static const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+
+void writeDds(const std::string& path, const MipChain& blocks, BlockFormat format) {
+	std::ofstream file(path, std::ios::binary);
+
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open " + path + " for writing!");
+	}
+
+	DdsHeader header = {};
+	header.size = sizeof(DdsHeader);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	header.height = blocks.height;
+	header.width = blocks.width;
+	header.pitchOrLinearSize = static_cast<uint32_t>(blocks.levels[0].size);
+	header.mipMapCount = static_cast<uint32_t>(blocks.levels.size());
+	header.pixelFormat.size = sizeof(DdsPixelFormat);
+	header.pixelFormat.flags = DDPF_FOURCC;
+	header.caps = DDSCAPS_TEXTURE | DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+	//bc1 and bc3 use the old four character codes so older tools can still open them, bc7 needs the dx10 header
+	switch (format) {
+	case BlockFormat::BC1:
+		header.pixelFormat.fourCC = FOURCC_DXT1;
+		break;
+	case BlockFormat::BC3:
+		header.pixelFormat.fourCC = FOURCC_DXT5;
+		break;
+	case BlockFormat::BC7:
+		header.pixelFormat.fourCC = FOURCC_DX10;
+		break;
+	}
+
+	file.write(reinterpret_cast<const char*>(&DDS_MAGIC), sizeof(DDS_MAGIC));
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	if (format == BlockFormat::BC7) {
+		DdsHeaderDx10 dx10 = {};
+		dx10.dxgiFormat = DXGI_FORMAT_BC7_UNORM;
+		dx10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+		dx10.arraySize = 1;
+
+		file.write(reinterpret_cast<const char*>(&dx10), sizeof(dx10));
+	}
+
+	file.write(reinterpret_cast<const char*>(blocks.data.data()), blocks.data.size());
+
+	if (!file) {
+		throw std::runtime_error("failed to write " + path + "!");
+	}
+}
+
+bool readDds(const std::string& path, MipChain& blocks, BlockFormat& format) {
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file.is_open()) {
+		return false;
+	}
+
+	uint32_t magic = 0;
+	DdsHeader header = {};
+	file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	if (!file || magic != DDS_MAGIC || header.size != sizeof(DdsHeader) || !(header.pixelFormat.flags & DDPF_FOURCC)) {
+		throw std::runtime_error(path + " is not a block compressed dds file!");
+	}
+
+	if (header.pixelFormat.fourCC == FOURCC_DXT1) {
+		format = BlockFormat::BC1;
+	}
+	else if (header.pixelFormat.fourCC == FOURCC_DXT5) {
+		format = BlockFormat::BC3;
+	}
+	else if (header.pixelFormat.fourCC == FOURCC_DX10) {
+		DdsHeaderDx10 dx10 = {};
+		file.read(reinterpret_cast<char*>(&dx10), sizeof(dx10));
+
+		if (!file || dx10.resourceDimension != DDS_DIMENSION_TEXTURE2D || dx10.arraySize > 1) {
+			throw std::runtime_error(path + " is not a single 2d texture!");
+		}
+
+		if (dx10.dxgiFormat >= DXGI_FORMAT_BC1_TYPELESS && dx10.dxgiFormat <= DXGI_FORMAT_BC1_UNORM_SRGB) {
+			format = BlockFormat::BC1;
+		}
+		else if (dx10.dxgiFormat >= DXGI_FORMAT_BC3_TYPELESS && dx10.dxgiFormat <= DXGI_FORMAT_BC3_UNORM_SRGB) {
+			format = BlockFormat::BC3;
+		}
+		else if (dx10.dxgiFormat >= DXGI_FORMAT_BC7_TYPELESS && dx10.dxgiFormat <= DXGI_FORMAT_BC7_UNORM_SRGB) {
+			format = BlockFormat::BC7;
+		}
+		else {
+			throw std::runtime_error(path + " uses a block format that is not supported!");
+		}
+	}
+	else {
+		throw std::runtime_error(path + " uses a block format that is not supported!");
+	}
+
+	if (header.width == 0 || header.height == 0) {
+		throw std::runtime_error(path + " has no pixels!");
+	}
+
+	blocks = MipChain();
+	blocks.width = header.width;
+	blocks.height = header.height;
+
+	uint32_t levelCount = std::min(std::max(header.mipMapCount, 1u), mipLevelCount(header.width, header.height));
+	uint32_t levelWidth = header.width;
+	uint32_t levelHeight = header.height;
+	size_t totalSize = 0;
+
+	for (uint32_t i = 0; i < levelCount; i++) {
+		size_t size = static_cast<size_t>((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockSize(format);
+		blocks.levels.push_back({ totalSize, size, levelWidth, levelHeight });
+		totalSize += size;
+
+		levelWidth = std::max(levelWidth / 2, 1u);
+		levelHeight = std::max(levelHeight / 2, 1u);
+	}
+
+	blocks.data.resize(totalSize);
+	file.read(reinterpret_cast<char*>(blocks.data.data()), totalSize);
+
+	if (!file) {
+		throw std::runtime_error(path + " is truncated!");
+	}
+
+	return true;
+}
+
+void compressTextureFile(const std::string& texturePath, BlockFormat format, MipFilter filter, ThreadPool& pool) {
+	int width;
+	int height;
+	int channels;
+	stbi_uc* pixels = stbi_load(texturePath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+
+	if (!pixels) {
+		throw std::runtime_error("failed to load texture image " + texturePath + "!");
+	}
+
+	MipChain rgba = buildMipChain(pixels, width, height, filter, true, &pool);
+	stbi_image_free(pixels);
+
+	writeDds(compressedTexturePath(texturePath, format), compressMipChain(rgba, format, &pool), format);
+}
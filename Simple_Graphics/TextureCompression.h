@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "TextureProcessing.h"
+
+/* block compressed textures. encoding is far too slow to do while starting up so it is done offline
+	with --compress-textures, the renderer only reads back the .dds files that writes*/
+
+enum class BlockFormat {
+	BC1,
+	BC3,
+	BC7
+};
+
+//bytes in one 4x4 block
+uint32_t blockSize(BlockFormat format);
+
+//where the compressed version of a texture lives, textures/earth.png -> textures/earth.bc7.dds
+std::string compressedTexturePath(const std::string& texturePath, BlockFormat format);
+
+/* compresses every level of an rgba8 chain. the levels keep their size in texels,
+	offsets and sizes are in bytes of blocks. block rows are split across the pool if one is given*/
+MipChain compressMipChain(const MipChain& rgba, BlockFormat format, ThreadPool* pool = nullptr);
+
+void writeDds(const std::string& path, const MipChain& blocks, BlockFormat format);
+
+//false if there is no file at path, throws if there is one but it is not a block compressed 2d texture
+bool readDds(const std::string& path, MipChain& blocks, BlockFormat& format);
+
+//the whole offline step for one image, decode, build the mips and write the .dds next to it
+void compressTextureFile(const std::string& texturePath, BlockFormat format, MipFilter filter, ThreadPool& pool);
@@ -0,0 +1,293 @@
+#include "TextureProcessing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+//sse2 is always there on x64, float4 maps nicely onto one rgba pixel
+#include <emmintrin.h>
+
+static const float PI = 3.14159265358979f;
+
+//support of the kaiser filter in destination pixels on each side, and how sharp the window is
+static const float KAISER_RADIUS = 2.0f;
+static const float KAISER_ALPHA = 4.0f;
+
+struct SrgbTables {
+	float toLinear[256];
+	unsigned char fromLinear[65536];
+
+	SrgbTables() {
+		for (int i = 0; i < 256; i++) {
+			float c = i / 255.0f;
+			toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+
+		//16 bits of linear input is enough that every srgb value in the darks can still be reached
+		for (int i = 0; i < 65536; i++) {
+			float l = i / 65535.0f;
+			float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+			fromLinear[i] = static_cast<unsigned char>(std::min(255.0f, c * 255.0f + 0.5f));
+		}
+	}
+};
+
+static const SrgbTables& srgbTables() {
+	static const SrgbTables tables;
+	return tables;
+}
+
+//a level being filtered, 4 floats per pixel
+struct FloatImage {
+	uint32_t width;
+	uint32_t height;
+	std::vector<float> pixels;
+};
+
+//the source pixels and weights that make up one destination pixel along one axis
+struct FilterTaps {
+	int first;
+	std::vector<float> weights;
+};
+
+static void runRows(ThreadPool* pool, uint32_t rows, uint32_t rowWidth, const std::function<void(size_t, size_t)>& body) {
+	//keep chunks big enough that the small levels are not spread over every thread
+	size_t grain = std::max<size_t>(1, 16384 / std::max<uint32_t>(rowWidth, 1));
+
+	if (pool != nullptr) {
+		pool->parallelFor(rows, grain, body);
+	}
+	else {
+		body(0, rows);
+	}
+}
+
+uint32_t mipLevelCount(uint32_t width, uint32_t height) {
+	return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+}
+
+static float besselI0(float x) {
+	//power series, converges quickly for the small arguments the window uses
+	float sum = 1.0f;
+	float term = 1.0f;
+	float halfX = x * 0.5f;
+
+	for (int k = 1; k < 20; k++) {
+		term *= (halfX / k) * (halfX / k);
+		sum += term;
+	}
+
+	return sum;
+}
+
+static float kaiserWeight(float distance) {
+	if (std::fabs(distance) >= KAISER_RADIUS) {
+		return 0.0f;
+	}
+
+	float sinc = distance == 0.0f ? 1.0f : std::sin(PI * distance) / (PI * distance);
+	float ratio = distance / KAISER_RADIUS;
+	float window = besselI0(KAISER_ALPHA * std::sqrt(1.0f - ratio * ratio)) / besselI0(KAISER_ALPHA);
+
+	return sinc * window;
+}
+
+static std::vector<FilterTaps> buildKaiserTaps(uint32_t srcSize, uint32_t dstSize) {
+	std::vector<FilterTaps> taps(dstSize);
+	float scale = static_cast<float>(srcSize) / dstSize;
+
+	for (uint32_t x = 0; x < dstSize; x++) {
+		float center = (x + 0.5f) * scale;
+		int first = static_cast<int>(std::floor(center - KAISER_RADIUS * scale));
+		int last = static_cast<int>(std::ceil(center + KAISER_RADIUS * scale));
+
+		taps[x].first = first;
+		float total = 0.0f;
+
+		for (int i = first; i <= last; i++) {
+			float weight = kaiserWeight(((i + 0.5f) - center) / scale);
+			taps[x].weights.push_back(weight);
+			total += weight;
+		}
+
+		for (auto& weight : taps[x].weights) {
+			weight /= total;
+		}
+	}
+
+	return taps;
+}
+
+//textures are sampled with repeat, so the filter wraps around the edges the same way
+static inline uint32_t wrapIndex(int i, uint32_t size) {
+	int wrapped = i % static_cast<int>(size);
+	return static_cast<uint32_t>(wrapped < 0 ? wrapped + static_cast<int>(size) : wrapped);
+}
+
+static FloatImage toFloatImage(const unsigned char* rgba, uint32_t width, uint32_t height, bool srgb) {
+	const SrgbTables& tables = srgbTables();
+
+	FloatImage image = { width, height, std::vector<float>(static_cast<size_t>(width) * height * 4) };
+	size_t pixelCount = static_cast<size_t>(width) * height;
+
+	for (size_t i = 0; i < pixelCount; i++) {
+		for (int c = 0; c < 3; c++) {
+			image.pixels[i * 4 + c] = srgb ? tables.toLinear[rgba[i * 4 + c]] : rgba[i * 4 + c] / 255.0f;
+		}
+		image.pixels[i * 4 + 3] = rgba[i * 4 + 3] / 255.0f;
+	}
+
+	return image;
+}
+
+static void storeLevel(const FloatImage& image, bool srgb, unsigned char* destination, ThreadPool* pool) {
+	const SrgbTables& tables = srgbTables();
+
+	runRows(pool, image.height, image.width, [&](size_t begin, size_t end) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		//colour goes through the 16 bit table when it is srgb, alpha always goes straight to 8 bits
+		const __m128 scale = srgb ? _mm_set_ps(255.0f, 65535.0f, 65535.0f, 65535.0f) : _mm_set1_ps(255.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+
+		for (size_t y = begin; y < end; y++) {
+			for (uint32_t x = 0; x < image.width; x++) {
+				size_t index = (y * image.width + x) * 4;
+
+				__m128 pixel = _mm_loadu_ps(&image.pixels[index]);
+				pixel = _mm_min_ps(_mm_max_ps(pixel, zero), one);
+				__m128i quantized = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(pixel, scale), half));
+
+				alignas(16) int32_t values[4];
+				_mm_store_si128(reinterpret_cast<__m128i*>(values), quantized);
+
+				for (int c = 0; c < 3; c++) {
+					destination[index + c] = srgb ? tables.fromLinear[values[c]] : static_cast<unsigned char>(values[c]);
+				}
+				destination[index + 3] = static_cast<unsigned char>(values[3]);
+			}
+		}
+	});
+}
+
+static FloatImage downsampleBox(const FloatImage& src, ThreadPool* pool) {
+	FloatImage dst = { std::max(src.width / 2, 1u), std::max(src.height / 2, 1u), {} };
+	dst.pixels.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+
+	runRows(pool, dst.height, dst.width, [&](size_t begin, size_t end) {
+		const __m128 quarter = _mm_set1_ps(0.25f);
+
+		for (size_t y = begin; y < end; y++) {
+			//odd sizes drop the last row/column, the same as the blit path does
+			size_t row0 = std::min<size_t>(y * 2, src.height - 1) * src.width;
+			size_t row1 = std::min<size_t>(y * 2 + 1, src.height - 1) * src.width;
+
+			for (uint32_t x = 0; x < dst.width; x++) {
+				size_t col0 = std::min<size_t>(x * 2, src.width - 1);
+				size_t col1 = std::min<size_t>(x * 2 + 1, src.width - 1);
+
+				__m128 sum = _mm_loadu_ps(&src.pixels[(row0 + col0) * 4]);
+				sum = _mm_add_ps(sum, _mm_loadu_ps(&src.pixels[(row0 + col1) * 4]));
+				sum = _mm_add_ps(sum, _mm_loadu_ps(&src.pixels[(row1 + col0) * 4]));
+				sum = _mm_add_ps(sum, _mm_loadu_ps(&src.pixels[(row1 + col1) * 4]));
+
+				_mm_storeu_ps(&dst.pixels[(y * dst.width + x) * 4], _mm_mul_ps(sum, quarter));
+			}
+		}
+	});
+
+	return dst;
+}
+
+static FloatImage downsampleKaiser(const FloatImage& src, ThreadPool* pool) {
+	FloatImage dst = { std::max(src.width / 2, 1u), std::max(src.height / 2, 1u), {} };
+	dst.pixels.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+
+	std::vector<FilterTaps> horizontalTaps = buildKaiserTaps(src.width, dst.width);
+	std::vector<FilterTaps> verticalTaps = buildKaiserTaps(src.height, dst.height);
+
+	//separable, filter the rows into a dst.width x src.height image and then the columns of that
+	std::vector<float> horizontal(static_cast<size_t>(dst.width) * src.height * 4);
+
+	runRows(pool, src.height, dst.width, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; y++) {
+			const float* srcRow = &src.pixels[y * src.width * 4];
+
+			for (uint32_t x = 0; x < dst.width; x++) {
+				const FilterTaps& taps = horizontalTaps[x];
+				__m128 sum = _mm_setzero_ps();
+
+				for (size_t t = 0; t < taps.weights.size(); t++) {
+					uint32_t column = wrapIndex(taps.first + static_cast<int>(t), src.width);
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&srcRow[column * 4]), _mm_set1_ps(taps.weights[t])));
+				}
+
+				_mm_storeu_ps(&horizontal[(y * dst.width + x) * 4], sum);
+			}
+		}
+	});
+
+	runRows(pool, dst.height, dst.width, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; y++) {
+			const FilterTaps& taps = verticalTaps[y];
+			float* dstRow = &dst.pixels[y * dst.width * 4];
+
+			for (uint32_t x = 0; x < dst.width; x++) {
+				_mm_storeu_ps(&dstRow[x * 4], _mm_setzero_ps());
+			}
+
+			//walk whole rows at a time so the reads stay sequential
+			for (size_t t = 0; t < taps.weights.size(); t++) {
+				uint32_t row = wrapIndex(taps.first + static_cast<int>(t), src.height);
+				const float* srcRow = &horizontal[static_cast<size_t>(row) * dst.width * 4];
+				__m128 weight = _mm_set1_ps(taps.weights[t]);
+
+				for (uint32_t x = 0; x < dst.width; x++) {
+					__m128 sum = _mm_loadu_ps(&dstRow[x * 4]);
+					_mm_storeu_ps(&dstRow[x * 4], _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&srcRow[x * 4]), weight)));
+				}
+			}
+		}
+	});
+
+	return dst;
+}
+
+MipChain buildMipChain(const unsigned char* rgba, uint32_t width, uint32_t height, MipFilter filter, bool srgb, ThreadPool* pool) {
+	if (rgba == nullptr || width == 0 || height == 0) {
+		throw std::invalid_argument("cannot build mip chain for an empty image!");
+	}
+
+	MipChain chain;
+	chain.width = width;
+	chain.height = height;
+
+	uint32_t levelCount = mipLevelCount(width, height);
+	size_t totalSize = 0;
+	uint32_t levelWidth = width;
+	uint32_t levelHeight = height;
+
+	for (uint32_t i = 0; i < levelCount; i++) {
+		MipLevel level = { totalSize, static_cast<size_t>(levelWidth) * levelHeight * 4, levelWidth, levelHeight };
+		chain.levels.push_back(level);
+		totalSize += level.size;
+
+		levelWidth = std::max(levelWidth / 2, 1u);
+		levelHeight = std::max(levelHeight / 2, 1u);
+	}
+
+	chain.data.resize(totalSize);
+
+	//the top level is copied as is so it does not lose anything going through float and back
+	memcpy(chain.data.data(), rgba, chain.levels[0].size);
+
+	FloatImage current = toFloatImage(rgba, width, height, srgb);
+
+	for (uint32_t i = 1; i < levelCount; i++) {
+		current = filter == MipFilter::Kaiser ? downsampleKaiser(current, pool) : downsampleBox(current, pool);
+		storeLevel(current, srgb, chain.data.data() + chain.levels[i].offset, pool);
+	}
+
+	return chain;
+}
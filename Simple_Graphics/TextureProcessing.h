@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ThreadPool.h"
+
+/* cpu side texture work that does not need a device, so it can run on the worker threads
+	while the main thread is busy with vulkan*/
+
+enum class MipFilter {
+	Box,
+	Kaiser
+};
+
+struct MipLevel {
+	size_t offset;
+	size_t size;
+	uint32_t width;
+	uint32_t height;
+};
+
+//every level of an image packed one after another, ready to go into a single staging buffer
+struct MipChain {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<MipLevel> levels;
+	std::vector<unsigned char> data;
+};
+
+//basically log2(tex_dimensions)
+uint32_t mipLevelCount(uint32_t width, uint32_t height);
+
+/* builds the full chain from an rgba8 image down to 1x1.
+	when srgb is set the colour channels are converted to linear before filtering and back afterwards,
+	alpha is always filtered as is. rows of each level are split across the pool if one is given*/
+MipChain buildMipChain(const unsigned char* rgba, uint32_t width, uint32_t height, MipFilter filter, bool srgb, ThreadPool* pool = nullptr);
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <queue>
+#include <vector>
+#include <algorithm>
+
+/* small fixed size pool of worker threads, used for the cpu side of asset loading
+	so that file parsing and image decoding can run while the main thread talks to vulkan*/
+class ThreadPool {
+public:
+	//0 means use one worker per hardware thread, leaving one for the main thread
+	explicit ThreadPool(size_t threadCount = 0) {
+		if (threadCount == 0) {
+			unsigned int hardwareThreads = std::thread::hardware_concurrency();
+			threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		for (size_t i = 0; i < threadCount; i++) {
+			workers.emplace_back([this] { workerLoop(); });
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+		}
+		condition.notify_all();
+
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	template<class F>
+	auto submit(F&& task) -> std::future<decltype(task())> {
+		using ResultType = decltype(task());
+
+		//packaged_task is move only, std::function needs something copyable
+		auto packagedTask = std::make_shared<std::packaged_task<ResultType()>>(std::forward<F>(task));
+		std::future<ResultType> result = packagedTask->get_future();
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			tasks.emplace([packagedTask] { (*packagedTask)(); });
+		}
+		condition.notify_one();
+
+		return result;
+	}
+
+	/* splits [0, count) into chunks of grain and runs body(begin, end) on them across the pool.
+		the calling thread works on chunks too and only waits for chunks already being processed,
+		so this is safe to call from inside a task running on the pool*/
+	void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+		if (count == 0) {
+			return;
+		}
+
+		if (grain == 0) {
+			grain = 1;
+		}
+
+		size_t chunkCount = (count + grain - 1) / grain;
+		if (chunkCount == 1 || workers.empty()) {
+			body(0, count);
+			return;
+		}
+
+		struct ParallelForState {
+			std::atomic<size_t> nextChunk{ 0 };
+			std::atomic<size_t> finishedChunks{ 0 };
+			std::mutex mutex;
+			std::condition_variable finished;
+			std::exception_ptr error;
+		};
+
+		auto state = std::make_shared<ParallelForState>();
+
+		//helpers that start after every chunk is claimed return straight away and never touch body
+		auto runChunks = [state, count, grain, chunkCount, &body]() {
+			while (true) {
+				size_t chunk = state->nextChunk.fetch_add(1);
+				if (chunk >= chunkCount) {
+					return;
+				}
+
+				size_t begin = chunk * grain;
+				size_t end = std::min(count, begin + grain);
+
+				try {
+					body(begin, end);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(state->mutex);
+					if (!state->error) {
+						state->error = std::current_exception();
+					}
+				}
+
+				if (state->finishedChunks.fetch_add(1) + 1 == chunkCount) {
+					std::lock_guard<std::mutex> lock(state->mutex);
+					state->finished.notify_all();
+				}
+			}
+		};
+
+		size_t helperCount = std::min(workers.size(), chunkCount - 1);
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			for (size_t i = 0; i < helperCount; i++) {
+				tasks.emplace(runChunks);
+			}
+		}
+		condition.notify_all();
+
+		runChunks();
+
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->finished.wait(lock, [&state, chunkCount] { return state->finishedChunks.load() == chunkCount; });
+
+		if (state->error) {
+			std::rethrow_exception(state->error);
+		}
+	}
+
+	size_t size() const {
+		return workers.size();
+	}
+
+private:
+	void workerLoop() {
+		while (true) {
+			std::function<void()> task;
+
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+
+				if (stopping && tasks.empty()) {
+					return;
+				}
+
+				task = std::move(tasks.front());
+				tasks.pop();
+			}
+
+			task();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> tasks;
+	std::mutex queueMutex;
+	std::condition_variable condition;
+	bool stopping = false;
+};
@@ -3,6 +3,18 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include <filesystem>
+#include <sstream>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
@@ -32,8 +44,39 @@ static void framebufferResizeCallback(GLFWwindow* window, int width, int height)
 	app->framebufferResized = true;
 }
 
+static void mouseButtonCallback(GLFWwindow* window, int button, int action, int /*mods*/) {
+	if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS) {
+		return;
+	}
+
+	double cursorX, cursorY;
+	glfwGetCursorPos(window, &cursorX, &cursorY);
+
+	auto app = reinterpret_cast<VulkanRenderer*>(glfwGetWindowUserPointer(window));
+	app->pickAt(cursorX, cursorY);
+}
+
 void VulkanRenderer::run() {
-	initWindow();
+	startupStart = std::chrono::high_resolution_clock::now();
+	lastStartupMark = startupStart;
+
+	//stdout carries the frames, everything that would have been printed there goes to stderr
+	if (streamPath == "-") {
+		std::cout.rdbuf(std::cerr.rdbuf());
+	}
+
+	if (software) {
+		runSoftware();
+		return;
+	}
+
+	//none of the parsing needs a device, so get it going before anything else
+	startAssetDecoding();
+
+	if (!headless) {
+		initWindow();
+		markStartupPhase("window");
+	}
 	initVulkan();
 	mainLoop();
 	cleanup();
@@ -42,34 +85,249 @@ void VulkanRenderer::run() {
 void VulkanRenderer::initVulkan() {
 	createInstance();
 	setupDebugMessenger();
-	createSurface();
+	if (!headless) {
+		createSurface();
+	}
+	markStartupPhase("instance + surface");
 	pickPhysicalDevice();
+	checkMultiview();
 	createLogicalDevice();
-	createSwapChain();
+	markStartupPhase("device");
+	if (headless) {
+		createHeadlessImages();
+	}
+	else {
+		createSwapChain();
+	}
 	createImageViews();
 	createRenderPass();
+	markStartupPhase("swap chain + render pass");
 	createDescriptorSetLayout();
 	createGraphicsPipeline();
+	markStartupPhase("graphics pipeline");
 	createColorResources();
 	createDepthResources();
 	createFramebuffers();
 	createCommandPool();
+	createStagingRing(stagingRing, STAGING_RING_SIZE);
+	createPlaceholderTexture();
+	createMipGenPipeline();
+
+	streamingStaging.resize(MAX_FRAMES_IN_FLIGHT);
+	for (auto& staging : streamingStaging) {
+		createStagingRing(staging, STREAMING_BYTES_PER_FRAME);
+	}
 	createTextureSampler();
+	markStartupPhase("attachments + command pool");
 	loadModels();
+	markStartupPhase("asset upload (includes waiting on decode)");
+	createViewBuffers();
 	createDescriptorPool();
 	createDescriptorSets();
 	allocateCommandBuffers();
+	updateStatisticsQueryPool();
+	createMeshletCulling();
+	createFrameReadback();
 	createSyncObjects();
+	markStartupPhase("descriptors + sync objects");
 }
 
 void VulkanRenderer::mainLoop() {
-	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents();
+	auto loopStart = std::chrono::high_resolution_clock::now();
+
+	//a headless --bench-scene keeps going until the whole scene has been drawn however many frames that takes
+	while (headless ? frameNumber < headlessFrames || benchmarkScene : !glfwWindowShouldClose(window)) {
+		if (!headless) {
+			glfwPollEvents();
+		}
 		drawFrame();
+
+		if (!firstFrameReported) {
+			//the present has been queued, close enough to the frame being on screen
+			markStartupPhase("first frame");
+			printStartupReport();
+			firstFrameReported = true;
+		}
+
+		//the frame just queued is the first with every object in it
+		if (benchmarkScene && sceneInstantiated) {
+			double total = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startupStart).count();
+			std::cout << "bench-scene: file " << sceneFileMilliseconds << " ms, whole scene on screen " << total << " ms after startup, "
+				<< frameNumber << " frames" << std::endl;
+
+			break;
+		}
 	}
 
 	//wait until the GPU is doing nothing before moving on
 	vkDeviceWaitIdle(device);
+	finishFrameReadback();
+
+	//the same figure runSoftware prints, so lavapipe and the cpu rasterizer can be put side by side
+	if (headless && frameNumber > 0) {
+		double total = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - loopStart).count();
+		std::cout << "headless: " << frameNumber << " frames, " << total / frameNumber << " ms a frame" << std::endl;
+	}
+}
+
+/* the whole run on the cpu. models and textures own vulkan objects, so the rasterizer is given the same parsed meshes,
+	mip chains and transforms they are made from instead. every scene object is drawn whole at full detail*/
+void VulkanRenderer::runSoftware() {
+	if (viewCount > 1) {
+		throw std::runtime_error("multiview needs vulkan, it cannot be used with the software rasterizer!");
+	}
+	if (!captureDirectory.empty() && !streamPath.empty()) {
+		throw std::runtime_error("frames can be captured to files or streamed, not both!");
+	}
+
+	//nothing that only helps a gpu
+	MeshImportOptions options;
+	options.quantize = false;
+	options.split = false;
+	options.generateLods = false;
+	options.buildMeshlets = false;
+	options.buildBvh = false;
+
+	//each file is parsed once however many objects use it
+	std::map<std::string, std::future<MeshData>> pendingSoftwareMeshes;
+	std::map<std::string, std::future<MipChain>> pendingSoftwareTextures;
+
+	for (const SceneObject& object : sceneObjects) {
+		if (pendingSoftwareMeshes.count(object.modelPath) == 0) {
+			std::string modelPath = object.modelPath;
+			pendingSoftwareMeshes[modelPath] = workerPool.submit([modelPath, options] {
+				return parseModel(modelPath, options);
+			});
+		}
+
+		if (pendingSoftwareTextures.count(object.texturePath) == 0) {
+			std::string texturePath = object.texturePath;
+			pendingSoftwareTextures[texturePath] = workerPool.submit([this, texturePath] {
+				ImageData imageData = decodeTexture(texturePath);
+				MipChain mipChain = buildMipChain(imageData.pixels, imageData.width, imageData.height, cpuMipFilter, true, &workerPool);
+				stbi_image_free(imageData.pixels);
+
+				return mipChain;
+			});
+		}
+	}
+
+	std::map<std::string, MeshData> meshes;
+	std::map<std::string, MipChain> textures;
+	for (auto& pendingMesh : pendingSoftwareMeshes) {
+		meshes[pendingMesh.first] = pendingMesh.second.get();
+	}
+	for (auto& pendingTexture : pendingSoftwareTextures) {
+		textures[pendingTexture.first] = pendingTexture.second.get();
+	}
+
+	std::vector<RasterDraw> draws;
+	std::vector<size_t> drawObjects;
+	size_t triangleCount = 0;
+	for (size_t i = 0; i < sceneObjects.size(); i++) {
+		const SceneObject& object = sceneObjects[i];
+		const MeshData& mesh = meshes[object.modelPath];
+
+		//meshes that failed or were skipped have nothing to point at
+		if (mesh.verticies.empty()) {
+			continue;
+		}
+
+		RasterDraw draw = {};
+		draw.positions = &mesh.verticies[0].pos.x;
+		draw.texCoords = &mesh.verticies[0].texCoord.x;
+		draw.stride = sizeof(Vertex) / sizeof(float);
+		draw.vertexCount = mesh.verticies.size();
+		draw.indices = mesh.indicies.data();
+		draw.indexCount = mesh.indicies.size();
+		draw.texture = &textures[object.texturePath];
+
+		draws.push_back(draw);
+		drawObjects.push_back(i);
+		triangleCount += draw.indexCount / 3;
+	}
+
+	markStartupPhase("software asset load");
+
+	SoftwareRasterizer rasterizer(WIDTH, HEIGHT);
+	std::cout << "software: " << draws.size() << " draws, " << triangleCount << " triangles, " << workerPool.size() + 1 << " threads, "
+		<< (SoftwareRasterizer::usesAvx2() ? "avx2" : "scalar") << std::endl;
+
+	swapChainExtent = { static_cast<uint32_t>(WIDTH), static_cast<uint32_t>(HEIGHT) };
+	if (!captureDirectory.empty()) {
+		std::filesystem::create_directories(captureDirectory);
+	}
+	else if (!streamPath.empty()) {
+		openFrameStream(false);
+	}
+
+	std::vector<glm::mat4> worlds(sceneObjects.size());
+	auto loopStart = std::chrono::high_resolution_clock::now();
+
+	for (frameNumber = 1; frameNumber <= headlessFrames; frameNumber++) {
+		//the camera and animation a headless vulkan run would have for this frame, see updateModels
+		Camera view = camera;
+		float time = (frameNumber - 1) / HEADLESS_FRAMES_PER_SECOND;
+		if (!cameraPoses.empty()) {
+			view = cameraPoses[std::min(static_cast<size_t>(frameNumber - 1), cameraPoses.size() - 1)];
+			time = 0.0f;
+		}
+
+		glm::mat4 viewMatrix = glm::lookAt(view.eye, view.target, view.up);
+		glm::mat4 proj = glm::perspective(glm::radians(view.fieldOfView), WIDTH / (float)HEIGHT, 0.1f, 10.0f);
+		proj[1][1] *= -1;
+
+		//parents come before their children, so one pass in order puts every object in the world
+		for (size_t i = 0; i < sceneObjects.size(); i++) {
+			const SceneObject& object = sceneObjects[i];
+			glm::mat4 parentWorld = object.parent != SCENE_NO_PARENT ? worlds[object.parent] : glm::mat4(1.0f);
+			worlds[i] = parentWorld * transformMatrix(object.transform, object.isStatic, time);
+		}
+
+		for (size_t i = 0; i < draws.size(); i++) {
+			draws[i].mvp = proj * viewMatrix * worlds[drawObjects[i]];
+		}
+
+		rasterizer.render(draws, workerPool);
+
+		const unsigned char* pixels = reinterpret_cast<const unsigned char*>(rasterizer.colorBuffer().data());
+		size_t size = rasterizer.colorBuffer().size() * sizeof(uint32_t);
+
+		if (streamFile != nullptr) {
+			if (fwrite(pixels, 1, size, streamFile) != size) {
+				throw std::runtime_error("failed to write a frame to the stream, has the encoder stopped?");
+			}
+		}
+		else if (!captureDirectory.empty()) {
+			char name[32];
+			snprintf(name, sizeof(name), "frame_%06llu.%s", static_cast<unsigned long long>(frameNumber), captureRaw ? "rgba" : "png");
+			std::string path = (std::filesystem::path(captureDirectory) / name).string();
+
+			if (captureRaw) {
+				std::ofstream file(path, std::ios::binary);
+				if (!file.is_open()) {
+					throw std::runtime_error("failed to create " + path + "!");
+				}
+				file.write(reinterpret_cast<const char*>(pixels), size);
+			}
+			else if (!stbi_write_png(path.c_str(), WIDTH, HEIGHT, 4, pixels, WIDTH * 4)) {
+				throw std::runtime_error("failed to write " + path + "!");
+			}
+		}
+
+		if (!firstFrameReported) {
+			markStartupPhase("first frame");
+			printStartupReport();
+			firstFrameReported = true;
+		}
+	}
+
+	double total = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - loopStart).count();
+	std::cout << "software: " << headlessFrames << " frames, " << total / std::max<uint64_t>(headlessFrames, 1) << " ms a frame" << std::endl;
+
+	if (streamFile != nullptr && streamFile != stdout) {
+		fclose(streamFile);
+	}
 }
 
 void VulkanRenderer::cleanup() {
@@ -83,16 +341,55 @@ void VulkanRenderer::cleanup() {
 
 	vkDestroySampler(device, textureSampler, nullptr);
 		
-	for (int i = 0; i < TEXTURES_USED; i++) {
-		freeTexture(i);
+	//reloads still decoding have to finish before the textures they were for go
+	for (auto& pendingReload : pendingReloads) {
+		stbi_image_free(pendingReload.second.get().pixels);
+	}
+	pendingReloads.clear();
+
+	//models hold the only references to the meshes and textures, so these go with them
+	while (models.size() > 0) {
+		removeModel({ models.slots.back(), models.slotGenerations[models.slots.back()] });
 	}
 
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+	destroyMipGenPipeline();
+	if (statisticsQueryPool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(device, statisticsQueryPool, nullptr);
+	}
+	destroyMeshletCulling();
+	destroyFrameReadback();
+	streamWriter.reset();
+	if (streamFile != nullptr && streamFile != stdout) {
+		fclose(streamFile);
+	}
+	for (size_t i = 0; i < uniformBuffers.size(); i++) {
+		vkUnmapMemory(device, uniformBuffersMemory[i]);
+		vkDestroyBuffer(device, uniformBuffers[i], nullptr);
+		vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+	}
 	vkDestroyCommandPool(device, commandPool, nullptr);
 
-	for (const auto model : modelsArray) {
-		freeModel(model);
+	destroyStagingRing(stagingRing);
+	for (auto& staging : streamingStaging) {
+		destroyStagingRing(staging);
+	}
+
+	textureStreams.clear();
+	descriptorSetViews.clear();
+	destroyRetiredImages();
+
+	vkDestroyImage(device, placeholderTexture->image, nullptr);
+	vkFreeMemory(device, placeholderTexture->imageMemory, nullptr);
+	vkDestroyImageView(device, placeholderTexture->imageView, nullptr);
+	delete placeholderTexture;
+
+	//anything that was decoded but never asked for still owns its pixels
+	for (auto& pendingImage : pendingImages) {
+		stbi_image_free(pendingImage.second.get().pixels);
 	}
+	pendingImages.clear();
+	pendingMeshes.clear();
 
 	vkDestroyDevice(device, nullptr);
 
@@ -100,12 +397,16 @@ void VulkanRenderer::cleanup() {
 		DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
 	}
 
-	vkDestroySurfaceKHR(instance, surface, nullptr);
+	if (!headless) {
+		vkDestroySurfaceKHR(instance, surface, nullptr);
+	}
 	vkDestroyInstance(instance, nullptr);
 
-	glfwDestroyWindow(window);
+	if (!headless) {
+		glfwDestroyWindow(window);
 
-	glfwTerminate();
+		glfwTerminate();
+	}
 }
 
 void VulkanRenderer::initWindow() {
@@ -117,6 +418,7 @@ void VulkanRenderer::initWindow() {
 	window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
 	glfwSetWindowUserPointer(window, this);
 	glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+	glfwSetMouseButtonCallback(window, mouseButtonCallback);
 }
 
 void VulkanRenderer::createInstance() {
@@ -204,19 +506,46 @@ bool VulkanRenderer::checkValidationLayerSupport() {
 }
 
 std::vector<const char*> VulkanRenderer::getRequiredExtensions() {
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-	//arguments uisng a pointer as an iterator(ie vector.begin() vector.end())
-	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	std::vector<const char*> extensions;
+
+	//headless runs need no surface, so none of the window system extensions either
+	if (!headless) {
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		//arguments uisng a pointer as an iterator(ie vector.begin() vector.end())
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 	if (enableValidationLayers) {
 		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 	}
 
+	//the instance is 1.0, the memory budget can only be asked for through this
+	if (isInstanceExtensionAvailable(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+		extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		getPhysicalDeviceProperties2Enabled = true;
+	}
+
 	return extensions;
 }
 
+bool VulkanRenderer::isInstanceExtensionAvailable(const char* name) {
+	uint32_t extensionCount = 0;
+	vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, availableExtensions.data());
+
+	for (const auto& extension : availableExtensions) {
+		if (strcmp(extension.extensionName, name) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 	VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -324,8 +653,8 @@ bool VulkanRenderer::isDeviceSuitable(VkPhysicalDevice device) {
 	
 	bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-	bool swapChainAdequate = false;
-	if (extensionsSupported) {
+	bool swapChainAdequate = headless;
+	if (extensionsSupported && !headless) {
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 		swapChainAdequate = !swapChainSupport.formats.empty() &&
 							!swapChainSupport.presentModes.empty();
@@ -356,14 +685,21 @@ VulkanRenderer::findQueueFamilies(VkPhysicalDevice device) {
 
 	int i = 0;
 	for (const auto& queueFamily : queueFamilies) {
+		//nothing is presented headless, the present queue is just the graphics one
 		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+		if (!headless) {
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+		}
 		if (presentSupport) {
 			indices.presentFamily = i;
 		}
 
 		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
 			indices.graphicsFamily = i;
+
+			if (headless) {
+				indices.presentFamily = i;
+			}
 		}
 
 		if (indices.isComplete()) {
@@ -394,9 +730,23 @@ void VulkanRenderer::createLogicalDevice() {
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+	//optional, textures fall back to their uncompressed versions without it
+	textureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+	/* only used to report vertex shader invocations. a query in a multiview subpass takes one slot per view,
+		so the per model queries would run into each other and are left out there*/
+	pipelineStatisticsSupported = supportedFeatures.pipelineStatisticsQuery == VK_TRUE && viewCount <= 1;
+	//meshlet culling draws every meshlet of a model with one indirect call
+	multiDrawIndirectSupported = supportedFeatures.multiDrawIndirect == VK_TRUE;
+
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
 	deviceFeatures.sampleRateShading = VK_TRUE;
+	deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+	deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
@@ -405,9 +755,27 @@ void VulkanRenderer::createLogicalDevice() {
 
 	createInfo.pEnabledFeatures = &deviceFeatures;
 
+	//optional too, without it the texture budget is a fixed share of the heap
+	std::vector<const char*> enabledExtensions;
+	if (!headless) {
+		enabledExtensions = deviceExtensions;
+	}
+	memoryBudgetSupported = getPhysicalDeviceProperties2Enabled && isDeviceExtensionAvailable(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (memoryBudgetSupported) {
+		enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+
+	//checkMultiview has made sure the device can
+	VkPhysicalDeviceMultiviewFeaturesKHR multiviewFeatures = {};
+	multiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR;
+	multiviewFeatures.multiview = VK_TRUE;
+	if (viewCount > 1) {
+		enabledExtensions.push_back(VK_KHR_MULTIVIEW_EXTENSION_NAME);
+		createInfo.pNext = &multiviewFeatures;
+	}
 
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 	//this is for legacy implementations of vulkan
 	if (enableValidationLayers) {
@@ -426,6 +794,23 @@ void VulkanRenderer::createLogicalDevice() {
 
 	vkGetDeviceQueue(device, indicies.graphicsFamily.value(), 0, &graphicsQueue);
 	vkGetDeviceQueue(device, indicies.presentFamily.value(), 0, &presentQueue);
+
+	if (memoryBudgetSupported) {
+		getPhysicalDeviceMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+		memoryBudgetSupported = getPhysicalDeviceMemoryProperties2 != nullptr;
+	}
+
+	//textures go in the biggest device local heap
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+	VkDeviceSize largestHeap = 0;
+	for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+		if ((memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && memProperties.memoryHeaps[i].size > largestHeap) {
+			largestHeap = memProperties.memoryHeaps[i].size;
+			textureHeapIndex = i;
+		}
+	}
 }
 
 void VulkanRenderer::createSurface() {
@@ -442,7 +827,10 @@ bool VulkanRenderer::checkDeviceExtensionSupport(VkPhysicalDevice device) {
 	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-	std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+	std::set<std::string> requiredExtensions;
+	if (!headless) {
+		requiredExtensions.insert(deviceExtensions.begin(), deviceExtensions.end());
+	}
 
 	for (const auto& extension : availableExtensions) {
 		requiredExtensions.erase(extension.extensionName);
@@ -451,6 +839,22 @@ bool VulkanRenderer::checkDeviceExtensionSupport(VkPhysicalDevice device) {
 	return requiredExtensions.empty();
 } 
 
+bool VulkanRenderer::isDeviceExtensionAvailable(VkPhysicalDevice device, const char* name) {
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const auto& extension : availableExtensions) {
+		if (strcmp(extension.extensionName, name) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 
 VulkanRenderer::SwapChainSupportDetails 
 VulkanRenderer::querySwapChainSupport(VkPhysicalDevice device) {
@@ -531,6 +935,14 @@ void VulkanRenderer::createSwapChain() {
 	createInfo.imageArrayLayers = 1;
 	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+	//frames are copied straight out of the swap chain images when they are captured
+	if (!captureDirectory.empty() || !streamPath.empty()) {
+		if (!(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+			throw std::runtime_error("swap chain images cannot be copied from, frames cannot be captured!");
+		}
+		createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+
 	QueueFamilyIndices indicies = findQueueFamilies(physicalDevice);
 	uint32_t queueFamilyIndices[] = { indicies.graphicsFamily.value(), 
 										indicies.presentFamily.value() };
@@ -569,18 +981,34 @@ void VulkanRenderer::createSwapChain() {
 } 
 
 
+/* stands in for the swapchain when headless, the frames are drawn into these in turn.
+	they can be copied out of after the render pass, which leaves them ready to be read*/
+void VulkanRenderer::createHeadlessImages() {
+	swapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	swapChainExtent = { static_cast<uint32_t>(WIDTH), static_cast<uint32_t>(HEIGHT) };
+
+	swapChainImages.resize(HEADLESS_IMAGE_COUNT);
+	headlessImagesMemory.resize(HEADLESS_IMAGE_COUNT);
+
+	for (uint32_t i = 0; i < HEADLESS_IMAGE_COUNT; i++) {
+		createImage(swapChainExtent.width, swapChainExtent.height, 1, VK_SAMPLE_COUNT_1_BIT, swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			swapChainImages[i], headlessImagesMemory[i], viewCount);
+	}
+}
+
 void VulkanRenderer::createImageViews() {
 	swapChainImageViews.resize(swapChainImages.size());
 
 	for (size_t i = 0; i < swapChainImages.size(); i++) {
-		swapChainImageViews[i] = createImageView(swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+		swapChainImageViews[i] = createImageView(swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1, 0, viewCount);
 	}
 } 
 
 
 void VulkanRenderer::createGraphicsPipeline() {
 
-	auto vertShaderCode = readFile("shaders/vert.spv");
+	auto vertShaderCode = readFile(viewCount > 1 ? "shaders/multiview.spv" : "shaders/vert.spv");
 	auto fragShaderCode = readFile("shaders/frag.spv");
 
 	VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
@@ -601,16 +1029,22 @@ void VulkanRenderer::createGraphicsPipeline() {
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
 	
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	//the same shaders read every vertex layout, only the formats they are fetched with change
+	std::array<VkVertexInputBindingDescription, VERTEX_LAYOUT_COUNT> bindingDescriptions = {
+		Vertex::getBindingDescription(),
+		PackedVertex::getBindingDescription(),
+		PackedVertex::getBindingDescription()
+	};
 
-	auto bindingDescription = Vertex::getBindingDescription();
-	auto attributeDescriptions = Vertex::getAttributeDescriptions();
+	std::array<std::array<VkVertexInputAttributeDescription, 2>, VERTEX_LAYOUT_COUNT> attributeDescriptions = {
+		Vertex::getAttributeDescriptions(),
+		PackedVertex::getAttributeDescriptions(VK_FORMAT_R16G16_UNORM),
+		PackedVertex::getAttributeDescriptions(VK_FORMAT_R16G16_SFLOAT)
+	};
 
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
 	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -734,8 +1168,14 @@ void VulkanRenderer::createGraphicsPipeline() {
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.pDepthStencilState = &depthStencil;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create graphics pipeline!");
+	for (uint32_t layout = 0; layout < VERTEX_LAYOUT_COUNT; layout++) {
+		vertexInputInfo.pVertexBindingDescriptions = &bindingDescriptions[layout];
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions[layout].size());
+		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions[layout].data();
+
+		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipelines[layout]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create graphics pipeline!");
+		}
 	}
 
 	vkDestroyShaderModule(device, fragShaderModule, nullptr);
@@ -786,7 +1226,7 @@ void VulkanRenderer::createRenderPass() {
 	colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colorAttachmentResolve.finalLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 	VkAttachmentReference colorAttachmentRef = {};
 	colorAttachmentRef.attachment = 0;
@@ -825,6 +1265,20 @@ void VulkanRenderer::createRenderPass() {
 	renderPassInfo.dependencyCount = 1;
 	renderPassInfo.pDependencies = &dependency;
 
+	//every draw goes to each layer of the attachments, gl_ViewIndex says which
+	uint32_t viewMask = (1u << viewCount) - 1;
+	VkRenderPassMultiviewCreateInfoKHR multiviewInfo = {};
+	multiviewInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO_KHR;
+	multiviewInfo.subpassCount = 1;
+	multiviewInfo.pViewMasks = &viewMask;
+	//the views are close together, so the driver may as well draw them at once
+	multiviewInfo.correlationMaskCount = 1;
+	multiviewInfo.pCorrelationMasks = &viewMask;
+
+	if (viewCount > 1) {
+		renderPassInfo.pNext = &multiviewInfo;
+	}
+
 	if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create render pass!");
 	}
@@ -875,6 +1329,17 @@ void VulkanRenderer::buildMainCommandBuffer(int imageIndex) {
 		throw std::runtime_error("failed to begin recording command buffer!");
 	}
 
+	//copies have to be outside the render pass, and the set has to be up to date before it is bound
+	recordTextureStreaming(commandBuffers[imageIndex]);
+	updateTextureDescriptors(imageIndex);
+	recordMeshletCulling(imageIndex);
+
+	uint32_t firstQuery = imageIndex * statisticsSlotCount;
+	if (statisticsQueryPool != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(commandBuffers[imageIndex], statisticsQueryPool, firstQuery, statisticsSlotCount);
+		statisticsQueried[imageIndex].clear();
+	}
+
 	VkRenderPassBeginInfo renderPassInfo = {};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassInfo.renderPass = renderPass;
@@ -890,22 +1355,52 @@ void VulkanRenderer::buildMainCommandBuffer(int imageIndex) {
 
 
 	vkCmdBeginRenderPass(commandBuffers[imageIndex], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-	for (const auto model : modelsArray) {
-		vkCmdBindPipeline(commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-		vkCmdPushConstants(commandBuffers[imageIndex], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constantBufferMVP), (void*)&model->mvp);
-		vkCmdPushConstants(commandBuffers[imageIndex], pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(constantBufferMVP), sizeof(uint32_t), (void*)&model->texture_index);
+	for (uint32_t m : visibleModels) {
+		const Mesh* mesh = models.meshes[m];
+		uint32_t slot = models.slots[m];
+		bool queried = statisticsQueryPool != VK_NULL_HANDLE && slot < statisticsSlotCount;
+
+		//an evicted texture draws as the placeholder until its reload has been uploaded
+		Texture* texture = textureArray[models.textureIndices[m]];
+		texture->lastUsedFrame = frameNumber;
+		if (!texture->resident) {
+			requestTextureReload(texture);
+		}
+
+		vkCmdBindPipeline(commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelines[static_cast<uint32_t>(mesh->layout)]);
+		vkCmdPushConstants(commandBuffers[imageIndex], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constantBufferMVP), (void*)&models.mvps[m]);
+		vkCmdPushConstants(commandBuffers[imageIndex], pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(constantBufferMVP), sizeof(uint32_t), (void*)&models.textureIndices[m]);
 		vkCmdBindDescriptorSets(commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[imageIndex], 0, nullptr);
 
-		VkBuffer vertexBuffers[] = { model->vertexBuffer };
+		VkBuffer vertexBuffers[] = { mesh->vertexBuffer };
 		VkDeviceSize offsets[] = { 0 };
 		
 		vkCmdBindVertexBuffers(commandBuffers[imageIndex], 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(commandBuffers[imageIndex], model->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdDrawIndexed(commandBuffers[imageIndex], static_cast<uint32_t>(model->indiciesCount), 1, 0, 0, 0);
+		vkCmdBindIndexBuffer(commandBuffers[imageIndex], mesh->indexBuffer, 0, mesh->indexType);
+		if (queried) {
+			vkCmdBeginQuery(commandBuffers[imageIndex], statisticsQueryPool, firstQuery + slot, 0);
+		}
+
+		if (usesMeshletCulling(m)) {
+			vkCmdDrawIndexedIndirect(commandBuffers[imageIndex], drawCommandBuffers[imageIndex], models.drawCommandOffsets[m] * sizeof(VkDrawIndexedIndirectCommand),
+				static_cast<uint32_t>(mesh->meshlets.size()), sizeof(VkDrawIndexedIndirectCommand));
+		}
+		else {
+			for (const IndexRange& range : mesh->lods[models.lods[m]].indexRanges) {
+				vkCmdDrawIndexed(commandBuffers[imageIndex], range.indexCount, 1, range.firstIndex, static_cast<int32_t>(range.firstVertex), 0);
+			}
+		}
+
+		if (queried) {
+			vkCmdEndQuery(commandBuffers[imageIndex], statisticsQueryPool, firstQuery + slot);
+			statisticsQueried[imageIndex].push_back({ slot, models.slotGenerations[slot] });
+		}
 
 	}
 	vkCmdEndRenderPass(commandBuffers[imageIndex]);
 
+	recordFrameReadback(imageIndex);
+
 	if (vkEndCommandBuffer(commandBuffers[imageIndex]) != VK_SUCCESS) {
 		throw std::runtime_error("failed to record command buffer!");
 	}
@@ -929,9 +1424,13 @@ void VulkanRenderer::allocateCommandBuffers() {
 void VulkanRenderer::drawFrame() {
 	vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
 	
-	uint32_t imageIndex;
-	VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame],
-											VK_NULL_HANDLE, &imageIndex);
+	//headless images are simply taken in turn, and are never out of date
+	uint32_t imageIndex = static_cast<uint32_t>(frameNumber % swapChainImages.size());
+	VkResult result = VK_SUCCESS;
+	if (!headless) {
+		result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame],
+										VK_NULL_HANDLE, &imageIndex);
+	}
 
 	
 	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
@@ -948,15 +1447,32 @@ void VulkanRenderer::drawFrame() {
 
 	imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 
+	//the fence for this image has been waited on, so the queries from its last frame are done
+	reportVertexInvocations(imageIndex);
+	//and so have the copies of the last frame that used this frame in flight
+	collectFrameReadback(currentFrame);
+
+	frameNumber++;
+	updateTextureResidency();
+
+	if (!sceneInstantiated) {
+		instantiateSceneObjects(SCENE_INSTANCES_PER_FRAME);
+	}
 	
 	updateModels();
+	updateStatisticsQueryPool();
+	updateMeshletCulling();
+
+	if (viewCount > 1) {
+		memcpy(uniformBuffersMapped[imageIndex], &viewUniforms, sizeof(viewUniforms));
+	}
 
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
 	VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
 	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.waitSemaphoreCount = headless ? 0 : 1;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
 
@@ -966,7 +1482,7 @@ void VulkanRenderer::drawFrame() {
 	submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
 
 	VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.signalSemaphoreCount = headless ? 0 : 1;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
 	vkResetFences(device, 1, &inFlightFences[currentFrame]);
@@ -976,6 +1492,11 @@ void VulkanRenderer::drawFrame() {
 		throw std::runtime_error("failed to submit draw command");
 	}
 
+	if (headless) {
+		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		return;
+	}
+
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.waitSemaphoreCount = 1;
@@ -1034,6 +1555,10 @@ void VulkanRenderer::recreateSwapChain() {
 
 	vkDeviceWaitIdle(device);
 
+	//the ring is sized for the old extent
+	finishFrameReadback();
+	destroyFrameReadback();
+
 	cleanupSwapChain();
 
 	createSwapChain();
@@ -1045,7 +1570,7 @@ void VulkanRenderer::recreateSwapChain() {
 	createFramebuffers();
 	createDescriptorPool();
 	createDescriptorSets();
-	
+	createFrameReadback();
 }
 
 void VulkanRenderer::cleanupSwapChain() {
@@ -1063,7 +1588,9 @@ void VulkanRenderer::cleanupSwapChain() {
 	}
 
 
-	vkDestroyPipeline(device, graphicsPipeline, nullptr);
+	for (VkPipeline pipeline : graphicsPipelines) {
+		vkDestroyPipeline(device, pipeline, nullptr);
+	}
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyRenderPass(device, renderPass, nullptr);
 
@@ -1071,7 +1598,15 @@ void VulkanRenderer::cleanupSwapChain() {
 		vkDestroyImageView(device, imageView, nullptr);
 	}
 
-	vkDestroySwapchainKHR(device, swapChain, nullptr);
+	if (headless) {
+		for (size_t i = 0; i < swapChainImages.size(); i++) {
+			vkDestroyImage(device, swapChainImages[i], nullptr);
+			vkFreeMemory(device, headlessImagesMemory[i], nullptr);
+		}
+	}
+	else {
+		vkDestroySwapchainKHR(device, swapChain, nullptr);
+	}
 
 	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 }
@@ -1093,16 +1628,14 @@ VkExtent2D VulkanRenderer::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capa
 	}
 }
 
-void VulkanRenderer::createVertexBuffer(const std::vector<Vertex>& verticies, VkBuffer& vertexBuffer, VkDeviceMemory& vertexBufferMemory) {
-	VkDeviceSize bufferSize = sizeof(verticies[0]) * verticies.size();
-
+void VulkanRenderer::createVertexBuffer(const void* verticies, VkDeviceSize bufferSize, VkBuffer& vertexBuffer, VkDeviceMemory& vertexBufferMemory) {
 	VkBuffer stagingBuffer;
 	VkDeviceMemory stagingBufferMemory;
 	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
 	
 	void* data;
 	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, verticies.data(), (size_t)bufferSize);
+	memcpy(data, verticies, (size_t)bufferSize);
 	vkUnmapMemory(device, stagingBufferMemory);
 
 	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT , VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
@@ -1164,9 +1697,17 @@ void VulkanRenderer::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDevice
 
 }
 
-void VulkanRenderer::createIndexBuffer(const std::vector<uint32_t>& indicies, VkBuffer& indexBuffer, VkDeviceMemory& indexBufferMemory) {
+void VulkanRenderer::createIndexBuffer(const std::vector<uint32_t>& indicies, VkIndexType indexType, VkBuffer& indexBuffer, VkDeviceMemory& indexBufferMemory) {
+	std::vector<uint16_t> shortIndicies;
+	const void* source = indicies.data();
 	VkDeviceSize bufferSize = sizeof(indicies[0]) * indicies.size();
 
+	if (indexType == VK_INDEX_TYPE_UINT16) {
+		shortIndicies.assign(indicies.begin(), indicies.end());
+		source = shortIndicies.data();
+		bufferSize = sizeof(shortIndicies[0]) * shortIndicies.size();
+	}
+
 	VkBuffer stagingBuffer;
 	VkDeviceMemory stagingBufferMemory;
 	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
@@ -1174,7 +1715,7 @@ void VulkanRenderer::createIndexBuffer(const std::vector<uint32_t>& indicies, Vk
 
 	void* data;
 	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indicies.data(), (size_t)bufferSize);
+	memcpy(data, source, (size_t)bufferSize);
 	vkUnmapMemory(device, stagingBufferMemory);
 
 	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
@@ -1194,7 +1735,18 @@ void VulkanRenderer::createDescriptorSetLayout() {
 	samplerLayoutBinding.pImmutableSamplers = nullptr;
 	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-	std::array<VkDescriptorSetLayoutBinding, 1> bindings = {samplerLayoutBinding };
+	VkDescriptorSetLayoutBinding viewsLayoutBinding = {};
+	viewsLayoutBinding.binding = 1;
+	viewsLayoutBinding.descriptorCount = 1;
+	viewsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	viewsLayoutBinding.pImmutableSamplers = nullptr;
+	viewsLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	//the views only come from a buffer when there is more than one
+	std::vector<VkDescriptorSetLayoutBinding> bindings = { samplerLayoutBinding };
+	if (viewCount > 1) {
+		bindings.push_back(viewsLayoutBinding);
+	}
 	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
@@ -1212,572 +1764,3427 @@ void VulkanRenderer::updateModels() {
 
 	auto currentTime = std::chrono::high_resolution_clock::now();
 	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-	
-	for (const auto model : modelsArray) {
-		model->mvp.model = glm::translate(glm::mat4(1.0f), model->transform.location);
-		model->mvp.model = glm::rotate(model->mvp.model, time * glm::radians(model->transform.rotation.x), glm::vec3(0.0f, 0.0f, 1.0f));
-		model->mvp.model = glm::scale(model->mvp.model, model->transform.scale);
-		model->mvp.view = glm::lookAt(glm::vec3(0.0f, 7.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
-		model->mvp.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 10.0f);
+	if (headless) {
+		time = (frameNumber - 1) / HEADLESS_FRAMES_PER_SECOND;
+	}
 
-		//glm made for openGL, need to flip the y as they are opposite in vulkan
-		model->mvp.proj[1][1] *= -1;
+	std::array<Camera, MULTIVIEW_MAX_VIEWS> views;
+	for (uint32_t v = 0; v < viewCount; v++) {
+		views[v] = camera;
+
+		//every view of a batch sees the scene as it is at the start
+		if (!cameraPoses.empty()) {
+			size_t pose = static_cast<size_t>(frameNumber - 1) * viewCount + v;
+			views[v] = cameraPoses[std::min(pose, cameraPoses.size() - 1)];
+			time = 0.0f;
+		}
+		//side by side like a pair of eyes, all looking the same way
+		else if (viewCount > 1) {
+			glm::vec3 right = glm::normalize(glm::cross(camera.target - camera.eye, camera.up));
+			glm::vec3 offset = right * ((v - (viewCount - 1) * 0.5f) * viewSeparation);
+			views[v].eye += offset;
+			views[v].target += offset;
+		}
 	}
-}
 
-void VulkanRenderer::createDescriptorPool() {
-	std::array<VkDescriptorPoolSize, 1> poolSizes = {};
+	if (!cameraPoses.empty()) {
+		camera = views[0];
+	}
 
-	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size()) * TEXTURES_USED;
+	float nearPlane = 0.1f;
+	//how many pixels something one unit across covers at a distance of one
+	std::array<float, MULTIVIEW_MAX_VIEWS> pixelsPerUnit;
 
-	VkDescriptorPoolCreateInfo poolInfo = {};
-	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-	poolInfo.pPoolSizes = poolSizes.data();
-	poolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size()) ;
+	for (uint32_t v = 0; v < viewCount; v++) {
+		float fieldOfView = glm::radians(views[v].fieldOfView);
+		pixelsPerUnit[v] = swapChainExtent.height / (2.0f * std::tan(fieldOfView * 0.5f));
 
-	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
-		std::runtime_error("failed to create descriptor pool!");
-	}
-}
+		viewUniforms.view[v] = glm::lookAt(views[v].eye, views[v].target, views[v].up);
+		viewUniforms.proj[v] = glm::perspective(fieldOfView, swapChainExtent.width / (float)swapChainExtent.height, nearPlane, 10.0f);
 
-void VulkanRenderer::createDescriptorSets() {
-	std::vector<VkDescriptorSetLayout> layouts(swapChainImages.size(), descriptorSetLayout);
-	VkDescriptorSetAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	allocInfo.descriptorPool = descriptorPool;
-	allocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
-	allocInfo.pSetLayouts = layouts.data();
+		//glm made for openGL, need to flip the y as they are opposite in vulkan
+		viewUniforms.proj[v][1][1] *= -1;
+	}
 
-	descriptorSets.resize(swapChainImages.size());
+	modelTime = time;
+	updateHierarchy(time);
 
+	//models out of every view keep what they had, they are not drawn or culled
+	std::array<glm::mat4, MULTIVIEW_MAX_VIEWS> viewProjections;
+	for (uint32_t v = 0; v < viewCount; v++) {
+		viewProjections[v] = viewUniforms.proj[v] * viewUniforms.view[v];
+	}
 
-	if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate descriptor sets!");
+	visibleModels.clear();
+	spatialGrid.queryFrustums(viewProjections.data(), viewCount, visibleModels);
+	//the grid gives slots, drawn in the order they are stored like before they were culled
+	for (uint32_t& m : visibleModels) {
+		m = models.slotIndices[m];
 	}
+	std::sort(visibleModels.begin(), visibleModels.end());
 
-	for (size_t i = 0; i < swapChainImages.size(); i++) {
-		
-		std::array<VkWriteDescriptorSet, 1> descriptorWrites = {};
-		VkDescriptorImageInfo samplerInfo = {};
-		std::vector<VkDescriptorImageInfo> descriptorImageInfos(TEXTURES_USED);
+	for (uint32_t m : visibleModels) {
+		glm::mat4 matrix = models.parentWorlds[m] * transformMatrix(models.transforms[m], models.isStatic[m] != 0, time);
 
-		for (uint32_t j = 0; j < TEXTURES_USED; j++) {
-			if (textureArray[j] != nullptr) {
-				descriptorImageInfos[j].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				descriptorImageInfos[j].imageView = textureArray[j]->imageView;
-				descriptorImageInfos[j].sampler = textureSampler;
-			}
+		//the coarsest level whose error, projected at the nearest point of the bounds, stays under the pixel limit in every view
+		const Mesh* mesh = models.meshes[m];
+		float scale = std::max(glm::length(glm::vec3(matrix[0])), std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+		glm::vec3 center = glm::vec3(matrix * glm::vec4(mesh->boundsCenter, 1.0f));
+
+		std::array<float, MULTIVIEW_MAX_VIEWS> distances;
+		for (uint32_t v = 0; v < viewCount; v++) {
+			distances[v] = std::max(glm::length(center - views[v].eye) - mesh->boundsRadius * scale, nearPlane);
 		}
 
-		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[0].dstSet = descriptorSets[i];
-		descriptorWrites[0].dstBinding = 0;
-		descriptorWrites[0].dstArrayElement = 0;
-		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		descriptorWrites[0].descriptorCount = TEXTURES_USED;
-		descriptorWrites[0].pImageInfo = descriptorImageInfos.data();
+		models.lods[m] = 0;
+		for (uint32_t lod = 1; lod < mesh->lods.size(); lod++) {
+			bool noticeable = false;
+			for (uint32_t v = 0; v < viewCount; v++) {
+				noticeable = noticeable || mesh->lods[lod].error * scale / distances[v] * pixelsPerUnit[v] > MESH_LOD_PIXEL_ERROR;
+			}
+
+			if (!noticeable) {
+				models.lods[m] = lod;
+			}
+		}
 
+		constantBufferMVP& mvp = models.mvps[m];
+		//quantized meshes are stored in 0-1 across their bounds
+		mvp.model = matrix * mesh->dequantize;
 
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data() ,0, nullptr);
+		//multiview.vert takes these from viewUniforms instead
+		mvp.view = viewUniforms.view[0];
+		mvp.proj = viewUniforms.proj[0];
 	}
 }
 
-VulkanRenderer::Texture* VulkanRenderer::loadTexture(std::string texturePath) {
-	int texWidth;
-	int texHeight;
-	int texChannels;
+//the rays can hit models that were not in view, so every model is put where it was in the last frame, once a frame at most
+void VulkanRenderer::updateSceneBvh() {
+	if (sceneBvhFrame == frameNumber && bvhInstances.size() == models.size()) {
+		return;
+	}
+	sceneBvhFrame = frameNumber;
 
-	unsigned char* pixels = stbi_load(texturePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+	bvhInstances.resize(models.size());
+	for (size_t i = 0; i < models.size(); i++) {
+		bvhInstances[i] = { models.meshes[i]->bvh.get(), models.parentWorlds[i] * transformMatrix(models.transforms[i], models.isStatic[i] != 0, modelTime) };
+	}
 
-	VkDeviceSize imageSize = texWidth * texHeight * 4;
+	//the models only spin in place, so refitting keeps the tree good until more are placed
+	if (sceneBvh.size() != bvhInstances.size()) {
+		sceneBvh.build(bvhInstances, &workerPool);
+	}
+	else {
+		sceneBvh.refit(bvhInstances);
+	}
+}
 
-	//basically log2(tex_dimensions)
-	mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+std::vector<uint32_t> VulkanRenderer::modelsNear(glm::vec3 center, float radius) {
+	std::vector<uint32_t> found;
+	spatialGrid.querySphere(center, radius, found);
 
-	if (!pixels) {
-		throw std::runtime_error("failed to load texture image");
+	for (uint32_t& m : found) {
+		m = models.slotIndices[m];
 	}
+	std::sort(found.begin(), found.end());
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	Texture* new_texture = new Texture;
-	new_texture->height = texHeight;
-	new_texture->width = texWidth;
-	createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	return found;
+}
 
-	void* data;
-	vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(device, stagingBufferMemory);
-	stbi_image_free(pixels);
+std::vector<RayHit> VulkanRenderer::castRays(const std::vector<Ray>& rays) {
+	updateSceneBvh();
 
-	createImage(texWidth, texHeight, mipLevels,VK_SAMPLE_COUNT_1_BIT ,VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, new_texture->image, new_texture->imageMemory);
+	std::vector<RayHit> hits(rays.size());
 
-	transitionImageLayout(new_texture->image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-	copyBufferToImage(stagingBuffer, new_texture->image, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-	
+	size_t packetCount = (rays.size() + 3) / 4;
+	workerPool.parallelFor(packetCount, 64, [&](size_t begin, size_t end) {
+		for (size_t packet = begin; packet < end; packet++) {
+			size_t first = packet * 4;
+			uint32_t count = static_cast<uint32_t>(std::min<size_t>(4, rays.size() - first));
 
-	generateMipmaps(new_texture->image, VK_FORMAT_R8G8B8A8_UNORM ,texWidth, texHeight, mipLevels);
+			sceneBvh.intersect4(&rays[first], &hits[first], count);
+		}
+	});
 
-	createTextureImageView(new_texture);
+	return hits;
+}
+
+//a ray from the near plane to the far plane through the point, using the camera of the last frame
+void VulkanRenderer::pickAt(double cursorX, double cursorY) {
+	int windowWidth = static_cast<int>(swapChainExtent.width);
+	int windowHeight = static_cast<int>(swapChainExtent.height);
+	if (!headless) {
+		glfwGetWindowSize(window, &windowWidth, &windowHeight);
+	}
+	if (windowWidth == 0 || windowHeight == 0) {
+		return;
+	}
+
+	//the projection's y is already flipped, so down the window is down in clip space too
+	float x = static_cast<float>(cursorX / windowWidth * 2.0 - 1.0);
+	float y = static_cast<float>(cursorY / windowHeight * 2.0 - 1.0);
+
+	glm::mat4 inverse = glm::inverse(viewUniforms.proj[0] * viewUniforms.view[0]);
+	glm::vec4 nearPoint = inverse * glm::vec4(x, y, 0.0f, 1.0f);
+	glm::vec4 farPoint = inverse * glm::vec4(x, y, 1.0f, 1.0f);
+
+	Ray ray;
+	ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+	ray.direction = glm::vec3(farPoint) / farPoint.w - ray.origin;
+	ray.maxDistance = 1.0f;
+
+	updateSceneBvh();
+
+	RayHit hit = sceneBvh.intersect(ray);
+	if (hit.instance == ~0u) {
+		std::cout << "nothing under the cursor" << std::endl;
+		return;
+	}
+
+	glm::vec3 point = ray.origin + ray.direction * hit.distance;
+	std::vector<uint32_t> nearby = modelsNear(point, 1.0f);
+	nearby.erase(std::remove(nearby.begin(), nearby.end(), hit.instance), nearby.end());
+
+	std::cout << "picked " << models.names[hit.instance] << ", triangle " << hit.triangle << " at ("
+		<< point.x << ", " << point.y << ", " << point.z << "), " << nearby.size() << " others within a unit" << std::endl;
+}
+
+glm::mat4 VulkanRenderer::transformMatrix(const Transform& transform, bool isStatic, float time) {
+	glm::mat4 matrix = glm::translate(glm::mat4(1.0f), transform.location);
+	float angle = isStatic ? glm::radians(transform.rotation.x) : time * glm::radians(transform.rotation.x);
+	matrix = glm::rotate(matrix, angle, glm::vec3(0.0f, 0.0f, 1.0f));
+
+	return glm::scale(matrix, transform.scale);
+}
+
+/* makes sure viewCount can be drawn before the device is made. the meshlet culling pass only
+	looks from one eye, so it is left out, and a batch's poses are shared out viewCount to a frame*/
+void VulkanRenderer::checkMultiview() {
+	if (viewCount <= 1) {
+		return;
+	}
+
+	if (!headless) {
+		throw std::runtime_error("multiview needs headless, swap chain images only have one layer!");
+	}
+	if (viewCount > MULTIVIEW_MAX_VIEWS) {
+		throw std::runtime_error("more views than MULTIVIEW_MAX_VIEWS!");
+	}
+
+	//unlike the compute shaders there is nothing to fall back to, vert.spv only has the one view
+	std::ifstream shaderFile("shaders/multiview.spv");
+	if (!shaderFile.is_open()) {
+		throw std::runtime_error("shaders/multiview.spv is missing, run shaders/compile.bat!");
+	}
+	shaderFile.close();
+
+	//the extension itself depends on VK_KHR_get_physical_device_properties2
+	bool supported = getPhysicalDeviceProperties2Enabled && isDeviceExtensionAvailable(physicalDevice, VK_KHR_MULTIVIEW_EXTENSION_NAME);
+
+	if (supported) {
+		auto getPhysicalDeviceFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+
+		VkPhysicalDeviceMultiviewFeaturesKHR multiviewFeatures = {};
+		multiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR;
+
+		VkPhysicalDeviceFeatures2KHR features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features.pNext = &multiviewFeatures;
+
+		supported = getPhysicalDeviceFeatures2 != nullptr;
+		if (supported) {
+			getPhysicalDeviceFeatures2(physicalDevice, &features);
+			supported = multiviewFeatures.multiview == VK_TRUE;
+		}
+	}
+
+	if (!supported) {
+		throw std::runtime_error("device does not support VK_KHR_multiview!");
+	}
+
+	useMeshletCulling = false;
+
+	if (!cameraPoses.empty()) {
+		headlessFrames = (cameraPoses.size() + viewCount - 1) / viewCount;
+	}
+}
+
+void VulkanRenderer::createViewBuffers() {
+	//multiview.vert's Views block is std140, four views then four projections starting at 256
+	static_assert(sizeof(ViewUniforms) == 512, "ViewUniforms has to match the Views block in multiview.vert");
+
+	if (viewCount <= 1) {
+		return;
+	}
+
+	uniformBuffers.resize(swapChainImages.size());
+	uniformBuffersMemory.resize(swapChainImages.size());
+	uniformBuffersMapped.resize(swapChainImages.size());
+
+	for (size_t i = 0; i < swapChainImages.size(); i++) {
+		createBuffer(sizeof(ViewUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			uniformBuffers[i], uniformBuffersMemory[i]);
+		vkMapMemory(device, uniformBuffersMemory[i], 0, sizeof(ViewUniforms), 0, &uniformBuffersMapped[i]);
+	}
+}
+
+void VulkanRenderer::createDescriptorPool() {
+	std::vector<VkDescriptorPoolSize> poolSizes(1);
+
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size()) * TEXTURES_USED;
+
+	if (viewCount > 1) {
+		VkDescriptorPoolSize viewsSize = {};
+		viewsSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		viewsSize.descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+		poolSizes.push_back(viewsSize);
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size()) ;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		std::runtime_error("failed to create descriptor pool!");
+	}
+}
+
+void VulkanRenderer::createDescriptorSets() {
+	std::vector<VkDescriptorSetLayout> layouts(swapChainImages.size(), descriptorSetLayout);
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
+	allocInfo.pSetLayouts = layouts.data();
+
+	descriptorSets.resize(swapChainImages.size());
+	descriptorSetViews.assign(swapChainImages.size(), {});
+
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate descriptor sets!");
+	}
+
+	for (size_t i = 0; i < swapChainImages.size(); i++) {
+		
+		std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
+		VkDescriptorImageInfo samplerInfo = {};
+		std::vector<VkDescriptorImageInfo> descriptorImageInfos(TEXTURES_USED);
+
+		//slots no texture has been acquired for, or whose texture was released, show the placeholder
+		for (uint32_t j = 0; j < TEXTURES_USED; j++) {
+			Texture* texture = textureArray[j] != nullptr ? textureArray[j] : placeholderTexture;
+
+			descriptorImageInfos[j].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			descriptorImageInfos[j].imageView = texture->imageView;
+			descriptorImageInfos[j].sampler = textureSampler;
+			descriptorSetViews[i][j] = texture->imageView;
+		}
+
+		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[0].dstSet = descriptorSets[i];
+		descriptorWrites[0].dstBinding = 0;
+		descriptorWrites[0].dstArrayElement = 0;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[0].descriptorCount = TEXTURES_USED;
+		descriptorWrites[0].pImageInfo = descriptorImageInfos.data();
+
+		VkDescriptorBufferInfo viewsInfo = {};
+		if (viewCount > 1) {
+			viewsInfo.buffer = uniformBuffers[i];
+			viewsInfo.offset = 0;
+			viewsInfo.range = sizeof(ViewUniforms);
+
+			descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[1].dstSet = descriptorSets[i];
+			descriptorWrites[1].dstBinding = 1;
+			descriptorWrites[1].dstArrayElement = 0;
+			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			descriptorWrites[1].descriptorCount = 1;
+			descriptorWrites[1].pBufferInfo = &viewsInfo;
+		}
+
+		vkUpdateDescriptorSets(device, viewCount > 1 ? 2 : 1, descriptorWrites.data() ,0, nullptr);
+	}
+
+	//the old sets went with the old pool, so views only they pointed at can go now
+	destroyRetiredImages();
+}
+
+VulkanRenderer::ImageData VulkanRenderer::decodeTexture(const std::string& texturePath) {
+	ImageData imageData = {};
+	int texChannels;
+
+	imageData.pixels = stbi_load(texturePath.c_str(), &imageData.width, &imageData.height, &texChannels, STBI_rgb_alpha);
+
+	if (!imageData.pixels) {
+		throw std::runtime_error("failed to load texture image");
+	}
+
+	imageData.format = VK_FORMAT_R8G8B8A8_UNORM;
+
+	return imageData;
+}
+
+VulkanRenderer::ImageData VulkanRenderer::prepareImage(const std::string& texturePath, bool checkDeviceSupport) {
+	//best quality first, the files are only there if --compress-textures has been run on the texture
+	static const BlockFormat compressedFormats[] = { BlockFormat::BC7, BlockFormat::BC3, BlockFormat::BC1 };
+
+	if (hasKtx2Extension(texturePath)) {
+		ImageData imageData = {};
+		imageData.ktx = std::make_unique<KtxTexture>(loadKtx2(texturePath));
+		imageData.ktx->file.prefetch();
+		imageData.width = imageData.ktx->width;
+		imageData.height = imageData.ktx->height;
+		imageData.format = static_cast<VkFormat>(imageData.ktx->vkFormat);
+
+		return imageData;
+	}
+
+	if (useCompressedTextures) {
+		for (BlockFormat format : compressedFormats) {
+			ImageData compressed = {};
+			BlockFormat fileFormat;
+
+			if (!readDds(compressedTexturePath(texturePath, format), compressed.mipChain, fileFormat)) {
+				continue;
+			}
+
+			compressed.format = blockFormatToVulkan(fileFormat);
+			compressed.width = compressed.mipChain.width;
+			compressed.height = compressed.mipChain.height;
+
+			if (!checkDeviceSupport || isSampledFormatSupported(compressed.format)) {
+				return compressed;
+			}
+		}
+	}
+
+	ImageData imageData = decodeTexture(texturePath);
+
+	if (useCpuMipmaps) {
+		//textures hold colour so they are filtered in linear space, the pool splits up the rows of each level
+		imageData.mipChain = buildMipChain(imageData.pixels, imageData.width, imageData.height, cpuMipFilter, true, &workerPool);
+		stbi_image_free(imageData.pixels);
+		imageData.pixels = nullptr;
+	}
+
+	return imageData;
+}
+
+VkFormat VulkanRenderer::blockFormatToVulkan(BlockFormat format) {
+	//unorm to match the uncompressed textures, which are not uploaded as srgb either
+	switch (format) {
+	case BlockFormat::BC1:
+		return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	case BlockFormat::BC3:
+		return VK_FORMAT_BC3_UNORM_BLOCK;
+	case BlockFormat::BC7:
+		return VK_FORMAT_BC7_UNORM_BLOCK;
+	}
+
+	throw std::runtime_error("unknown block format!");
+}
+
+bool VulkanRenderer::isSampledFormatSupported(VkFormat format) {
+	//block formats also need the feature to have been turned on when the device was made
+	bool blockCompressed = format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+	if (blockCompressed && !textureCompressionBC) {
+		return false;
+	}
+
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+
+	return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+VulkanRenderer::Texture* VulkanRenderer::loadTexture(std::string texturePath) {
+	Texture* texture = new Texture;
+	texture->sourcePath = texturePath;
+
+	uploadTexture(texture, takeDecodedImage(texturePath));
+
+	return texture;
+}
+
+//fills in the gpu side of texture, used for the first load and again when an evicted texture is needed
+void VulkanRenderer::uploadTexture(Texture* texture, ImageData imageData) {
+	const std::string& texturePath = texture->sourcePath;
+
+	if (!isSampledFormatSupported(imageData.format)) {
+		//decoding starts before there is a device to ask, so go through the files again now that there is one
+		imageData = prepareImage(texturePath, true);
+
+		if (!isSampledFormatSupported(imageData.format)) {
+			throw std::runtime_error("the device cannot sample the format of " + texturePath + "!");
+		}
+	}
+
+	if (imageData.ktx || !imageData.mipChain.levels.empty()) {
+		const unsigned char* data = imageData.ktx ? imageData.ktx->file.data() : imageData.mipChain.data.data();
+		const std::vector<MipLevel>& levels = imageData.ktx ? imageData.ktx->levels : imageData.mipChain.levels;
+
+		uint32_t firstLevel = useTextureStreaming ? firstResidentLevel(levels) : 0;
+		uploadLevels(texture, data, levels, imageData.format, firstLevel);
+
+		if (firstLevel > 0) {
+			//the mapping and the vector both keep their memory when moved, so data stays valid
+			TextureStream stream;
+			stream.texture = texture;
+			stream.data = data;
+			stream.levels = levels;
+			stream.nextRow = 0;
+			stream.source = std::move(imageData);
+
+			textureStreams.push_back(std::move(stream));
+		}
+	}
+	else {
+		unsigned char* pixels = imageData.pixels;
+		int texWidth = imageData.width;
+		int texHeight = imageData.height;
+
+		VkDeviceSize imageSize = texWidth * texHeight * 4;
+
+		uint32_t mipLevels = mipLevelCount(texWidth, texHeight);
+
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingBufferMemory;
+		texture->height = texHeight;
+		texture->width = texWidth;
+		texture->mipLevels = mipLevels;
+		texture->format = VK_FORMAT_R8G8B8A8_UNORM;
+		texture->residentMip = 0;
+		createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+		void* data;
+		vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
+		memcpy(data, pixels, static_cast<size_t>(imageSize));
+		vkUnmapMemory(device, stagingBufferMemory);
+		stbi_image_free(pixels);
+
+		//storage is only asked for when the format allows it, which is also when the compute path is taken
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		if (canGenerateMipmapsCompute(VK_FORMAT_R8G8B8A8_UNORM, mipLevels)) {
+			usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		}
+
+		createImage(texWidth, texHeight, mipLevels,VK_SAMPLE_COUNT_1_BIT ,VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+			usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture->image, texture->imageMemory);
+
+		transitionImageLayout(texture->image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+		copyBufferToImage(stagingBuffer, texture->image, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+	
+
+		generateMipmaps(texture->image, VK_FORMAT_R8G8B8A8_UNORM ,texWidth, texHeight, mipLevels);
+
+		createTextureImageView(texture);
+
+		vkDestroyBuffer(device, stagingBuffer, nullptr);
+		vkFreeMemory(device, stagingBufferMemory, nullptr);
+	}
+
+	//the whole chain is allocated up front even when streaming, so this is what it holds from now on
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, texture->image, &memRequirements);
+	texture->memorySize = memRequirements.size;
+	texture->resident = true;
+	texture->lastUsedFrame = frameNumber;
+}
+
+void VulkanRenderer::uploadLevels(Texture* texture, const unsigned char* data, const std::vector<MipLevel>& levels, VkFormat format, uint32_t firstLevel) {
+	texture->width = levels[0].width;
+	texture->height = levels[0].height;
+	texture->mipLevels = static_cast<uint32_t>(levels.size());
+	texture->format = format;
+	texture->residentMip = firstLevel;
+
+	uint32_t blockDimension;
+	uint32_t blockBytes;
+	texelBlockInfo(format, blockDimension, blockBytes);
+
+	//every level is already there so the image is never a blit source
+	createImage(texture->width, texture->height, texture->mipLevels, VK_SAMPLE_COUNT_1_BIT, format, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture->image, texture->imageMemory);
+
+	transitionImageLayout(texture->image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture->mipLevels);
+
+	/* each level goes into the ring as one region when it fits, otherwise it is split into bands of block rows.
+		when the ring is full the copies so far are submitted and it starts again from the front.
+		levels above firstLevel are left in transfer dst for recordTextureStreaming to fill in later*/
+	std::vector<VkBufferImageCopy> regions;
+
+	for (size_t i = firstLevel; i < levels.size(); i++) {
+		const MipLevel& level = levels[i];
+		uint32_t blockRows = (level.height + blockDimension - 1) / blockDimension;
+		VkDeviceSize rowPitch = static_cast<VkDeviceSize>((level.width + blockDimension - 1) / blockDimension) * blockBytes;
+
+		if (rowPitch * blockRows > level.size) {
+			throw std::runtime_error("texture level is smaller than its format and size need!");
+		}
+
+		uint32_t row = 0;
+		while (row < blockRows) {
+			VkDeviceSize offset;
+			uint32_t rows = allocateStagingRows(stagingRing, rowPitch, blockRows - row, offset);
+
+			if (rows == 0) {
+				flushStagingCopies(texture->image, regions);
+				rows = allocateStagingRows(stagingRing, rowPitch, blockRows - row, offset);
+
+				if (rows == 0) {
+					throw std::runtime_error("a single row of the texture does not fit in the staging ring!");
+				}
+			}
+
+			memcpy(stagingRing.mapped + offset, data + level.offset + row * rowPitch, static_cast<size_t>(rows * rowPitch));
+
+			uint32_t firstTexelRow = row * blockDimension;
+
+			VkBufferImageCopy region = {};
+			region.bufferOffset = offset;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = static_cast<uint32_t>(i);
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+
+			region.imageOffset = { 0, static_cast<int32_t>(firstTexelRow), 0 };
+			region.imageExtent = {
+				level.width,
+				std::min(rows * blockDimension, level.height - firstTexelRow),
+				1
+			};
+
+			regions.push_back(region);
+			row += rows;
+		}
+	}
+
+	flushStagingCopies(texture->image, regions);
+
+	transitionImageLayout(texture->image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture->mipLevels - firstLevel, firstLevel);
+
+	createTextureImageView(texture);
+}
+
+void VulkanRenderer::texelBlockInfo(VkFormat format, uint32_t& blockDimension, uint32_t& blockBytes) {
+	blockDimension = 1;
+
+	switch (format) {
+	case VK_FORMAT_R8_UNORM:
+		blockBytes = 1;
+		break;
+	case VK_FORMAT_R8G8_UNORM:
+		blockBytes = 2;
+		break;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		blockBytes = 4;
+		break;
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		blockBytes = 8;
+		break;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		blockBytes = 16;
+		break;
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC4_SNORM_BLOCK:
+		blockDimension = 4;
+		blockBytes = 8;
+		break;
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		blockDimension = 4;
+		blockBytes = 16;
+		break;
+	default:
+		throw std::runtime_error("texture format is not one the loader knows the size of!");
+	}
+}
+
+void VulkanRenderer::createStagingRing(StagingRing& ring, VkDeviceSize size) {
+	ring.size = size;
+	ring.head = 0;
+
+	createBuffer(ring.size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ring.buffer, ring.memory);
+
+	//stays mapped for the life of the renderer, uploads just copy into it
+	void* data;
+	vkMapMemory(device, ring.memory, 0, ring.size, 0, &data);
+	ring.mapped = static_cast<unsigned char*>(data);
+}
+
+void VulkanRenderer::destroyStagingRing(StagingRing& ring) {
+	vkUnmapMemory(device, ring.memory);
+	vkDestroyBuffer(device, ring.buffer, nullptr);
+	vkFreeMemory(device, ring.memory, nullptr);
+}
+
+uint32_t VulkanRenderer::allocateStagingRows(StagingRing& ring, VkDeviceSize rowPitch, uint32_t rowsWanted, VkDeviceSize& offset) {
+	//16 is a multiple of every texel block size that goes through here, copies need their offset aligned to it
+	offset = (ring.head + 15) & ~static_cast<VkDeviceSize>(15);
+
+	if (offset >= ring.size) {
+		return 0;
+	}
+
+	uint32_t rows = static_cast<uint32_t>(std::min<VkDeviceSize>(rowsWanted, (ring.size - offset) / rowPitch));
+	ring.head = offset + rows * rowPitch;
+
+	return rows;
+}
+
+uint32_t VulkanRenderer::firstResidentLevel(const std::vector<MipLevel>& levels) {
+	for (uint32_t i = 0; i < levels.size(); i++) {
+		if (std::max(levels[i].width, levels[i].height) <= STREAMING_RESIDENT_SIZE) {
+			return i;
+		}
+	}
+
+	return static_cast<uint32_t>(levels.size()) - 1;
+}
+
+void VulkanRenderer::recordTextureStreaming(VkCommandBuffer commandBuffer) {
+	if (textureStreams.empty()) {
+		return;
+	}
+
+	//the fence for this frame has been waited on, so the copies last recorded out of this buffer are done
+	StagingRing& staging = streamingStaging[currentFrame];
+	staging.head = 0;
+
+	//one level of each texture per pass, so they all sharpen together instead of one after another
+	bool budgetLeft = true;
+	while (budgetLeft && !textureStreams.empty()) {
+		for (auto& stream : textureStreams) {
+			if (!streamNextLevel(commandBuffer, staging, stream)) {
+				budgetLeft = false;
+				break;
+			}
+		}
+
+		textureStreams.erase(std::remove_if(textureStreams.begin(), textureStreams.end(), [](const TextureStream& stream) {
+			return stream.texture->residentMip == 0;
+		}), textureStreams.end());
+	}
+}
+
+bool VulkanRenderer::streamNextLevel(VkCommandBuffer commandBuffer, StagingRing& staging, TextureStream& stream) {
+	Texture* texture = stream.texture;
+	uint32_t level = texture->residentMip - 1;
+	const MipLevel& mip = stream.levels[level];
+
+	uint32_t blockDimension;
+	uint32_t blockBytes;
+	texelBlockInfo(texture->format, blockDimension, blockBytes);
+
+	uint32_t blockRows = (mip.height + blockDimension - 1) / blockDimension;
+	VkDeviceSize rowPitch = static_cast<VkDeviceSize>((mip.width + blockDimension - 1) / blockDimension) * blockBytes;
+
+	VkDeviceSize offset;
+	uint32_t rows = allocateStagingRows(staging, rowPitch, blockRows - stream.nextRow, offset);
+
+	if (rows == 0) {
+		return false;
+	}
+
+	memcpy(staging.mapped + offset, stream.data + mip.offset + stream.nextRow * rowPitch, static_cast<size_t>(rows * rowPitch));
+
+	uint32_t firstTexelRow = stream.nextRow * blockDimension;
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = offset;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = level;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, static_cast<int32_t>(firstTexelRow), 0 };
+	region.imageExtent = { mip.width, std::min(rows * blockDimension, mip.height - firstTexelRow), 1 };
+
+	vkCmdCopyBufferToImage(commandBuffer, staging.buffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	stream.nextRow += rows;
+	if (stream.nextRow < blockRows) {
+		return true;
+	}
+
+	//the whole level is in, it can be read by the draws later in this same command buffer
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = texture->image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = level;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+
+	//descriptor sets still using the old view move over to the new one as their frames come round again
+	retiredImages.push_back({ texture->imageView, texture->image, VK_NULL_HANDLE });
+	texture->residentMip = level;
+	stream.nextRow = 0;
+	createTextureImageView(texture);
+
+	return true;
+}
+
+void VulkanRenderer::updateTextureDescriptors(uint32_t imageIndex) {
+	std::vector<VkDescriptorImageInfo> imageInfos(TEXTURES_USED);
+	std::vector<VkWriteDescriptorSet> descriptorWrites;
+
+	for (uint32_t j = 0; j < TEXTURES_USED; j++) {
+		VkImageView view = textureArray[j] != nullptr ? textureArray[j]->imageView : placeholderTexture->imageView;
+
+		if (descriptorSetViews[imageIndex][j] == view) {
+			continue;
+		}
+
+		imageInfos[j].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfos[j].imageView = view;
+		imageInfos[j].sampler = textureSampler;
+
+		VkWriteDescriptorSet descriptorWrite = {};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = descriptorSets[imageIndex];
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.dstArrayElement = j;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfos[j];
+		descriptorWrites.push_back(descriptorWrite);
+
+		descriptorSetViews[imageIndex][j] = view;
+	}
+
+	if (!descriptorWrites.empty()) {
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+
+	destroyRetiredImages();
+}
+
+void VulkanRenderer::destroyRetiredImages() {
+	/* a set is only rewritten once the fence for its last submit has been waited on,
+		so when no set points at a view any more nothing on the gpu can be using it either*/
+	auto isBound = [this](VkImageView view) {
+		for (const auto& views : descriptorSetViews) {
+			if (std::find(views.begin(), views.end(), view) != views.end()) {
+				return true;
+			}
+		}
+
+		return false;
+	};
+
+	//an evicted image can still be bound through an older view from before its last level streamed in
+	std::set<VkImage> boundImages;
+	for (const auto& retired : retiredImages) {
+		if (isBound(retired.view)) {
+			boundImages.insert(retired.image);
+		}
+	}
+
+	retiredImages.erase(std::remove_if(retiredImages.begin(), retiredImages.end(), [&](const RetiredImage& retired) {
+		if (isBound(retired.view) || (retired.memory != VK_NULL_HANDLE && boundImages.count(retired.image) != 0)) {
+			return false;
+		}
+
+		vkDestroyImageView(device, retired.view, nullptr);
+
+		if (retired.memory != VK_NULL_HANDLE) {
+			vkDestroyImage(device, retired.image, nullptr);
+			vkFreeMemory(device, retired.memory, nullptr);
+		}
+
+		return true;
+	}), retiredImages.end());
+}
+
+void VulkanRenderer::flushStagingCopies(VkImage image, std::vector<VkBufferImageCopy>& regions) {
+	if (!regions.empty()) {
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+		vkCmdCopyBufferToImage(
+			commandBuffer,
+			stagingRing.buffer,
+			image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(regions.size()),
+			regions.data()
+		);
+
+		endSingleTimeCommands(commandBuffer);
+		regions.clear();
+	}
+
+	//endSingleTimeCommands waits for the queue, so nothing is reading the ring any more
+	stagingRing.head = 0;
+}
+
+void VulkanRenderer::createPlaceholderTexture() {
+	//what evicted textures are bound as until they are back, a single mid grey texel
+	std::vector<unsigned char> texel = { 128, 128, 128, 255 };
+	std::vector<MipLevel> levels = { { 0, texel.size(), 1, 1 } };
+
+	placeholderTexture = new Texture;
+	uploadLevels(placeholderTexture, texel.data(), levels, VK_FORMAT_R8G8B8A8_UNORM);
+
+	//not counted against the budget and never evicted
+	placeholderTexture->memorySize = 0;
+	placeholderTexture->lastUsedFrame = 0;
+	placeholderTexture->resident = true;
+}
+
+void VulkanRenderer::updateTextureResidency() {
+	//reloads that have finished decoding go back on the gpu, the descriptor sets pick them up as they are rewritten
+	for (auto pendingReload = pendingReloads.begin(); pendingReload != pendingReloads.end();) {
+		if (pendingReload->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			++pendingReload;
+			continue;
+		}
+
+		uploadTexture(pendingReload->first, pendingReload->second.get());
+		pendingReload = pendingReloads.erase(pendingReload);
+	}
+
+	VkDeviceSize budget;
+	VkDeviceSize usage;
+	queryTextureBudget(budget, usage);
+
+	if (usage <= budget) {
+		return;
+	}
+
+	//least recently drawn first, anything drawn within the grace period is left alone even if that means staying over
+	std::vector<Texture*> candidates;
+	for (uint32_t j = 0; j < TEXTURES_USED; j++) {
+		Texture* texture = textureArray[j];
+
+		if (texture != nullptr && texture->resident && texture->lastUsedFrame + RESIDENCY_GRACE_FRAMES < frameNumber) {
+			candidates.push_back(texture);
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const Texture* a, const Texture* b) {
+		return a->lastUsedFrame < b->lastUsedFrame;
+	});
+
+	VkDeviceSize excess = usage - budget;
+	for (Texture* texture : candidates) {
+		if (excess == 0) {
+			break;
+		}
+
+		excess -= std::min(excess, texture->memorySize);
+		evictTexture(texture);
+	}
+}
+
+void VulkanRenderer::queryTextureBudget(VkDeviceSize& budget, VkDeviceSize& usage) {
+	VkDeviceSize textureBytes = 0;
+	for (uint32_t j = 0; j < TEXTURES_USED; j++) {
+		if (textureArray[j] != nullptr && textureArray[j]->resident) {
+			textureBytes += textureArray[j]->memorySize;
+		}
+	}
+
+	if (textureMemoryBudget != 0) {
+		budget = textureMemoryBudget;
+		usage = textureBytes;
+		return;
+	}
+
+	if (memoryBudgetSupported) {
+		//the driver's numbers cover the whole heap, other allocations and other processes included
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2KHR memProperties = {};
+		memProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+		memProperties.pNext = &budgetProperties;
+
+		getPhysicalDeviceMemoryProperties2(physicalDevice, &memProperties);
+
+		budget = budgetProperties.heapBudget[textureHeapIndex] / 100 * RESIDENCY_BUDGET_PERCENT;
+		usage = budgetProperties.heapUsage[textureHeapIndex];
+		return;
+	}
+
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+	budget = memProperties.memoryHeaps[textureHeapIndex].size / 100 * RESIDENCY_FALLBACK_PERCENT;
+	usage = textureBytes;
+}
+
+void VulkanRenderer::evictTexture(Texture* texture) {
+	//levels still waiting to stream in would be copied into an image that is about to go
+	textureStreams.erase(std::remove_if(textureStreams.begin(), textureStreams.end(), [texture](const TextureStream& stream) {
+		return stream.texture == texture;
+	}), textureStreams.end());
+
+	//frames already recorded can still be sampling it, it goes once every descriptor set has moved to the placeholder
+	retiredImages.push_back({ texture->imageView, texture->image, texture->imageMemory });
+
+	texture->image = VK_NULL_HANDLE;
+	texture->imageMemory = VK_NULL_HANDLE;
+	texture->imageView = placeholderTexture->imageView;
+	texture->resident = false;
+}
+
+void VulkanRenderer::requestTextureReload(Texture* texture) {
+	if (pendingReloads.count(texture) != 0) {
+		return;
+	}
+
+	std::string texturePath = texture->sourcePath;
+	pendingReloads[texture] = workerPool.submit([this, texturePath] {
+		return prepareImage(texturePath);
+	});
+}
+
+
+void VulkanRenderer::createImage(uint32_t width, uint32_t height, uint32_t mipLevels , VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
+	VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, uint32_t arrayLayers) {
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = width;
+	imageInfo.extent.height = height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = mipLevels;
+	imageInfo.arrayLayers = arrayLayers;
+	imageInfo.format = format;
+	imageInfo.tiling = tiling;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = usage;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.samples = numSamples;
+	imageInfo.flags = 0;
+
+	if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create image!");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate image memory");
+	}
+
+	vkBindImageMemory(device, image, imageMemory, 0);
+
+}
+
+VkCommandBuffer VulkanRenderer::beginSingleTimeCommands() {
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = commandPool;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	return commandBuffer;
+}
+
+
+void VulkanRenderer::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
+	vkEndCommandBuffer(commandBuffer);
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	vkQueueWaitIdle(graphicsQueue);
+
+	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+}
+
+
+void VulkanRenderer::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels, uint32_t baseMipLevel) {
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = baseMipLevel;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = 0;
+
+	VkPipelineStageFlags sourceStage;
+	VkPipelineStageFlags destinationStage;
+
+
+
+	if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	}
+	else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	}
+	else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) {
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT
+		| VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		destinationStage =
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;	
+	}
+
+	else {
+		throw std::invalid_argument("unsupported layout transition!");
+	}
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		sourceStage, destinationStage,
+		0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier);
+	endSingleTimeCommands(commandBuffer);
+}
+
+
+void VulkanRenderer::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	VkBufferImageCopy region = {};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = {
+		width,
+		height,
+		1
+	};
+
+	vkCmdCopyBufferToImage(
+		commandBuffer,
+		buffer,
+		image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		1,
+		&region
+	);
+
+	endSingleTimeCommands(commandBuffer);
+}
+
+void VulkanRenderer::createTextureImageView(Texture* texture) {
+	//levels still streaming in are left out of the view, so sampling is clamped to what has arrived
+	texture->imageView = createImageView(texture->image, texture->format, VK_IMAGE_ASPECT_COLOR_BIT, texture->mipLevels - texture->residentMip, texture->residentMip);
+}
+
+
+VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, uint32_t baseMipLevel, uint32_t layerCount) {
+	VkImageViewCreateInfo viewInfo = {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = image;
+	viewInfo.viewType = layerCount > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange.aspectMask = aspectFlags;
+	viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
+	viewInfo.subresourceRange.levelCount = mipLevels;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = layerCount;
+
+	VkImageView imageView;
+	if (vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create image view");
+	}
+
+	return imageView;
+}
+
+void VulkanRenderer::createTextureSampler() {
+
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.anisotropyEnable = VK_TRUE;
+	samplerInfo.maxAnisotropy = 16;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.minLod = 0;
+	//created before any texture is loaded, each image view already limits the levels that can be sampled
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+	samplerInfo.mipLodBias = 0;
+
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create texture sampler!");
+	}
+}
+
+void VulkanRenderer::createDepthResources() {
+	VkFormat depthFormat = findDepthFormat();
+
+	createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL ,VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory, viewCount);
+	depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1, 0, viewCount);
+
+}
+
+VkFormat VulkanRenderer::findDepthFormat() {
+	return findSupportedFormat(
+		{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+	);
+}
+
+VkFormat VulkanRenderer::findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
+	for (VkFormat format : candidates) {
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+
+		if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
+			return format;
+		}
+		else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
+			return format;
+		}
+	}
+
+	throw std::runtime_error("failed to find supported format!");
+}
+
+
+
+void VulkanRenderer::loadSceneFile(const std::string& scenePath) {
+	auto start = std::chrono::high_resolution_clock::now();
+	SceneDescription scene = loadScene(scenePath);
+
+	sceneObjects.clear();
+	sceneObjects.reserve(scene.instances.size());
+
+	for (const SceneInstance& instance : scene.instances) {
+		SceneObject sceneObject;
+		sceneObject.modelPath = scene.meshes[instance.mesh];
+		sceneObject.texturePath = scene.textures[instance.texture];
+		sceneObject.transform.location = glm::vec3(instance.location[0], instance.location[1], instance.location[2]);
+		sceneObject.transform.rotation = glm::vec3(instance.rotation[0], instance.rotation[1], instance.rotation[2]);
+		sceneObject.transform.scale = glm::vec3(instance.scale[0], instance.scale[1], instance.scale[2]);
+		sceneObject.isStatic = (instance.flags & SCENE_INSTANCE_STATIC) != 0;
+		sceneObject.parent = instance.parent;
+
+		if (instance.parent != SCENE_NO_PARENT) {
+			sceneObjects[instance.parent].hasChildren = true;
+		}
+
+		sceneObjects.push_back(sceneObject);
+	}
+
+	sceneFileMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << scenePath << ": " << scene.instances.size() << " instances of " << scene.meshes.size() << " meshes and "
+		<< scene.textures.size() << " textures read in " << sceneFileMilliseconds << " ms" << std::endl;
+}
+
+void VulkanRenderer::loadCameraPoses(const std::string& posesPath) {
+	std::ifstream file;
+	if (posesPath != "-") {
+		file.open(posesPath);
+
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open " + posesPath + "!");
+		}
+	}
+	std::istream& input = posesPath == "-" ? std::cin : file;
+
+	cameraPoses.clear();
+
+	std::string line;
+	uint32_t lineNumber = 0;
+	while (std::getline(input, line)) {
+		lineNumber++;
+
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) {
+			line.resize(comment);
+		}
+
+		std::istringstream values(line);
+		std::vector<float> numbers;
+		float number;
+		while (values >> number) {
+			numbers.push_back(number);
+		}
+
+		if (!values.eof()) {
+			throw std::runtime_error(posesPath + ":" + std::to_string(lineNumber) + " has something other than numbers in it!");
+		}
+		if (numbers.empty()) {
+			continue;
+		}
+		if (numbers.size() != 6 && numbers.size() != 7 && numbers.size() != 10) {
+			throw std::runtime_error(posesPath + ":" + std::to_string(lineNumber) + " should be <eye x y z> <target x y z> [fov [up x y z]]!");
+		}
+
+		Camera pose = camera;
+		pose.eye = glm::vec3(numbers[0], numbers[1], numbers[2]);
+		pose.target = glm::vec3(numbers[3], numbers[4], numbers[5]);
+		if (numbers.size() >= 7) {
+			pose.fieldOfView = numbers[6];
+		}
+		if (numbers.size() == 10) {
+			pose.up = glm::vec3(numbers[7], numbers[8], numbers[9]);
+		}
+
+		cameraPoses.push_back(pose);
+	}
+
+	if (cameraPoses.empty()) {
+		throw std::runtime_error(posesPath + " has no camera poses in it!");
+	}
+
+	//one offscreen frame per pose, each one drawn in full rather than streamed in over the first few
+	headless = true;
+	headlessFrames = cameraPoses.size();
+	useTextureStreaming = false;
+}
+
+//static objects are all merged up front, the others are placed SCENE_INSTANCES_PER_FRAME at a time by drawFrame after the first lot
+void VulkanRenderer::loadModels() {
+	if (useStaticBatching) {
+		loadStaticBatches();
+	}
+
+	//a batch's first view has to have the whole scene in it
+	instantiateSceneObjects(cameraPoses.empty() ? SCENE_STARTUP_INSTANCES : sceneObjects.size());
+}
+
+bool VulkanRenderer::isBatched(const SceneObject& sceneObject) const {
+	return useStaticBatching && sceneObject.isStatic && sceneObject.parent == SCENE_NO_PARENT && !sceneObject.hasChildren;
+}
+
+void VulkanRenderer::instantiateSceneObjects(size_t count) {
+	size_t placed = 0;
+
+	sceneObjectModels.resize(sceneObjects.size());
+
+	while (nextSceneObject < sceneObjects.size() && placed < count) {
+		size_t index = nextSceneObject++;
+		const SceneObject& sceneObject = sceneObjects[index];
+
+		if (isBatched(sceneObject)) {
+			continue;
+		}
+
+		ModelHandle model = addModel(acquireMesh(sceneObject.modelPath), acquireTexture(sceneObject.texturePath), sceneObject.transform, sceneObject.isStatic, sceneObject.modelPath);
+		//parents come first in the list, so they have always been placed
+		if (sceneObject.parent != SCENE_NO_PARENT) {
+			setModelParent(model, sceneObjectModels[sceneObject.parent]);
+		}
+
+		sceneObjectModels[index] = model;
+		placed++;
+	}
+
+	if (nextSceneObject == sceneObjects.size() && !sceneInstantiated) {
+		sceneInstantiated = true;
+
+		double total = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startupStart).count();
+		std::cout << "scene: " << sceneObjects.size() << " objects as " << models.size() << " models, all placed "
+			<< total << " ms after startup" << std::endl;
+	}
+}
+
+/* the geometry of every static object is put through its transform and appended to the chunk for its texture and cell,
+	each chunk then goes through the same processing as an obj and becomes one model with an identity transform*/
+void VulkanRenderer::loadStaticBatches() {
+	//one decoded copy of each mesh the static objects use, the gpu copies in the cache cannot be merged
+	std::unordered_map<uint64_t, MeshData> sources;
+	std::map<std::tuple<std::string, int, int, int>, std::vector<const SceneObject*>> chunks;
+
+	for (const auto& sceneObject : sceneObjects) {
+		if (!isBatched(sceneObject)) {
+			continue;
+		}
+
+		uint64_t hash = assetContentHash(sceneObject.modelPath);
+		if (sources.count(hash) == 0) {
+			sources[hash] = takeDecodedMesh(assetHashOwner(hash));
+		}
+		dropDecodedAsset(sceneObject.modelPath);
+
+		const MeshData& source = sources[hash];
+		uint32_t triangleCount = 0;
+		for (const IndexRange& range : source.lods[0].indexRanges) {
+			triangleCount += range.indexCount / 3;
+		}
+
+		if (triangleCount > STATIC_BATCH_MAX_TRIANGLES) {
+			addModel(acquireMesh(hash, source, sceneObject.modelPath), acquireTexture(sceneObject.texturePath), sceneObject.transform, true, sceneObject.modelPath);
+			continue;
+		}
+
+		glm::vec3 center = glm::vec3(transformMatrix(sceneObject.transform, true, 0.0f) * glm::vec4(source.boundsCenter, 1.0f));
+		glm::ivec3 cell = glm::ivec3(glm::floor(center / STATIC_BATCH_CELL_SIZE));
+
+		chunks[std::make_tuple(sceneObject.texturePath, cell.x, cell.y, cell.z)].push_back(&sceneObject);
+	}
+
+	for (const auto& chunk : chunks) {
+		const std::string& texturePath = std::get<0>(chunk.first);
+		const std::vector<const SceneObject*>& objects = chunk.second;
+
+		MeshData merged;
+
+		for (const SceneObject* sceneObject : objects) {
+			const MeshData& source = sources[assetContentHash(sceneObject->modelPath)];
+			glm::mat4 matrix = transformMatrix(sceneObject->transform, true, 0.0f);
+			//a mirroring transform turns the triangles inside out, swapping two corners turns them back
+			bool mirrored = glm::determinant(glm::mat3(matrix)) < 0.0f;
+
+			size_t firstIndex = merged.indicies.size();
+			std::vector<uint32_t> remap(source.verticies.size(), ~0u);
+			for (const IndexRange& range : source.lods[0].indexRanges) {
+				for (uint32_t i = range.firstIndex; i < range.firstIndex + range.indexCount; i++) {
+					uint32_t vertex = range.firstVertex + source.indicies[i];
+
+					if (remap[vertex] == ~0u) {
+						Vertex transformed = source.verticies[vertex];
+						transformed.pos = glm::vec3(matrix * glm::vec4(transformed.pos, 1.0f));
+
+						remap[vertex] = static_cast<uint32_t>(merged.verticies.size());
+						merged.verticies.push_back(transformed);
+					}
+
+					merged.indicies.push_back(remap[vertex]);
+				}
+			}
+
+			if (mirrored) {
+				for (size_t t = firstIndex; t + 2 < merged.indicies.size(); t += 3) {
+					std::swap(merged.indicies[t + 1], merged.indicies[t + 2]);
+				}
+			}
+		}
+
+		processMesh(merged, meshImport, &workerPool);
+
+		//chunks are not files, the hash of what they hold keeps identical chunks shared like identical objs
+		uint64_t hash = hashBytes(reinterpret_cast<const unsigned char*>(merged.verticies.data()), sizeof(Vertex) * merged.verticies.size());
+		hash = (hash * 1099511628211ull) ^ hashBytes(reinterpret_cast<const unsigned char*>(merged.indicies.data()), sizeof(uint32_t) * merged.indicies.size());
+
+		std::string name = "static batch of " + std::to_string(objects.size()) + " with " + texturePath;
+		addModel(acquireMesh(hash, merged, name), acquireTexture(texturePath), { glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(1.0f) }, true, name);
+	}
+}
+
+void VulkanRenderer::startAssetDecoding() {
+	for (const auto& sceneObject : sceneObjects) {
+		const std::string modelPath = sceneObject.modelPath;
+		const std::string texturePath = sceneObject.texturePath;
+
+		if (pendingMeshes.count(modelPath) == 0) {
+			pendingMeshes[modelPath] = workerPool.submit([this, modelPath] {
+				auto start = std::chrono::high_resolution_clock::now();
+
+				//the same obj under another path, that one is parsed instead
+				if (!claimAssetHash(modelPath, hashFileContents(modelPath))) {
+					return MeshData();
+				}
+
+				MeshData meshData = parseModel(modelPath, meshImport, &workerPool);
+				recordAssetTiming(modelPath, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+				return meshData;
+			});
+		}
+
+		if (pendingImages.count(texturePath) == 0) {
+			pendingImages[texturePath] = workerPool.submit([this, texturePath] {
+				auto start = std::chrono::high_resolution_clock::now();
+
+				if (!claimAssetHash(texturePath, hashFileContents(texturePath))) {
+					return ImageData();
+				}
+
+				ImageData imageData = prepareImage(texturePath);
+				recordAssetTiming(texturePath, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+				return imageData;
+			});
+		}
+	}
+}
+
+VulkanRenderer::MeshData VulkanRenderer::takeDecodedMesh(const std::string& modelPath) {
+	auto pending = pendingMeshes.find(modelPath);
+
+	//not part of the startup set, parse it here
+	if (pending == pendingMeshes.end()) {
+		return parseModel(modelPath, meshImport, &workerPool);
+	}
+
+	MeshData meshData = pending->second.get();
+	pendingMeshes.erase(pending);
+	return meshData;
+}
+
+VulkanRenderer::ImageData VulkanRenderer::takeDecodedImage(const std::string& texturePath) {
+	auto pending = pendingImages.find(texturePath);
+
+	if (pending == pendingImages.end()) {
+		return prepareImage(texturePath);
+	}
+
+	ImageData imageData = pending->second.get();
+	pendingImages.erase(pending);
+	return imageData;
+}
+
+void VulkanRenderer::recordAssetTiming(const std::string& name, double milliseconds) {
+	std::lock_guard<std::mutex> lock(assetTimingsMutex);
+	assetTimings.push_back({ name, milliseconds });
+}
+
+void VulkanRenderer::markStartupPhase(const std::string& name) {
+	auto now = std::chrono::high_resolution_clock::now();
+	startupPhases.push_back({ name, std::chrono::duration<double, std::milli>(now - lastStartupMark).count() });
+	lastStartupMark = now;
+}
+
+void VulkanRenderer::printStartupReport() {
+	double total = std::chrono::duration<double, std::milli>(lastStartupMark - startupStart).count();
+	std::cout << "time to first frame: " << total << " ms" << std::endl;
+
+	for (const auto& phase : startupPhases) {
+		std::cout << "\t" << phase.first << ": " << phase.second << " ms" << std::endl;
+	}
+
+	//these ran on the worker threads so they overlap the phases above
+	std::lock_guard<std::mutex> lock(assetTimingsMutex);
+	std::cout << "\tdecoded on " << workerPool.size() << " worker threads:" << std::endl;
+	for (const auto& asset : assetTimings) {
+		std::cout << "\t\t" << asset.first << ": " << asset.second << " ms" << std::endl;
+	}
+}
+
+VulkanRenderer::Mesh* VulkanRenderer::acquireMesh(const std::string& modelPath) {
+	uint64_t hash = assetContentHash(modelPath);
+
+	auto cached = meshCache.find(hash);
+	if (cached != meshCache.end()) {
+		dropDecodedAsset(modelPath);
+
+		cached->second->references++;
+		return cached->second;
+	}
+
+	//parsed under whichever path with these contents was seen first
+	MeshData meshData = takeDecodedMesh(assetHashOwner(hash));
+	dropDecodedAsset(modelPath);
+
+	return acquireMesh(hash, meshData, modelPath);
+}
+
+//shares the cached mesh with this hash, or uploads meshData as it
+VulkanRenderer::Mesh* VulkanRenderer::acquireMesh(uint64_t hash, const MeshData& meshData, const std::string& name) {
+	auto cached = meshCache.find(hash);
+	if (cached != meshCache.end()) {
+		cached->second->references++;
+		return cached->second;
+	}
+
+	std::cout << name << ": acmr " << meshData.cacheStatsBefore.acmr << " -> " << meshData.cacheStatsAfter.acmr
+		<< ", atvr " << meshData.cacheStatsBefore.atvr << " -> " << meshData.cacheStatsAfter.atvr << std::endl;
+	std::cout << name << ": " << (meshData.indexType == VK_INDEX_TYPE_UINT16 ? 16 : 32) << " bit indices, lods";
+	for (const MeshLod& lod : meshData.lods) {
+		uint32_t lodIndicies = 0;
+		for (const IndexRange& range : lod.indexRanges) {
+			lodIndicies += range.indexCount;
+		}
+
+		std::cout << " " << lodIndicies / 3 << " (error " << lod.error << ", " << lod.indexRanges.size() << " draws)";
+	}
+	std::cout << ", " << meshData.meshlets.size() << " meshlets";
+	if (meshData.bvh) {
+		std::cout << ", bvh of " << meshData.bvh->nodeCount() << " nodes";
+	}
+	std::cout << std::endl;
+
+	Mesh* mesh = new Mesh;
+	mesh->indexType = meshData.indexType;
+	mesh->lods = meshData.lods;
+	mesh->boundsCenter = meshData.boundsCenter;
+	mesh->boundsRadius = meshData.boundsRadius;
+	mesh->meshlets = meshData.meshlets;
+	mesh->meshletOffset = ~0u;
+	mesh->bvh = meshData.bvh;
+
+	mesh->indiciesCount = 0;
+	for (const IndexRange& range : meshData.lods[0].indexRanges) {
+		mesh->indiciesCount += range.indexCount;
+	}
+	mesh->contentHash = hash;
+	mesh->references = 1;
+
+	mesh->layout = meshData.layout;
+	mesh->dequantize = meshData.dequantize;
+
+	//the float vertices are still there, a mesh that quantized worse than it should keeps drawing from them
+	if (meshData.layout != VertexLayout::Float && (meshData.positionError > meshData.positionErrorBound || meshData.texCoordError > meshData.texCoordErrorBound)) {
+		std::cout << "quantizing " << name << " lost more than its error bound (position " << meshData.positionError << " of " << meshData.positionErrorBound
+			<< ", uv " << meshData.texCoordError << " of " << meshData.texCoordErrorBound << "), it stays float" << std::endl;
+		mesh->layout = VertexLayout::Float;
+		mesh->dequantize = glm::mat4(1.0f);
+	}
+
+	if (mesh->layout == VertexLayout::Float) {
+		createVertexBuffer(meshData.verticies.data(), sizeof(Vertex) * meshData.verticies.size(), mesh->vertexBuffer, mesh->vertexBufferMemory);
+	}
+	else {
+		createVertexBuffer(meshData.packedVerticies.data(), sizeof(PackedVertex) * meshData.packedVerticies.size(), mesh->vertexBuffer, mesh->vertexBufferMemory);
+	}
+	createIndexBuffer(meshData.indicies, meshData.indexType, mesh->indexBuffer, mesh->indexBufferMemory);
+
+	meshCache[hash] = mesh;
+	return mesh;
+}
+
+//the buffers are destroyed straight away, so the last release has to come after the frames using them are done
+void VulkanRenderer::releaseMesh(Mesh* mesh) {
+	if (--mesh->references > 0) {
+		return;
+	}
+
+	vkDestroyBuffer(device, mesh->vertexBuffer, nullptr);
+	vkFreeMemory(device, mesh->vertexBufferMemory, nullptr);
+
+	vkDestroyBuffer(device, mesh->indexBuffer, nullptr);
+	vkFreeMemory(device, mesh->indexBufferMemory, nullptr);
+
+	meshCache.erase(mesh->contentHash);
+	delete mesh;
+}
+
+//returns the slot in textureArray, which is what the shader indexes with
+uint32_t VulkanRenderer::acquireTexture(const std::string& texturePath) {
+	uint64_t hash = assetContentHash(texturePath);
+
+	auto cached = textureCache.find(hash);
+	if (cached != textureCache.end()) {
+		dropDecodedAsset(texturePath);
+
+		cached->second->references++;
+
+		for (uint32_t j = 0; j < TEXTURES_USED; j++) {
+			if (textureArray[j] == cached->second) {
+				return j;
+			}
+		}
+
+		throw std::runtime_error("cached texture is not in textureArray!");
+	}
+
+	uint32_t index = 0;
+	while (index < TEXTURES_USED && textureArray[index] != nullptr) {
+		index++;
+	}
+
+	if (index == TEXTURES_USED) {
+		throw std::runtime_error("scene uses more textures than TEXTURES_USED!");
+	}
+
+	//loaded from the path that was decoded, a reload after eviction uses it too
+	Texture* texture = loadTexture(assetHashOwner(hash));
+	dropDecodedAsset(texturePath);
+
+	texture->contentHash = hash;
+	texture->references = 1;
+
+	textureArray[index] = texture;
+	textureCache[hash] = texture;
+	return index;
+}
+
+void VulkanRenderer::releaseTexture(uint32_t index) {
+	Texture* texture = textureArray[index];
+
+	if (--texture->references > 0) {
+		return;
+	}
+
+	//frames in flight can still be sampling it, eviction already hands the image over to be destroyed once they are done
+	if (texture->resident) {
+		evictTexture(texture);
+	}
+
+	auto pendingReload = pendingReloads.find(texture);
+	if (pendingReload != pendingReloads.end()) {
+		stbi_image_free(pendingReload->second.get().pixels);
+		pendingReloads.erase(pendingReload);
+	}
+
+	textureCache.erase(texture->contentHash);
+	textureArray[index] = nullptr;
+	delete texture;
+}
+
+//startup assets are hashed on the workers before they are decoded, anything else is hashed here
+uint64_t VulkanRenderer::assetContentHash(const std::string& path) {
+	auto pendingMesh = pendingMeshes.find(path);
+	if (pendingMesh != pendingMeshes.end()) {
+		pendingMesh->second.wait();
+	}
+
+	auto pendingImage = pendingImages.find(path);
+	if (pendingImage != pendingImages.end()) {
+		pendingImage->second.wait();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(assetHashesMutex);
+
+		auto known = assetPathHashes.find(path);
+		if (known != assetPathHashes.end()) {
+			return known->second;
+		}
+	}
+
+	uint64_t hash = hashFileContents(path);
+	claimAssetHash(path, hash);
+	return hash;
+}
+
+//false when another path already has these contents, the caller should leave decoding them to that path
+bool VulkanRenderer::claimAssetHash(const std::string& path, uint64_t hash) {
+	std::lock_guard<std::mutex> lock(assetHashesMutex);
+
+	assetPathHashes[path] = hash;
+	return assetHashOwners.emplace(hash, path).second;
+}
+
+std::string VulkanRenderer::assetHashOwner(uint64_t hash) {
+	std::lock_guard<std::mutex> lock(assetHashesMutex);
+
+	return assetHashOwners.at(hash);
+}
+
+//a path whose contents were decoded under another path only has an empty result waiting, and a path already taken has nothing
+void VulkanRenderer::dropDecodedAsset(const std::string& path) {
+	auto pendingMesh = pendingMeshes.find(path);
+	if (pendingMesh != pendingMeshes.end()) {
+		pendingMesh->second.get();
+		pendingMeshes.erase(pendingMesh);
+	}
+
+	auto pendingImage = pendingImages.find(path);
+	if (pendingImage != pendingImages.end()) {
+		stbi_image_free(pendingImage->second.get().pixels);
+		pendingImages.erase(pendingImage);
+	}
+}
+
+void VulkanRenderer::setModelTransform(ModelHandle handle, Transform transform) {
+	uint32_t m = modelIndex(handle);
+	models.transforms[m] = transform;
+	modelTransformChanged(m);
+}
+
+void VulkanRenderer::setModelLocation(ModelHandle handle, glm::vec3 location) {
+	uint32_t m = modelIndex(handle);
+	models.transforms[m].location = location;
+	modelTransformChanged(m);
+}
+void VulkanRenderer::setModelRotation(ModelHandle handle, glm::vec3 rotation) {
+	uint32_t m = modelIndex(handle);
+	models.transforms[m].rotation = rotation;
+	modelTransformChanged(m);
+}
+void VulkanRenderer::setModelScale(ModelHandle handle, glm::vec3 scale) {
+	uint32_t m = modelIndex(handle);
+	models.transforms[m].scale = scale;
+	modelTransformChanged(m);
+}
+
+//the model's own bounds move straight away, the models under it wait for the next updateHierarchy
+void VulkanRenderer::modelTransformChanged(uint32_t model) {
+	updateModelBounds(model);
+
+	if (models.firstChildren[model] != ~0u) {
+		markModelDirty(model);
+	}
+}
+
+void VulkanRenderer::setModelParent(ModelHandle handle, std::optional<ModelHandle> parent) {
+	uint32_t m = modelIndex(handle);
+	uint32_t newParent = ~0u;
+
+	if (parent) {
+		modelIndex(*parent);
+
+		//going up from the new parent must never come back to the model
+		for (uint32_t ancestor = parent->slot; ancestor != ~0u; ancestor = models.parents[models.slotIndices[ancestor]]) {
+			if (ancestor == handle.slot) {
+				throw std::runtime_error("a model cannot be attached under itself!");
+			}
+		}
+		newParent = parent->slot;
+	}
+
+	uint32_t oldParent = models.parents[m];
+	if (oldParent == newParent) {
+		return;
+	}
+
+	if (oldParent != ~0u) {
+		uint32_t o = models.slotIndices[oldParent];
+
+		uint32_t* link = &models.firstChildren[o];
+		while (*link != handle.slot) {
+			link = &models.nextSiblings[models.slotIndices[*link]];
+		}
+		*link = models.nextSiblings[m];
+		models.nextSiblings[m] = ~0u;
+
+		if (models.firstChildren[o] == ~0u) {
+			auto& animated = models.animatedParents;
+			animated.erase(std::remove(animated.begin(), animated.end(), oldParent), animated.end());
+		}
+	}
+
+	models.parents[m] = newParent;
+
+	if (newParent != ~0u) {
+		uint32_t p = models.slotIndices[newParent];
+
+		if (models.firstChildren[p] == ~0u && !models.isStatic[p]) {
+			models.animatedParents.push_back(newParent);
+		}
+		models.nextSiblings[m] = models.firstChildren[p];
+		models.firstChildren[p] = handle.slot;
+
+		//going through the parent's subtree places this one as well
+		markModelDirty(p);
+	}
+	else {
+		models.parentWorlds[m] = glm::mat4(1.0f);
+		modelTransformChanged(m);
+	}
+}
+
+void VulkanRenderer::markModelDirty(uint32_t model) {
+	if (!models.dirty[model]) {
+		models.dirty[model] = 1;
+		models.dirtyModels.push_back(models.slots[model]);
+	}
+}
+
+/* brings parentWorlds up to date under every model that moved or spins, and nowhere else. a dirty model under another
+	is left to the pass of the one above it, so the subtrees gone through never overlap and are shared out over the pool*/
+void VulkanRenderer::updateHierarchy(float time) {
+	for (uint32_t slot : models.animatedParents) {
+		markModelDirty(models.slotIndices[slot]);
+	}
+
+	if (models.dirtyModels.empty()) {
+		return;
+	}
+
+	hierarchyOrder.clear();
+	hierarchyStarts.clear();
+
+	for (uint32_t slot : models.dirtyModels) {
+		uint32_t root = models.slotIndices[slot];
+
+		bool covered = false;
+		for (uint32_t ancestor = models.parents[root]; ancestor != ~0u && !covered; ancestor = models.parents[models.slotIndices[ancestor]]) {
+			covered = models.dirty[models.slotIndices[ancestor]] != 0;
+		}
+		if (covered) {
+			continue;
+		}
+
+		hierarchyStarts.push_back(hierarchyOrder.size());
+		hierarchyOrder.push_back(root);
+
+		for (size_t next = hierarchyStarts.back(); next < hierarchyOrder.size(); next++) {
+			for (uint32_t child = models.firstChildren[hierarchyOrder[next]]; child != ~0u; child = models.nextSiblings[models.slotIndices[child]]) {
+				hierarchyOrder.push_back(models.slotIndices[child]);
+			}
+		}
+	}
+	hierarchyStarts.push_back(hierarchyOrder.size());
+
+	size_t subtreeCount = hierarchyStarts.size() - 1;
+	workerPool.parallelFor(subtreeCount, 16, [&](size_t begin, size_t end) {
+		for (size_t i = hierarchyStarts[begin]; i < hierarchyStarts[end]; i++) {
+			uint32_t m = hierarchyOrder[i];
+			if (models.firstChildren[m] == ~0u) {
+				continue;
+			}
+
+			glm::mat4 world = models.parentWorlds[m] * transformMatrix(models.transforms[m], models.isStatic[m] != 0, time);
+			for (uint32_t child = models.firstChildren[m]; child != ~0u; child = models.nextSiblings[models.slotIndices[child]]) {
+				models.parentWorlds[models.slotIndices[child]] = world;
+			}
+		}
+	});
+
+	//the grid cannot be written from several threads, and the roots of the subtrees have not moved
+	for (size_t s = 0; s < subtreeCount; s++) {
+		for (size_t i = hierarchyStarts[s] + 1; i < hierarchyStarts[s + 1]; i++) {
+			updateModelBounds(hierarchyOrder[i]);
+		}
+	}
+
+	for (uint32_t slot : models.dirtyModels) {
+		models.dirty[models.slotIndices[slot]] = 0;
+	}
+	models.dirtyModels.clear();
+}
+
+//takes over the references to the mesh and the texture
+VulkanRenderer::ModelHandle VulkanRenderer::addModel(Mesh* mesh, uint32_t textureIndex, const Transform& transform, bool isStatic, const std::string& name) {
+	uint32_t slot;
+	if (!models.freeSlots.empty()) {
+		slot = models.freeSlots.back();
+		models.freeSlots.pop_back();
+	}
+	else {
+		slot = static_cast<uint32_t>(models.slotIndices.size());
+		models.slotIndices.push_back(~0u);
+		models.slotGenerations.push_back(0);
+	}
+
+	uint32_t m = static_cast<uint32_t>(models.size());
+	models.slotIndices[slot] = m;
+	models.slots.push_back(slot);
+
+	models.transforms.push_back(transform);
+	models.isStatic.push_back(isStatic ? 1 : 0);
+	models.meshes.push_back(mesh);
+	models.textureIndices.push_back(textureIndex);
+	models.mvps.push_back({ glm::mat4(1.0f), glm::mat4(1.0f), glm::mat4(1.0f) });
+	models.lods.push_back(0);
+	models.drawCommandOffsets.push_back(~0u);
+	models.spatialHandles.push_back(spatialGrid.insert(glm::vec3(0.0f), 0.0f, slot));
+	models.names.push_back(name);
+	models.parents.push_back(~0u);
+	models.firstChildren.push_back(~0u);
+	models.nextSiblings.push_back(~0u);
+	models.parentWorlds.push_back(glm::mat4(1.0f));
+	models.dirty.push_back(0);
+
+	updateModelBounds(m);
+	meshletCullingOutOfDate = true;
+
+	return { slot, models.slotGenerations[slot] };
+}
+
+//the last model is moved into the gap, so every array stays packed and only its slot has to be pointed at the new place
+void VulkanRenderer::removeModel(ModelHandle handle) {
+	//the models attached to it go with it
+	uint32_t m = modelIndex(handle);
+	while (models.firstChildren[m] != ~0u) {
+		uint32_t child = models.firstChildren[m];
+		removeModel({ child, models.slotGenerations[child] });
+		m = modelIndex(handle);
+	}
+
+	setModelParent(handle, std::nullopt);
+	if (models.dirty[m]) {
+		auto& dirtyModels = models.dirtyModels;
+		dirtyModels.erase(std::remove(dirtyModels.begin(), dirtyModels.end(), handle.slot), dirtyModels.end());
+	}
+
+	uint32_t last = static_cast<uint32_t>(models.size() - 1);
+
+	releaseMesh(models.meshes[m]);
+	releaseTexture(models.textureIndices[m]);
+	spatialGrid.remove(models.spatialHandles[m]);
+
+	auto fill = [m, last](auto& array) {
+		if (m != last) {
+			array[m] = std::move(array[last]);
+		}
+		array.pop_back();
+	};
+
+	fill(models.transforms);
+	fill(models.isStatic);
+	fill(models.meshes);
+	fill(models.textureIndices);
+	fill(models.mvps);
+	fill(models.lods);
+	fill(models.drawCommandOffsets);
+	fill(models.spatialHandles);
+	fill(models.names);
+	fill(models.parents);
+	fill(models.firstChildren);
+	fill(models.nextSiblings);
+	fill(models.parentWorlds);
+	fill(models.dirty);
+	fill(models.slots);
+
+	if (m != last) {
+		models.slotIndices[models.slots[m]] = m;
+	}
+	models.slotIndices[handle.slot] = ~0u;
+	models.slotGenerations[handle.slot]++;
+	models.freeSlots.push_back(handle.slot);
+
+	//places have changed, so anything numbered by them is out of date
+	visibleModels.clear();
+	sceneBvh = SceneBvh();
+	meshletCullingOutOfDate = true;
+}
+
+uint32_t VulkanRenderer::modelIndex(ModelHandle handle) const {
+	if (handle.slot >= models.slotGenerations.size() || models.slotGenerations[handle.slot] != handle.generation) {
+		throw std::runtime_error("model handle is out of date!");
+	}
+
+	return models.slotIndices[handle.slot];
+}
+
+/* the models spin about z through their location, so the bounds are a sphere on that axis holding every
+	turn of the mesh's own sphere. it only changes when the transform or the parent's does, not as the model spins*/
+void VulkanRenderer::updateModelBounds(uint32_t model) {
+	const Mesh* mesh = models.meshes[model];
+	const Transform& transform = models.transforms[model];
+
+	glm::vec3 scales = glm::abs(transform.scale);
+	float scale = std::max(scales.x, std::max(scales.y, scales.z));
+	glm::vec3 center = transform.scale * mesh->boundsCenter;
+	float radius = glm::length(glm::vec2(center.x, center.y)) + mesh->boundsRadius * scale;
+
+	//the parent's frame can be scaled as well, by at most its longest axis
+	const glm::mat4& parentWorld = models.parentWorlds[model];
+	float parentScale = std::max(glm::length(glm::vec3(parentWorld[0])), std::max(glm::length(glm::vec3(parentWorld[1])), glm::length(glm::vec3(parentWorld[2]))));
+	glm::vec3 location = glm::vec3(parentWorld * glm::vec4(transform.location + glm::vec3(0.0f, 0.0f, center.z), 1.0f));
+
+	spatialGrid.move(models.spatialHandles[model], location, radius * parentScale);
+}
+
+VulkanRenderer::MeshData VulkanRenderer::parseModel(const std::string& modelPath, const MeshImportOptions& options, ThreadPool* pool) {
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn, err;
+
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, modelPath.c_str())) {
+		throw std::runtime_error(warn + err);
+	}
+
+	std::unordered_map<Vertex, uint32_t> uniqueVertices = {};
+
+	MeshData meshData;
+	std::vector<Vertex>& verticies = meshData.verticies;
+	std::vector<uint32_t>& indicies = meshData.indicies;
+
+	for (const auto& shape : shapes) {
+		for (const auto& index : shape.mesh.indices) {
+			Vertex vertex = {};
+
+			vertex.pos = {
+				attrib.vertices[3 * index.vertex_index + 0],
+				attrib.vertices[3 * index.vertex_index + 1],
+				attrib.vertices[3 * index.vertex_index + 2]
+			};
+
+			vertex.texCoord = {
+				attrib.texcoords[2 * index.texcoord_index + 0],
+				1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+			};
+
+			if (uniqueVertices.count(vertex) == 0) {
+				uniqueVertices[vertex] = static_cast<uint32_t>(verticies.size());
+				verticies.push_back(vertex);
+			}
+
+			indicies.push_back(uniqueVertices[vertex]);
+		}
+	}
+
+	processMesh(meshData, options, pool);
+
+	return meshData;
+}
+
+//everything done to a mesh between reading its triangles and uploading them, static batches go through it too
+void VulkanRenderer::processMesh(MeshData& meshData, const MeshImportOptions& options, ThreadPool* pool) {
+	std::vector<Vertex>& verticies = meshData.verticies;
+	std::vector<uint32_t>& indicies = meshData.indicies;
+
+	meshData.cacheStatsBefore = analyzeVertexCache(indicies, verticies.size());
+
+	if (options.optimize) {
+		optimizeMesh(meshData);
+	}
+
+	meshData.cacheStatsAfter = analyzeVertexCache(indicies, verticies.size());
+
+	glm::vec3 boundsMin = verticies.empty() ? glm::vec3(0.0f) : verticies[0].pos;
+	glm::vec3 boundsMax = boundsMin;
+	for (const auto& vertex : verticies) {
+		boundsMin = glm::min(boundsMin, vertex.pos);
+		boundsMax = glm::max(boundsMax, vertex.pos);
+	}
+
+	meshData.boundsCenter = (boundsMin + boundsMax) * 0.5f;
+	meshData.boundsRadius = 0.0f;
+	for (const auto& vertex : verticies) {
+		meshData.boundsRadius = std::max(meshData.boundsRadius, glm::length(vertex.pos - meshData.boundsCenter));
+	}
+
+	meshData.lods = { { { { 0, static_cast<uint32_t>(indicies.size()), 0 } }, 0.0f } };
+
+	//before the lods are added to the indices and anything is split or quantized, so it is the full mesh in the obj's space
+	if (options.buildBvh && !indicies.empty()) {
+		meshData.bvh = std::make_shared<MeshBvh>(indicies.data(), indicies.size(), &verticies[0].pos.x, sizeof(Vertex), pool);
+	}
+
+	if (options.generateLods) {
+		generateLods(meshData, options.optimize);
+	}
+
+	meshData.indexType = VK_INDEX_TYPE_UINT32;
+
+	if (verticies.size() <= SHORT_INDEX_VERTEX_LIMIT) {
+		meshData.indexType = VK_INDEX_TYPE_UINT16;
+	}
+	else if (options.split) {
+		splitMesh(meshData);
+	}
+
+	if (options.buildMeshlets) {
+		uint32_t triangleCount = 0;
+		for (const IndexRange& range : meshData.lods[0].indexRanges) {
+			triangleCount += range.indexCount / 3;
+		}
+
+		if (triangleCount >= MESHLET_MIN_TRIANGLES) {
+			for (const IndexRange& range : meshData.lods[0].indexRanges) {
+				std::vector<Meshlet> meshlets = buildMeshlets(indicies, range, &verticies[0].pos.x, sizeof(Vertex));
+				meshData.meshlets.insert(meshData.meshlets.end(), meshlets.begin(), meshlets.end());
+			}
+		}
+	}
+
+	meshData.layout = VertexLayout::Float;
+	meshData.dequantize = glm::mat4(1.0f);
+
+	if (options.quantize) {
+		quantizeMesh(meshData);
+	}
+}
+
+/* the ranges follow the draw order, so the reordering done before only loses a little at each cut. the full detail level is
+	split first, then a triangle of a simplified level goes in the first of its ranges that already has all three of its vertices.
+	only the triangles no range has room for get copies of their own*/
+void VulkanRenderer::splitMesh(MeshData& meshData) {
+	size_t sourceCount = meshData.verticies.size();
+	std::vector<Vertex> verticies;
+	std::vector<uint32_t> vertexSources;
+
+	MeshLod& full = meshData.lods[0];
+	uint32_t fullFirstIndex = full.indexRanges[0].firstIndex;
+	auto fullBegin = meshData.indicies.begin() + fullFirstIndex;
+	std::vector<uint32_t> fullIndicies(fullBegin, fullBegin + full.indexRanges[0].indexCount);
+
+	full.indexRanges = splitIndexRanges(fullIndicies, sourceCount, vertexSources);
+	std::copy(fullIndicies.begin(), fullIndicies.end(), fullBegin);
+
+	for (IndexRange& range : full.indexRanges) {
+		range.firstIndex += fullFirstIndex;
+	}
+	for (uint32_t source : vertexSources) {
+		verticies.push_back(meshData.verticies[source]);
+	}
+
+	//every copy of each old vertex in order, one on a cut has a copy in each range using it
+	std::vector<uint32_t> copyStarts(sourceCount + 1, 0);
+	for (uint32_t source : vertexSources) {
+		copyStarts[source + 1]++;
+	}
+	for (size_t source = 0; source < sourceCount; source++) {
+		copyStarts[source + 1] += copyStarts[source];
+	}
+
+	std::vector<uint32_t> copies(vertexSources.size());
+	std::vector<uint32_t> cursors(copyStarts.begin(), copyStarts.end() - 1);
+	for (uint32_t vertex = 0; vertex < vertexSources.size(); vertex++) {
+		copies[cursors[vertexSources[vertex]]++] = vertex;
+	}
+
+	const std::vector<IndexRange>& fullRanges = full.indexRanges;
+	std::vector<uint32_t> rangeEnds(fullRanges.size());
+	for (size_t range = 0; range < fullRanges.size(); range++) {
+		rangeEnds[range] = range + 1 < fullRanges.size() ? fullRanges[range + 1].firstVertex : static_cast<uint32_t>(vertexSources.size());
+	}
+
+	//the place of the old vertex within the range, ~0u when the range has no copy of it
+	auto localCopy = [&](uint32_t source, size_t range) {
+		for (uint32_t copy = copyStarts[source]; copy < copyStarts[source + 1]; copy++) {
+			if (copies[copy] >= fullRanges[range].firstVertex && copies[copy] < rangeEnds[range]) {
+				return copies[copy] - fullRanges[range].firstVertex;
+			}
+		}
+
+		return ~0u;
+	};
+
+	for (size_t l = 1; l < meshData.lods.size(); l++) {
+		MeshLod& lod = meshData.lods[l];
+		uint32_t firstIndex = lod.indexRanges[0].firstIndex;
+		uint32_t indexCount = lod.indexRanges[0].indexCount;
+		auto begin = meshData.indicies.begin() + firstIndex;
+
+		std::vector<std::vector<uint32_t>> shared(fullRanges.size());
+		std::vector<uint32_t> leftover;
+
+		for (uint32_t triangle = 0; triangle + 2 < indexCount; triangle += 3) {
+			const uint32_t* corners = &begin[triangle];
+			bool placed = false;
+
+			for (uint32_t copy = copyStarts[corners[0]]; copy < copyStarts[corners[0] + 1] && !placed; copy++) {
+				size_t range = std::upper_bound(rangeEnds.begin(), rangeEnds.end(), copies[copy]) - rangeEnds.begin();
+				uint32_t second = localCopy(corners[1], range);
+				uint32_t third = localCopy(corners[2], range);
+
+				if (second != ~0u && third != ~0u) {
+					shared[range].insert(shared[range].end(), { copies[copy] - fullRanges[range].firstVertex, second, third });
+					placed = true;
+				}
+			}
+
+			if (!placed) {
+				leftover.insert(leftover.end(), corners, corners + 3);
+			}
+		}
+
+		lod.indexRanges.clear();
+		uint32_t written = 0;
+
+		for (size_t range = 0; range < fullRanges.size(); range++) {
+			if (shared[range].empty()) {
+				continue;
+			}
+
+			lod.indexRanges.push_back({ firstIndex + written, static_cast<uint32_t>(shared[range].size()), fullRanges[range].firstVertex });
+			std::copy(shared[range].begin(), shared[range].end(), begin + written);
+			written += static_cast<uint32_t>(shared[range].size());
+		}
+
+		if (!leftover.empty() || lod.indexRanges.empty()) {
+			for (IndexRange range : splitIndexRanges(leftover, sourceCount, vertexSources)) {
+				range.firstIndex += firstIndex + written;
+				range.firstVertex += static_cast<uint32_t>(verticies.size());
+				lod.indexRanges.push_back(range);
+			}
+			std::copy(leftover.begin(), leftover.end(), begin + written);
+
+			for (uint32_t source : vertexSources) {
+				verticies.push_back(meshData.verticies[source]);
+			}
+		}
+	}
+
+	meshData.indexType = VK_INDEX_TYPE_UINT16;
+	meshData.verticies.swap(verticies);
+}
+
+void VulkanRenderer::quantizeMesh(MeshData& meshData) {
+	const std::vector<Vertex>& verticies = meshData.verticies;
+
+	if (verticies.empty()) {
+		return;
+	}
+
+	glm::vec3 boundsMin = verticies[0].pos;
+	glm::vec3 boundsMax = verticies[0].pos;
+	bool texCoordsInUnitRange = true;
+
+	for (const auto& vertex : verticies) {
+		boundsMin = glm::min(boundsMin, vertex.pos);
+		boundsMax = glm::max(boundsMax, vertex.pos);
+
+		if (vertex.texCoord.x < 0.0f || vertex.texCoord.x > 1.0f || vertex.texCoord.y < 0.0f || vertex.texCoord.y > 1.0f) {
+			texCoordsInUnitRange = false;
+		}
+	}
+
+	//a flat axis still needs something to divide by, every position on it quantizes to 0
+	glm::vec3 extent = boundsMax - boundsMin;
+	for (int axis = 0; axis < 3; axis++) {
+		if (extent[axis] <= 0.0f) {
+			extent[axis] = 1.0f;
+		}
+	}
+
+	meshData.layout = texCoordsInUnitRange ? VertexLayout::QuantizedUnormUv : VertexLayout::QuantizedHalfUv;
+	meshData.dequantize = glm::scale(glm::translate(glm::mat4(1.0f), boundsMin), extent);
+	meshData.packedVerticies.resize(verticies.size());
+
+	meshData.positionError = 0.0f;
+	meshData.texCoordError = 0.0f;
+	float largestTexCoord = 0.0f;
+
+	for (size_t i = 0; i < verticies.size(); i++) {
+		const Vertex& vertex = verticies[i];
+		PackedVertex& packed = meshData.packedVerticies[i];
+
+		glm::vec3 restored;
+		for (int axis = 0; axis < 3; axis++) {
+			packed.pos[axis] = quantizeUnorm16((vertex.pos[axis] - boundsMin[axis]) / extent[axis]);
+			restored[axis] = boundsMin[axis] + packed.pos[axis] / 65535.0f * extent[axis];
+		}
+		packed.pos[3] = 0;
+
+		glm::vec2 restoredTexCoord;
+		for (int axis = 0; axis < 2; axis++) {
+			if (texCoordsInUnitRange) {
+				packed.texCoord[axis] = quantizeUnorm16(vertex.texCoord[axis]);
+				restoredTexCoord[axis] = packed.texCoord[axis] / 65535.0f;
+			}
+			else {
+				packed.texCoord[axis] = quantizeHalf(vertex.texCoord[axis]);
+				restoredTexCoord[axis] = dequantizeHalf(packed.texCoord[axis]);
+			}
+
+			largestTexCoord = std::max(largestTexCoord, std::abs(vertex.texCoord[axis]));
+		}
+
+		meshData.positionError = std::max(meshData.positionError, glm::length(restored - vertex.pos));
+		meshData.texCoordError = std::max(meshData.texCoordError, glm::length(restoredTexCoord - vertex.texCoord));
+	}
+
+	float largestPosition = 0.0f;
+	for (int axis = 0; axis < 3; axis++) {
+		largestPosition = std::max(largestPosition, std::max(std::abs(boundsMin[axis]), std::abs(boundsMax[axis])));
+	}
+
+	/* half a step of rounding on each axis, a half float's step at the largest uv is 2^-10 of its power of two.
+		the float maths doing the rounding adds a few epsilons of the values on top*/
+	meshData.positionErrorBound = glm::length(extent) / (2.0f * 65535.0f) + 1e-6f * (largestPosition + glm::length(extent));
+	meshData.texCoordErrorBound = (texCoordsInUnitRange ? std::sqrt(2.0f) / (2.0f * 65535.0f)
+		: std::sqrt(2.0f) * std::exp2(std::floor(std::log2(std::max(largestTexCoord, 1.0f)))) / 2048.0f) + 1e-6f * std::max(largestTexCoord, 1.0f);
+}
+
+//triangle order for the vertex cache, then clusters of it for overdraw, then vertex order for fetching
+void VulkanRenderer::optimizeMesh(MeshData& meshData) {
+	std::vector<Vertex>& verticies = meshData.verticies;
+	std::vector<uint32_t>& indicies = meshData.indicies;
+
+	if (indicies.empty()) {
+		return;
+	}
+
+	std::vector<uint32_t> clusters = optimizeVertexCache(indicies, verticies.size());
+	optimizeOverdraw(indicies, clusters, &verticies[0].pos.x, sizeof(Vertex), verticies.size());
+
+	std::vector<uint32_t> remap = optimizeVertexFetch(indicies, verticies.size());
+
+	std::vector<Vertex> reordered(verticies.size());
+	for (size_t i = 0; i < verticies.size(); i++) {
+		reordered[remap[i]] = verticies[i];
+	}
+
+	verticies.swap(reordered);
+}
+
+//each level is simplified from the one before, so its error is what it adds on top of theirs
+void VulkanRenderer::generateLods(MeshData& meshData, bool optimize) {
+	const std::vector<Vertex>& verticies = meshData.verticies;
+	std::vector<uint32_t>& indicies = meshData.indicies;
+
+	std::vector<uint32_t> previous = indicies;
+	float error = 0.0f;
+
+	while (meshData.lods.size() < MESH_LOD_COUNT && previous.size() / 3 > MESH_LOD_MIN_TRIANGLES) {
+		float levelError = 0.0f;
+		std::vector<uint32_t> simplified = simplifyMesh(previous, &verticies[0].pos.x, sizeof(Vertex), verticies.size(),
+			previous.size() / 2, meshData.boundsRadius * MESH_LOD_MAX_ERROR, &levelError);
+
+		//seams and borders can stop it well short of the target, a level that barely shrank is not worth keeping
+		if (simplified.size() > previous.size() * 3 / 4) {
+			break;
+		}
+
+		if (optimize) {
+			optimizeVertexCache(simplified, verticies.size());
+		}
+
+		error += levelError;
+		meshData.lods.push_back({ { { static_cast<uint32_t>(indicies.size()), static_cast<uint32_t>(simplified.size()), 0 } }, error });
+		indicies.insert(indicies.end(), simplified.begin(), simplified.end());
+
+		previous.swap(simplified);
+	}
+}
+
+/* queries are numbered by slot, so a model keeps its query while others are placed and removed.
+	the pool grows to twice the slots when they outnumber it, what the frames in flight counted goes with the old one*/
+void VulkanRenderer::updateStatisticsQueryPool() {
+	if (!pipelineStatisticsSupported || models.slotIndices.size() <= statisticsSlotCount) {
+		return;
+	}
+
+	if (statisticsQueryPool != VK_NULL_HANDLE) {
+		vkDeviceWaitIdle(device);
+		vkDestroyQueryPool(device, statisticsQueryPool, nullptr);
+		statisticsQueryPool = VK_NULL_HANDLE;
+	}
+
+	statisticsSlotCount = static_cast<uint32_t>(std::max(models.slotIndices.size(), 2 * static_cast<size_t>(statisticsSlotCount)));
+	statisticsQueried.assign(commandBuffers.size(), {});
+
+	VkQueryPoolCreateInfo queryPoolInfo = {};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+	queryPoolInfo.queryCount = static_cast<uint32_t>(commandBuffers.size()) * statisticsSlotCount;
+	queryPoolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT;
+
+	if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &statisticsQueryPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline statistics query pool!");
+	}
+}
+
+//only the models that were drawn have results, and one removed since then has nothing left to report it under
+void VulkanRenderer::reportVertexInvocations(uint32_t imageIndex) {
+	if (statisticsQueryPool == VK_NULL_HANDLE || vertexInvocationsReported || statisticsQueried[imageIndex].empty()) {
+		return;
+	}
+
+	const std::vector<ModelHandle>& queried = statisticsQueried[imageIndex];
+	std::vector<uint64_t> invocations(queried.size());
+	for (size_t i = 0; i < queried.size(); i++) {
+		VkResult result = vkGetQueryPoolResults(device, statisticsQueryPool, imageIndex * statisticsSlotCount + queried[i].slot, 1,
+			sizeof(uint64_t), &invocations[i], sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+		if (result != VK_SUCCESS) {
+			return;
+		}
+	}
+
+	//with a perfect cache this would be the vertex count, with no cache at all the index count
+	std::cout << "vertex shader invocations in one frame:" << std::endl;
+	for (size_t i = 0; i < queried.size(); i++) {
+		if (models.slotGenerations[queried[i].slot] != queried[i].generation) {
+			continue;
+		}
+
+		uint32_t m = models.slotIndices[queried[i].slot];
+		std::cout << "\t" << models.names[m] << ": " << invocations[i] << " for " << models.meshes[m]->indiciesCount << " indices" << std::endl;
+	}
+
+	vertexInvocationsReported = true;
+}
+
+void VulkanRenderer::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
+	if (canGenerateMipmapsCompute(imageFormat, mipLevels)) {
+		generateMipmapsCompute(image, imageFormat, texWidth, texHeight, mipLevels);
+		return;
+	}
+
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
+
+	if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+		throw std::runtime_error("texture image format does not support linear blitting!");
+	}
+	
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = image;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.subresourceRange.levelCount = 1;
+
+	int32_t mipWidth = texWidth;
+	int32_t mipHeight = texHeight;
+
+	for (uint32_t i = 1; i < mipLevels; i++) {
+		barrier.subresourceRange.baseMipLevel = i - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+
+		VkImageBlit blit = {};
+		blit.srcOffsets[0] = { 0, 0, 0 };
+		blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = i - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = 1;
+		blit.dstOffsets[0] = { 0, 0, 0 };
+		blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = i;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = 1;
+
+		
+		vkCmdBlitImage(commandBuffer,
+			image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit,
+			VK_FILTER_LINEAR);
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+		
+		
+		if (mipWidth > 1) mipWidth /= 2;
+		if (mipHeight > 1) mipHeight /= 2;
+	}
 
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
 	
-	return new_texture;
+	barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier);
+
+	endSingleTimeCommands(commandBuffer);
 }
 
+void VulkanRenderer::createMipGenPipeline() {
+	//without the compute shader every mip the cpu does not build comes from the blit chain
+	std::ifstream shaderFile("shaders/mipgen.spv");
+	if (!shaderFile.is_open()) {
+		std::cout << "shaders/mipgen.spv is missing, mipmaps fall back to blits until shaders/compile.bat is run" << std::endl;
+		return;
+	}
+	shaderFile.close();
 
-void VulkanRenderer::createImage(uint32_t width, uint32_t height, uint32_t mipLevels , VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
-	VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
-	VkImageCreateInfo imageInfo = {};
-	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	imageInfo.imageType = VK_IMAGE_TYPE_2D;
-	imageInfo.extent.width = width;
-	imageInfo.extent.height = height;
-	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = mipLevels;
-	imageInfo.arrayLayers = 1;
-	imageInfo.format = format;
-	imageInfo.tiling = tiling;
-	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageInfo.usage = usage;
-	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	imageInfo.samples = numSamples;
-	imageInfo.flags = 0;
+	//level 0 plus every level it writes are bound at once, which is more storage images than every device allows
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
 
-	if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create image!");
+	if (deviceProperties.limits.maxPerStageDescriptorStorageImages < MIPGEN_MAX_LEVELS + 1) {
+		std::cout << "device binds too few storage images for mipgen.comp, mipmaps fall back to blits" << std::endl;
+		return;
 	}
 
-	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(device, image, &memRequirements);
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-	VkMemoryAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].descriptorCount = MIPGEN_MAX_LEVELS;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-	if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate image memory");
+	bindings[2].binding = 2;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[2].descriptorCount = 1;
+	bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &mipGenSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create mip generation descriptor set layout!");
 	}
 
-	vkBindImageMemory(device, image, imageMemory, 0);
+	//size, level count and group count
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = 4 * sizeof(int32_t);
 
-}
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &mipGenSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-VkCommandBuffer VulkanRenderer::beginSingleTimeCommands() {
-	VkCommandBufferAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = commandPool;
-	allocInfo.commandBufferCount = 1;
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &mipGenPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create mip generation pipeline layout!");
+	}
 
-	VkCommandBuffer commandBuffer;
-	vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+	VkShaderModule computeShaderModule = createShaderModule(readFile("shaders/mipgen.spv"));
 
-	VkCommandBufferBeginInfo beginInfo = {};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = computeShaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = mipGenPipelineLayout;
 
-	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &mipGenPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create mip generation pipeline!");
+	}
 
-	return commandBuffer;
+	vkDestroyShaderModule(device, computeShaderModule, nullptr);
+
+	//textures are generated one at a time, so a few sets is plenty
+	std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[0].descriptorCount = 4 * (MIPGEN_MAX_LEVELS + 1);
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = 4;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = 4;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &mipGenDescriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create mip generation descriptor pool!");
+	}
+
+	//how many groups have finished level 6, the last one puts it back to 0 so it only needs clearing once
+	createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mipGenCounterBuffer, mipGenCounterMemory);
+
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	vkCmdFillBuffer(commandBuffer, mipGenCounterBuffer, 0, sizeof(uint32_t), 0);
+	endSingleTimeCommands(commandBuffer);
 }
 
+void VulkanRenderer::destroyMipGenPipeline() {
+	if (mipGenPipeline == VK_NULL_HANDLE) {
+		return;
+	}
 
-void VulkanRenderer::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-	vkEndCommandBuffer(commandBuffer);
+	vkDestroyBuffer(device, mipGenCounterBuffer, nullptr);
+	vkFreeMemory(device, mipGenCounterMemory, nullptr);
+	vkDestroyDescriptorPool(device, mipGenDescriptorPool, nullptr);
+	vkDestroyPipeline(device, mipGenPipeline, nullptr);
+	vkDestroyPipelineLayout(device, mipGenPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, mipGenSetLayout, nullptr);
+}
 
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
+bool VulkanRenderer::canGenerateMipmapsCompute(VkFormat format, uint32_t mipLevels) {
+	//the shader declares its images as rgba8
+	if (!useComputeMipmaps || mipGenPipeline == VK_NULL_HANDLE || format != VK_FORMAT_R8G8B8A8_UNORM || mipLevels - 1 > MIPGEN_MAX_LEVELS) {
+		return false;
+	}
 
-	vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(graphicsQueue);
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
 
-	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+	return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
 }
 
+//level 0 has to be in transfer dst like it is for the blits, every level ends up shader read only
+void VulkanRenderer::generateMipmapsCompute(VkImage image, VkFormat format, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
+	std::vector<VkImageView> levelViews(mipLevels);
+	for (uint32_t i = 0; i < mipLevels; i++) {
+		levelViews[i] = createImageView(image, format, VK_IMAGE_ASPECT_COLOR_BIT, 1, i);
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = mipGenDescriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &mipGenSetLayout;
+
+	VkDescriptorSet descriptorSet;
+	if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate mip generation descriptor set!");
+	}
+
+	//every slot has to hold something valid, the ones past the last level repeat it and are never written
+	std::vector<VkDescriptorImageInfo> imageInfos(MIPGEN_MAX_LEVELS + 1);
+	for (uint32_t i = 0; i <= MIPGEN_MAX_LEVELS; i++) {
+		imageInfos[i].imageView = levelViews[std::min(i, mipLevels - 1)];
+		imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	}
+
+	VkDescriptorBufferInfo counterInfo = {};
+	counterInfo.buffer = mipGenCounterBuffer;
+	counterInfo.offset = 0;
+	counterInfo.range = sizeof(uint32_t);
+
+	std::array<VkWriteDescriptorSet, 3> descriptorWrites = {};
+	descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[0].dstSet = descriptorSet;
+	descriptorWrites[0].dstBinding = 0;
+	descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	descriptorWrites[0].descriptorCount = 1;
+	descriptorWrites[0].pImageInfo = &imageInfos[0];
+
+	descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[1].dstSet = descriptorSet;
+	descriptorWrites[1].dstBinding = 1;
+	descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	descriptorWrites[1].descriptorCount = MIPGEN_MAX_LEVELS;
+	descriptorWrites[1].pImageInfo = &imageInfos[1];
+
+	descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[2].dstSet = descriptorSet;
+	descriptorWrites[2].dstBinding = 2;
+	descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrites[2].descriptorCount = 1;
+	descriptorWrites[2].pBufferInfo = &counterInfo;
+
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 
-void VulkanRenderer::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
 	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	recordComputeMipmaps(commandBuffer, image, descriptorSet, texWidth, texHeight, mipLevels);
+	endSingleTimeCommands(commandBuffer);
+
+	vkFreeDescriptorSets(device, mipGenDescriptorPool, 1, &descriptorSet);
+	for (VkImageView view : levelViews) {
+		vkDestroyImageView(device, view, nullptr);
+	}
+}
 
+/* one barrier into general, one dispatch for every level, one barrier out. split from the set up so something
+	downsampled every frame can keep its set and views and record just this*/
+void VulkanRenderer::recordComputeMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkDescriptorSet descriptorSet, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
 	VkImageMemoryBarrier barrier = {};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.oldLayout = oldLayout;
-	barrier.newLayout = newLayout;
+	barrier.image = image;
 	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = image;
 	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	barrier.subresourceRange.baseMipLevel = 0;
 	barrier.subresourceRange.levelCount = mipLevels;
 	barrier.subresourceRange.baseArrayLayer = 0;
 	barrier.subresourceRange.layerCount = 1;
-	barrier.srcAccessMask = 0;
-	barrier.dstAccessMask = 0;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-	VkPipelineStageFlags sourceStage;
-	VkPipelineStageFlags destinationStage;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier);
 
+	//every group covers 64x64 texels of level 0
+	uint32_t groupsX = (static_cast<uint32_t>(texWidth) + 63) / 64;
+	uint32_t groupsY = (static_cast<uint32_t>(texHeight) + 63) / 64;
 
+	int32_t pushConstants[4] = { texWidth, texHeight, static_cast<int32_t>(mipLevels) - 1, static_cast<int32_t>(groupsX * groupsY) };
 
-	if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mipGenPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mipGenPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, mipGenPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), pushConstants);
+	vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
 
-		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	//the counter is covered too, the next dispatch reads what the last group reset it to
+	VkMemoryBarrier counterBarrier = {};
+	counterBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	counterBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	counterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+		1, &counterBarrier,
+		0, nullptr,
+		1, &barrier);
+}
+
+/* the pipeline is made once, the buffers by updateMeshletCulling as meshes and models are placed and removed.
+	only the full detail level has meshlets, the simplified ones are small enough to draw whole*/
+void VulkanRenderer::createMeshletCulling() {
+	if (!useMeshletCulling) {
+		return;
 	}
-	else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	//either way every mesh is drawn whole
+	if (!multiDrawIndirectSupported) {
+		std::cout << "device has no multiDrawIndirect, meshlet culling is off" << std::endl;
+		return;
 	}
-	else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) {
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT
-		| VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		destinationStage =
-		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;	
+
+	std::ifstream shaderFile("shaders/cull.spv");
+	if (!shaderFile.is_open()) {
+		std::cout << "shaders/cull.spv is missing, meshlet culling is off until shaders/compile.bat is run" << std::endl;
+		return;
+	}
+	shaderFile.close();
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	maxDrawIndirectCount = deviceProperties.limits.maxDrawIndirectCount;
+
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 	}
 
-	else {
-		throw std::invalid_argument("unsupported layout transition!");
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &cullSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling descriptor set layout!");
 	}
 
-	vkCmdPipelineBarrier(
-		commandBuffer,
-		sourceStage, destinationStage,
-		0,
-		0, nullptr,
-		0, nullptr,
-		1, &barrier);
-	endSingleTimeCommands(commandBuffer);
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(CullParams);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &cullSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling pipeline layout!");
+	}
+
+	VkShaderModule computeShaderModule = createShaderModule(readFile("shaders/cull.spv"));
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = computeShaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = cullPipelineLayout;
+
+	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &cullPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling pipeline!");
+	}
+
+	vkDestroyShaderModule(device, computeShaderModule, nullptr);
+
+	VkDescriptorPoolSize poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = static_cast<uint32_t>(2 * commandBuffers.size());
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = static_cast<uint32_t>(commandBuffers.size());
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &cullDescriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(commandBuffers.size(), cullSetLayout);
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = cullDescriptorPool;
+	allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+	allocInfo.pSetLayouts = layouts.data();
+
+	cullDescriptorSets.resize(commandBuffers.size());
+	if (vkAllocateDescriptorSets(device, &allocInfo, cullDescriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate culling descriptor sets!");
+	}
+
+	//the models loaded at startup
+	updateMeshletCulling();
 }
 
+/* gives the meshes and models placed or removed since the last frame their meshlets and draws. new meshlets go on the end of
+	meshletBuffer, when that or the draw command buffers run out both are made again at twice what is needed, which waits for the frames using them*/
+void VulkanRenderer::updateMeshletCulling() {
+	if (cullPipeline == VK_NULL_HANDLE || !meshletCullingOutOfDate) {
+		return;
+	}
+	meshletCullingOutOfDate = false;
+
+	uint32_t cachedMeshlets = 0;
+	uint32_t newMeshlets = 0;
+	for (auto& cached : meshCache) {
+		Mesh* mesh = cached.second;
 
-void VulkanRenderer::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-	VkBufferImageCopy region = {};
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
+		if (mesh->meshlets.size() > maxDrawIndirectCount) {
+			mesh->meshlets.clear();
+		}
 
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
+		cachedMeshlets += static_cast<uint32_t>(mesh->meshlets.size());
+		if (mesh->meshletOffset == ~0u) {
+			newMeshlets += static_cast<uint32_t>(mesh->meshlets.size());
+		}
+	}
+
+	uint32_t drawCommandCount = 0;
+	for (size_t m = 0; m < models.size(); m++) {
+		models.drawCommandOffsets[m] = drawCommandCount;
+		drawCommandCount += static_cast<uint32_t>(models.meshes[m]->meshlets.size());
+	}
+
+	if (drawCommandCount == 0) {
+		return;
+	}
+
+	if (meshletCount + newMeshlets > meshletCapacity || drawCommandCount > drawCommandCapacity) {
+		vkDeviceWaitIdle(device);
+		destroyMeshletBuffers();
+
+		//every mesh goes in again, which leaves out the meshlets of the ones that have been released
+		for (auto& cached : meshCache) {
+			cached.second->meshletOffset = ~0u;
+		}
+		meshletCount = 0;
+		meshletCapacity = 2 * cachedMeshlets;
+		drawCommandCapacity = 2 * drawCommandCount;
+
+		createMeshletBuffers();
+	}
+
+	std::vector<GpuMeshlet> gpuMeshlets;
+	for (auto& cached : meshCache) {
+		Mesh* mesh = cached.second;
+		if (mesh->meshletOffset != ~0u) {
+			continue;
+		}
+
+		mesh->meshletOffset = meshletCount + static_cast<uint32_t>(gpuMeshlets.size());
+
+		for (const Meshlet& meshlet : mesh->meshlets) {
+			GpuMeshlet gpuMeshlet = {};
+			gpuMeshlet.sphere = glm::vec4(meshlet.center[0], meshlet.center[1], meshlet.center[2], meshlet.radius);
+			gpuMeshlet.cone = glm::vec4(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2], meshlet.coneCutoff);
+			gpuMeshlet.firstIndex = meshlet.firstIndex;
+			gpuMeshlet.indexCount = meshlet.indexCount;
+			gpuMeshlet.vertexOffset = static_cast<int32_t>(meshlet.firstVertex);
+
+			gpuMeshlets.push_back(gpuMeshlet);
+		}
+	}
+
+	if (gpuMeshlets.empty()) {
+		return;
+	}
 
-	region.imageOffset = { 0, 0, 0 };
-	region.imageExtent = {
-		width,
-		height,
-		1
-	};
+	VkDeviceSize uploadSize = sizeof(GpuMeshlet) * gpuMeshlets.size();
 
-	vkCmdCopyBufferToImage(
-		commandBuffer,
-		buffer,
-		image,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		1,
-		&region
-	);
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(uploadSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, uploadSize, 0, &data);
+	memcpy(data, gpuMeshlets.data(), (size_t)uploadSize);
+	vkUnmapMemory(device, stagingBufferMemory);
 
+	//the frames in flight only read the meshlets before these
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	VkBufferCopy copyRegion = {};
+	copyRegion.srcOffset = 0;
+	copyRegion.dstOffset = sizeof(GpuMeshlet) * meshletCount;
+	copyRegion.size = uploadSize;
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer, meshletBuffer, 1, &copyRegion);
 	endSingleTimeCommands(commandBuffer);
-}
 
-void VulkanRenderer::createTextureImageView(Texture* texture) {
-	texture->imageView = createImageView(texture->image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingBufferMemory, nullptr);
+
+	meshletCount += static_cast<uint32_t>(gpuMeshlets.size());
 }
 
+//sized from meshletCapacity and drawCommandCapacity, the sets cover the whole of each
+void VulkanRenderer::createMeshletBuffers() {
+	VkDeviceSize meshletBufferSize = sizeof(GpuMeshlet) * meshletCapacity;
+	createBuffer(meshletBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshletBuffer, meshletBufferMemory);
 
-VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
-	VkImageViewCreateInfo viewInfo = {};
-	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	viewInfo.image = image;
-	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	viewInfo.format = format;
-	viewInfo.subresourceRange.aspectMask = aspectFlags;
-	viewInfo.subresourceRange.baseMipLevel = 0;
-	viewInfo.subresourceRange.levelCount = mipLevels;
-	viewInfo.subresourceRange.baseArrayLayer = 0;
-	viewInfo.subresourceRange.layerCount = 1;
+	VkDeviceSize drawCommandsSize = sizeof(VkDrawIndexedIndirectCommand) * drawCommandCapacity;
+	drawCommandBuffers.resize(commandBuffers.size());
+	drawCommandBufferMemory.resize(commandBuffers.size());
 
-	VkImageView imageView;
-	if (vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create image view");
+	for (size_t i = 0; i < commandBuffers.size(); i++) {
+		createBuffer(drawCommandsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			drawCommandBuffers[i], drawCommandBufferMemory[i]);
 	}
 
-	return imageView;
-}
-
-void VulkanRenderer::createTextureSampler() {
-
-	VkSamplerCreateInfo samplerInfo = {};
-	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerInfo.magFilter = VK_FILTER_LINEAR;
-	samplerInfo.minFilter = VK_FILTER_LINEAR;
-	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.anisotropyEnable = VK_TRUE;
-	samplerInfo.maxAnisotropy = 16;
-	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-	samplerInfo.unnormalizedCoordinates = VK_FALSE;
-	samplerInfo.compareEnable = VK_FALSE;
-	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	samplerInfo.minLod = 0;
-	samplerInfo.maxLod = static_cast<float>(mipLevels);
-	samplerInfo.mipLodBias = 0;
+	for (size_t i = 0; i < commandBuffers.size(); i++) {
+		std::array<VkDescriptorBufferInfo, 2> bufferInfos = {};
+		bufferInfos[0].buffer = meshletBuffer;
+		bufferInfos[0].offset = 0;
+		bufferInfos[0].range = meshletBufferSize;
+		bufferInfos[1].buffer = drawCommandBuffers[i];
+		bufferInfos[1].offset = 0;
+		bufferInfos[1].range = drawCommandsSize;
+
+		std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
+		for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+			descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[binding].dstSet = cullDescriptorSets[i];
+			descriptorWrites[binding].dstBinding = binding;
+			descriptorWrites[binding].dstArrayElement = 0;
+			descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[binding].descriptorCount = 1;
+			descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+		}
 
-	if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create texture sampler!");
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 	}
 }
 
-void VulkanRenderer::createDepthResources() {
-	VkFormat depthFormat = findDepthFormat();
+void VulkanRenderer::destroyMeshletBuffers() {
+	if (meshletBuffer == VK_NULL_HANDLE) {
+		return;
+	}
 
-	createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL ,VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
-	depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+	for (size_t i = 0; i < drawCommandBuffers.size(); i++) {
+		vkDestroyBuffer(device, drawCommandBuffers[i], nullptr);
+		vkFreeMemory(device, drawCommandBufferMemory[i], nullptr);
+	}
+	drawCommandBuffers.clear();
+	drawCommandBufferMemory.clear();
 
+	vkDestroyBuffer(device, meshletBuffer, nullptr);
+	vkFreeMemory(device, meshletBufferMemory, nullptr);
+	meshletBuffer = VK_NULL_HANDLE;
 }
 
-VkFormat VulkanRenderer::findDepthFormat() {
-	return findSupportedFormat(
-		{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
-		VK_IMAGE_TILING_OPTIMAL,
-		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
-	);
+void VulkanRenderer::destroyMeshletCulling() {
+	if (cullPipeline == VK_NULL_HANDLE) {
+		return;
+	}
+
+	destroyMeshletBuffers();
+	vkDestroyDescriptorPool(device, cullDescriptorPool, nullptr);
+	vkDestroyPipeline(device, cullPipeline, nullptr);
+	vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, cullSetLayout, nullptr);
+	cullPipeline = VK_NULL_HANDLE;
 }
 
-VkFormat VulkanRenderer::findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
-	for (VkFormat format : candidates) {
-		VkFormatProperties props;
-		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+bool VulkanRenderer::usesMeshletCulling(uint32_t model) {
+	const Mesh* mesh = models.meshes[model];
+	return cullPipeline != VK_NULL_HANDLE && models.lods[model] == 0 && !mesh->meshlets.empty()
+		&& mesh->meshletOffset != ~0u && models.drawCommandOffsets[model] != ~0u;
+}
 
-		if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
-			return format;
-		}
-		else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
-			return format;
-		}
+//has to be recorded after updateModels has picked the lods and before the render pass
+void VulkanRenderer::recordMeshletCulling(int imageIndex) {
+	if (cullPipeline == VK_NULL_HANDLE) {
+		return;
 	}
 
-	throw std::runtime_error("failed to find supported format!");
-}
+	VkCommandBuffer commandBuffer = commandBuffers[imageIndex];
+	bool dispatched = false;
 
+	for (uint32_t m : visibleModels) {
+		if (!usesMeshletCulling(m)) {
+			continue;
+		}
 
+		if (!dispatched) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullDescriptorSets[imageIndex], 0, nullptr);
+			dispatched = true;
+		}
 
-void VulkanRenderer::loadModels() {
-	Model* tireModel = loadModel("models/tire.obj");
-	Transform tireTransform = { glm::vec3(2.5f,0.0f,0.0f), glm::vec3(60.0f,0.0f,0.0f), glm::vec3(0.05f,0.05f,0.05f) };
-	setModelTransform(tireModel, tireTransform);
-	textureArray[0] = loadTexture("textures/Tire_Red_Color.png");
-	tireModel->texture_index = 0;
-	modelsArray.push_back(tireModel);
-	
-	Model* cryptoModel = loadModel("models/crypto.obj");
-	Transform cryptoTransform = { glm::vec3(0.0f,0.0f,0.0f), glm::vec3(60.0f,0.0f,0.0f), glm::vec3(0.04f,0.04f,0.04f) };
-	setModelTransform(cryptoModel, cryptoTransform);
-	textureArray[1] = loadTexture("textures/crypto.png");
-	cryptoModel->texture_index = 1;
-	modelsArray.push_back(cryptoModel);
+		const Mesh* mesh = models.meshes[m];
+		const constantBufferMVP& mvp = models.mvps[m];
 
-	Model* earthModel = loadModel("models/earth.obj");
-	Transform earthTransform = { glm::vec3(-2.5f,0.0f,0.0f), glm::vec3(60.0f,0.0f,0.0f), glm::vec3(0.2f,0.2f,0.2f) };
-	setModelTransform(earthModel, earthTransform);
-	textureArray[2] = loadTexture("textures/earth_night.png");
-	earthModel->texture_index = 2;
-	modelsArray.push_back(earthModel);
+		//the meshlet bounds are from before quantization, which mvp.model already has folded in
+		glm::mat4 world = mvp.model * glm::inverse(mesh->dequantize);
+		glm::mat4 clip = mvp.proj * mvp.view * world;
 
+		//frustum planes are sums and differences of the rows, depth goes from 0 to 1
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++) {
+			rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+		}
 
-}
+		CullParams params = {};
+		params.planes[0] = rows[3] + rows[0];
+		params.planes[1] = rows[3] - rows[0];
+		params.planes[2] = rows[3] + rows[1];
+		params.planes[3] = rows[3] - rows[1];
+		params.planes[4] = rows[2];
+		params.planes[5] = rows[3] - rows[2];
 
-void VulkanRenderer::freeModel(Model* model) {
-	if (model != nullptr) {
-		vkDestroyBuffer(device, model->vertexBuffer, nullptr);
-		vkFreeMemory(device, model->vertexBufferMemory, nullptr);
+		for (auto& plane : params.planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
 
-		vkDestroyBuffer(device, model->indexBuffer, nullptr);
-		vkFreeMemory(device, model->indexBufferMemory, nullptr);
+		params.eye = glm::inverse(mvp.view * world) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		params.meshletOffset = mesh->meshletOffset;
+		params.meshletCount = static_cast<uint32_t>(mesh->meshlets.size());
+		params.commandOffset = models.drawCommandOffsets[m];
 
-		delete model;
+		vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullParams), &params);
+		vkCmdDispatch(commandBuffer, (params.meshletCount + 63) / 64, 1, 1);
 	}
-}
 
-void VulkanRenderer::freeTexture(uint32_t index) {
-	if (textureArray[index] != nullptr) {
-		vkDestroyImage(device, textureArray[index]->image, nullptr);
-		vkFreeMemory(device, textureArray[index]->imageMemory, nullptr);
-		vkDestroyImageView(device, textureArray[index]->imageView, nullptr);
-		delete textureArray[index];
+	if (!dispatched) {
+		return;
 	}
-}
 
-void VulkanRenderer::setModelTransform(Model* model, Transform transform) {
-	setModelLocation(model, transform.location);
-	setModelRotation(model, transform.rotation);
-	setModelScale(model, transform.scale);
-}
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
 
-void VulkanRenderer::setModelLocation(Model* model, glm::vec3 location) {
-	model->transform.location = location;
-}
-void VulkanRenderer::setModelRotation(Model* model, glm::vec3 rotation) {
-	model->transform.rotation = rotation;
-}
-void VulkanRenderer::setModelScale(Model* model, glm::vec3 scale) {
-	model->transform.scale = scale;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
 }
 
-VulkanRenderer::Model* VulkanRenderer::loadModel(std::string modelPath) {
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string warn, err;
+void VulkanRenderer::createFrameReadback() {
+	if (captureDirectory.empty() && streamPath.empty()) {
+		return;
+	}
 
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, modelPath.c_str())) {
-		throw std::runtime_error(warn + err);
+	if (!captureDirectory.empty() && !streamPath.empty()) {
+		throw std::runtime_error("frames can be captured to files or streamed, not both!");
 	}
 
-	std::unordered_map<Vertex, uint32_t> uniqueVertices = {};
+	bool bgra = swapChainImageFormat == VK_FORMAT_B8G8R8A8_UNORM || swapChainImageFormat == VK_FORMAT_B8G8R8A8_SRGB;
+	bool rgba = swapChainImageFormat == VK_FORMAT_R8G8B8A8_UNORM || swapChainImageFormat == VK_FORMAT_R8G8B8A8_SRGB;
+	if (!bgra && !rgba) {
+		throw std::runtime_error("frames can only be captured from an 8 bit rgba or bgra swap chain!");
+	}
 
-	std::vector<Vertex> verticies;
-	std::vector<uint32_t> indicies;
+	if (!captureDirectory.empty()) {
+		std::filesystem::create_directories(captureDirectory);
+	}
+	//stays open when the ring is rebuilt for a new swap chain
+	else if (streamFile == nullptr) {
+		openFrameStream(bgra);
+	}
 
-	for (const auto& shape : shapes) {
-		for (const auto& index : shape.mesh.indices) {
-			Vertex vertex = {};
+	//the cpu reads every byte of these, cached memory is much quicker for that when the device has it
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
 
-			vertex.pos = {
-				attrib.vertices[3 * index.vertex_index + 0],
-				attrib.vertices[3 * index.vertex_index + 1],
-				attrib.vertices[3 * index.vertex_index + 2]
-			};
+	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		if ((memProperties.memoryTypes[i].propertyFlags & (properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) == (properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) {
+			properties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+			break;
+		}
+	}
 
-			vertex.texCoord = {
-				attrib.texcoords[2 * index.texcoord_index + 0],
-				1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-			};
+	//every view's layer one after the other
+	VkDeviceSize size = static_cast<VkDeviceSize>(swapChainExtent.width) * swapChainExtent.height * 4 * viewCount;
 
-			if (uniqueVertices.count(vertex) == 0) {
-				uniqueVertices[vertex] = static_cast<uint32_t>(verticies.size());
-				verticies.push_back(vertex);
-			}
+	readbackSlots.resize(READBACK_RING_SIZE);
+	for (ReadbackSlot& slot : readbackSlots) {
+		createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, slot.buffer, slot.memory);
 
-			indicies.push_back(uniqueVertices[vertex]);
+		//stays mapped, the encoders read straight out of it
+		void* data;
+		vkMapMemory(device, slot.memory, 0, size, 0, &data);
+		slot.mapped = static_cast<unsigned char*>(data);
+		slot.copying = false;
+	}
+
+	nextReadbackSlot = 0;
+}
+
+/* a fifo, a named pipe or stdout all take plain writes. nothing is buffered on the way, each frame goes
+	from the mapped readback memory to the pipe in one fwrite, so the encoder reading it sets the pace*/
+void VulkanRenderer::openFrameStream(bool bgra) {
+	if (streamPath == "-") {
+#ifdef _WIN32
+		//text mode would turn every 0x0a byte into two
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		streamFile = stdout;
+	}
+	else {
+		streamFile = fopen(streamPath.c_str(), "wb");
+
+		if (streamFile == nullptr) {
+			throw std::runtime_error("failed to open " + streamPath + " to stream frames to!");
 		}
 	}
 
-	Model* new_model = new Model;
-	new_model->indiciesCount = indicies.size();
+	setvbuf(streamFile, nullptr, _IONBF, 0);
+	streamWriter = std::make_unique<ThreadPool>(1);
 
-	createVertexBuffer(verticies, new_model->vertexBuffer, new_model->vertexBufferMemory);
-	createIndexBuffer(indicies, new_model->indexBuffer, new_model->indexBufferMemory);
-	return new_model;
+	//views of a multiview frame are one after the other, so they come out stacked top to bottom
+	std::cerr << "streaming " << swapChainExtent.width << "x" << swapChainExtent.height * viewCount << " " << (bgra ? "bgra" : "rgba")
+		<< " frames, e.g. ffmpeg -f rawvideo -pix_fmt " << (bgra ? "bgra" : "rgba") << " -s " << swapChainExtent.width << "x"
+		<< swapChainExtent.height * viewCount << " -r 60 -i " << (streamPath == "-" ? "-" : streamPath) << " out.mp4" << std::endl;
 }
 
-void VulkanRenderer::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
-	
-	VkFormatProperties formatProperties;
-	vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
+void VulkanRenderer::destroyFrameReadback() {
+	for (ReadbackSlot& slot : readbackSlots) {
+		vkUnmapMemory(device, slot.memory);
+		vkDestroyBuffer(device, slot.buffer, nullptr);
+		vkFreeMemory(device, slot.memory, nullptr);
+	}
 
-	if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-		throw std::runtime_error("texture image format does not support linear blitting!");
+	readbackSlots.clear();
+}
+
+//after the render pass, copies the resolved image into the next slot of the ring
+void VulkanRenderer::recordFrameReadback(int imageIndex) {
+	if (readbackSlots.empty()) {
+		return;
 	}
-	
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+	//only waits when the encoders are a whole ring behind, never on the gpu
+	ReadbackSlot& slot = readbackSlots[nextReadbackSlot];
+	if (dropFramesWhenBehind && slot.encoding.valid() && slot.encoding.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+		droppedFrames++;
+		return;
+	}
+	nextReadbackSlot = (nextReadbackSlot + 1) % readbackSlots.size();
+
+	if (slot.copying) {
+		throw std::runtime_error("readback slot reused before its copy was collected!");
+	}
+	if (slot.encoding.valid()) {
+		slot.encoding.get();
+	}
+
+	slot.frame = frameNumber;
+	slot.frameInFlight = currentFrame;
+	slot.copying = true;
+
+	VkCommandBuffer commandBuffer = commandBuffers[imageIndex];
+
+	//the render pass leaves the image ready to present, or to be copied from when headless
+	VkImageLayout finalLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 	VkImageMemoryBarrier barrier = {};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.image = image;
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barrier.oldLayout = finalLayout;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = swapChainImages[imageIndex];
 	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
+	barrier.subresourceRange.baseMipLevel = 0;
 	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = viewCount;
 
-	int32_t mipWidth = texWidth;
-	int32_t mipHeight = texHeight;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
 
-	for (uint32_t i = 1; i < mipLevels; i++) {
-		barrier.subresourceRange.baseMipLevel = i - 1;
-		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	VkBufferImageCopy region = {};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = viewCount;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { swapChainExtent.width, swapChainExtent.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffer, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+	VkBufferMemoryBarrier bufferBarrier = {};
+	bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = slot.buffer;
+	bufferBarrier.offset = 0;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+
+	//a swap chain image goes back to being presentable, the present waits on the semaphore so no stage has to wait here
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barrier.dstAccessMask = 0;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.newLayout = finalLayout;
 
-		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-			0, nullptr,
-			0, nullptr,
-			1, &barrier);
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+		0, nullptr, 1, &bufferBarrier, 1, &barrier);
+}
 
-		VkImageBlit blit = {};
-		blit.srcOffsets[0] = { 0, 0, 0 };
-		blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
-		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		blit.srcSubresource.mipLevel = i - 1;
-		blit.srcSubresource.baseArrayLayer = 0;
-		blit.srcSubresource.layerCount = 1;
-		blit.dstOffsets[0] = { 0, 0, 0 };
-		blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
-		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		blit.dstSubresource.mipLevel = i;
-		blit.dstSubresource.baseArrayLayer = 0;
-		blit.dstSubresource.layerCount = 1;
+//called once the fence of frameInFlight has been waited on, so every copy recorded in it has landed
+void VulkanRenderer::collectFrameReadback(size_t frameInFlight) {
+	bool bgra = swapChainImageFormat == VK_FORMAT_B8G8R8A8_UNORM || swapChainImageFormat == VK_FORMAT_B8G8R8A8_SRGB;
+	uint32_t width = swapChainExtent.width;
+	uint32_t height = swapChainExtent.height;
 
-		
-		vkCmdBlitImage(commandBuffer,
-			image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1, &blit,
-			VK_FILTER_LINEAR);
+	for (ReadbackSlot& slot : readbackSlots) {
+		if (!slot.copying || slot.frameInFlight != frameInFlight) {
+			continue;
+		}
 
-		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		slot.copying = false;
 
-		vkCmdPipelineBarrier(commandBuffer,
-			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-			0, nullptr,
-			0, nullptr,
-			1, &barrier);
-		
-		
-		if (mipWidth > 1) mipWidth /= 2;
-		if (mipHeight > 1) mipHeight /= 2;
+		if (streamFile != nullptr) {
+			FILE* file = streamFile;
+			const unsigned char* pixels = slot.mapped;
+			size_t size = static_cast<size_t>(width) * height * 4 * viewCount;
+
+			slot.encoding = streamWriter->submit([file, pixels, size] {
+				if (fwrite(pixels, 1, size, file) != size) {
+					throw std::runtime_error("failed to write a frame to the stream, has the encoder stopped?");
+				}
+			});
+			continue;
+		}
+
+		//a multiview frame is written as one file per view
+		std::vector<std::string> paths;
+		for (uint32_t v = 0; v < viewCount; v++) {
+			char name[48];
+			if (viewCount > 1) {
+				snprintf(name, sizeof(name), "frame_%06llu_view%u.%s", static_cast<unsigned long long>(slot.frame), v, captureRaw ? "rgba" : "png");
+			}
+			else {
+				snprintf(name, sizeof(name), "frame_%06llu.%s", static_cast<unsigned long long>(slot.frame), captureRaw ? "rgba" : "png");
+			}
+			paths.push_back((std::filesystem::path(captureDirectory) / name).string());
+		}
+
+		unsigned char* pixels = slot.mapped;
+		bool raw = captureRaw;
+
+		slot.encoding = workerPool.submit([pixels, width, height, bgra, raw, paths] {
+			size_t pixelCount = static_cast<size_t>(width) * height;
+
+			for (size_t v = 0; v < paths.size(); v++) {
+				unsigned char* view = pixels + pixelCount * 4 * v;
+				const std::string& path = paths[v];
+
+				//swizzled in place, nothing else touches the slot until this is done
+				if (bgra) {
+					for (size_t i = 0; i < pixelCount; i++) {
+						std::swap(view[i * 4 + 0], view[i * 4 + 2]);
+					}
+				}
+
+				if (raw) {
+					std::ofstream file(path, std::ios::binary);
+					if (!file.is_open()) {
+						throw std::runtime_error("failed to create " + path + "!");
+					}
+					file.write(reinterpret_cast<const char*>(view), pixelCount * 4);
+				}
+				else if (!stbi_write_png(path.c_str(), width, height, 4, view, width * 4)) {
+					throw std::runtime_error("failed to write " + path + "!");
+				}
+			}
+		});
 	}
+}
 
-	
-	barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+//waits for every copy and every encode still going, rethrowing anything an encoder failed with
+void VulkanRenderer::finishFrameReadback() {
+	vkDeviceWaitIdle(device);
 
-	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-		0, nullptr,
-		0, nullptr,
-		1, &barrier);
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		collectFrameReadback(i);
+	}
 
-	endSingleTimeCommands(commandBuffer);
+	for (ReadbackSlot& slot : readbackSlots) {
+		if (slot.encoding.valid()) {
+			slot.encoding.get();
+		}
+	}
+
+	if (droppedFrames > 0) {
+		std::cout << "readback fell behind and left out " << droppedFrames << " frames" << std::endl;
+		droppedFrames = 0;
+	}
 }
 
 VkSampleCountFlagBits VulkanRenderer::getMaxUsableSampleCount() {
@@ -1815,6 +5222,6 @@ void VulkanRenderer::createColorResources() {
 
 	createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, colorFormat, 
 				VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImage, colorImageMemory);
-	colorImageView = createImageView(colorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImage, colorImageMemory, viewCount);
+	colorImageView = createImageView(colorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1, 0, viewCount);
 }
\ No newline at end of file
@@ -6,6 +6,45 @@
 #define GLM_ENABLE_EXPERIMENTAL
 
 #define TEXTURES_USED 3
+//host visible memory every texture upload is copied through, bigger levels are split into bands of rows
+#define STAGING_RING_SIZE (64 * 1024 * 1024)
+//levels this size and smaller are uploaded before a texture is first used, the rest stream in afterwards
+#define STREAMING_RESIDENT_SIZE 128
+//how much texture data each frame copies in while streaming
+#define STREAMING_BYTES_PER_FRAME (4 * 1024 * 1024)
+//most levels mipgen.comp builds under level 0 in one dispatch, enough for a 4096 texture
+#define MIPGEN_MAX_LEVELS 12
+//textures drawn within this many frames are never evicted, so one is not thrown out and straight back in
+#define RESIDENCY_GRACE_FRAMES 60
+//share of the driver's heap budget that can be used before textures start being evicted
+#define RESIDENCY_BUDGET_PERCENT 90
+//without VK_EXT_memory_budget nothing else in the heap can be seen, so textures get a fixed share of it
+#define RESIDENCY_FALLBACK_PERCENT 50
+//most detail levels a mesh gets, the full mesh included, each one aims for half the triangles of the one before
+#define MESH_LOD_COUNT 5
+//meshes and levels this small are not simplified any further
+#define MESH_LOD_MIN_TRIANGLES 256
+//no level may move the surface further than this share of the mesh's bounding radius
+#define MESH_LOD_MAX_ERROR 0.05f
+//an instance draws the coarsest level whose error covers at most this many pixels on screen
+#define MESH_LOD_PIXEL_ERROR 1.0f
+//meshes with fewer triangles than this are drawn whole, culling their meshlets would cost more than it saves
+#define MESHLET_MIN_TRIANGLES 4096
+//static objects are merged per texture within cubes of this size, so each merged chunk can still be culled and lodded
+#define STATIC_BATCH_CELL_SIZE 8.0f
+//static objects with more triangles than this are already worth their own draw and are placed on their own
+#define STATIC_BATCH_MAX_TRIANGLES 4096
+//scene objects placed before the first frame, the rest are placed a few thousand a frame after it
+#define SCENE_STARTUP_INSTANCES 1024
+#define SCENE_INSTANCES_PER_FRAME 4096
+//headless runs draw into this many offscreen images in turn, like a swapchain with one more image than frames in flight
+#define HEADLESS_IMAGE_COUNT 3
+//headless runs animate as if every frame took 1/60 of a second, so the same frame always looks the same
+#define HEADLESS_FRAMES_PER_SECOND 60.0f
+//frames that can be copied back and waiting to be written at once, the renderer only stalls when the encoders fall this far behind
+#define READBACK_RING_SIZE 8
+//most views one multiview pass draws, multiview.vert has arrays this big
+#define MULTIVIEW_MAX_VIEWS 4
 
 #include <glm/gtx/hash.hpp>
 #include <GLFW/glfw3.h>
@@ -26,6 +65,20 @@
 #include <fstream>
 #include <array>
 #include <unordered_map>
+#include <map>
+#include <tuple>
+#include <future>
+#include <mutex>
+
+#include "ThreadPool.h"
+#include "TextureCompression.h"
+#include "KtxTexture.h"
+#include "ContentHash.h"
+#include "MeshProcessing.h"
+#include "SceneFile.h"
+#include "SoftwareRasterizer.h"
+#include "Bvh.h"
+#include "SpatialGrid.h"
 
 
 class VulkanRenderer {
@@ -33,6 +86,53 @@ public:
 	void run();
 	bool framebufferResized = false;
 
+	//replaces the built in scene with a .scene file, has to be called before run
+	void loadSceneFile(const std::string& scenePath);
+	//close as soon as every object of the scene has been drawn and print how long that took, for --bench-scene
+	bool benchmarkScene = false;
+
+	/* renders into offscreen images instead of a window, without glfw, a surface or a swapchain, so it runs on any vulkan device
+		including software ones like lavapipe and swiftshader. set before run, which returns after headlessFrames frames*/
+	bool headless = false;
+	uint64_t headlessFrames = 1;
+
+	/* every frame is copied back and written to captureDirectory/frame_000001.png etc by the worker threads, empty means off.
+		captureRaw writes the rgba8 pixels as they are to .rgba files instead, which is far quicker than png. set before run*/
+	std::string captureDirectory;
+	bool captureRaw = false;
+
+	/* instead of files, every frame goes out as raw pixels to streamPath, "-" being stdout, for a local encoder like ffmpeg to read.
+		they are written in order straight out of the readback ring, one frame per write*/
+	std::string streamPath;
+	//when captures or the stream fall a whole ring behind, leave frames out instead of holding up rendering until they catch up
+	bool dropFramesWhenBehind = false;
+
+	/* batch mode, one headless frame per camera pose with the scene loaded once and everything still, "-" reads stdin.
+		one pose a line, # starts a comment: <eye x y z> <target x y z> [fov in degrees [up x y z]]*/
+	void loadCameraPoses(const std::string& posesPath);
+
+	/* views drawn by one pass with VK_KHR_multiview, each into its own layer of the headless images, so only headless.
+		a batch gives each frame the next viewCount poses, otherwise the views are the camera moved sideways viewSeparation apart*/
+	uint32_t viewCount = 1;
+	float viewSeparation = 0.065f;
+
+	/* draws the headless frames on the cpu with SoftwareRasterizer instead, for machines with no gpu at all. the scene, camera,
+		animation and captures are the same as a headless vulkan run and both print their time a frame, so they can be compared on lavapipe*/
+	bool software = false;
+
+	/* build the mip chain on the worker threads and upload it in one copy. off, the gpu makes the mips of uncompressed textures
+		with mipgen.comp, or the blit chain when that cannot be used. set before run*/
+	bool useCpuMipmaps = true;
+
+	/* closest object along each ray in world space, traced against the meshes' bvhs where updateModels last placed the models.
+		hit.instance is the model's place in storage, the order the scene was loaded in. four rays go down the tree at once and the packets
+		are shared out over the worker threads, so neighbouring rays should be next to each other*/
+	std::vector<RayHit> castRays(const std::vector<Ray>& rays);
+	//prints the object under a point of the window in screen coordinates, a left click does this at the cursor
+	void pickAt(double cursorX, double cursorY);
+	//models whose bounds touch the sphere, numbered like hit.instance. found through the spatial grid, so it costs about what it finds
+	std::vector<uint32_t> modelsNear(glm::vec3 center, float radius);
+
 
 
 	struct Vertex {
@@ -69,6 +169,39 @@ public:
 		}
 	};
 
+	/* 12 bytes instead of 20. positions are 16 bit unorm across the mesh's bounds, w is only padding as 3 component
+		16 bit formats are not widely supported for vertex input. uvs are 16 bit unorm when they all lie in 0-1,
+		half floats when they tile. the shader reads both as floats, the bounds go into the model matrix*/
+	struct PackedVertex {
+		uint16_t pos[4];
+		uint16_t texCoord[2];
+
+		static VkVertexInputBindingDescription getBindingDescription() {
+			VkVertexInputBindingDescription bindingDescription = {};
+			bindingDescription.binding = 0;
+			bindingDescription.stride = sizeof(PackedVertex);
+			bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+			return bindingDescription;
+		}
+
+		static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions(VkFormat texCoordFormat) {
+			std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions = {};
+
+			attributeDescriptions[0].binding = 0;
+			attributeDescriptions[0].location = 0;
+			attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+			attributeDescriptions[0].offset = offsetof(PackedVertex, pos);
+
+			attributeDescriptions[1].binding = 0;
+			attributeDescriptions[1].location = 1;
+			attributeDescriptions[1].format = texCoordFormat;
+			attributeDescriptions[1].offset = offsetof(PackedVertex, texCoord);
+
+			return attributeDescriptions;
+		}
+	};
+
 
 
 private:
@@ -87,18 +220,97 @@ private:
 	};
 
 
-	struct Model {
+	//which vertex struct and uv format a mesh's buffer holds, there is a pipeline for each
+	enum class VertexLayout {
+		Float,
+		QuantizedUnormUv,
+		QuantizedHalfUv
+	};
+	static const uint32_t VERTEX_LAYOUT_COUNT = 3;
+
+	struct MeshLod {
+		//each range is its own draw
+		std::vector<IndexRange> indexRanges;
+		//furthest the surface moved from the full mesh, in model space
+		float error;
+	};
+
+	//gpu buffers for one obj, shared by every model placed from it
+	struct Mesh {
 		VkBuffer indexBuffer;
 		VkDeviceMemory indexBufferMemory;
 
 		VkBuffer vertexBuffer;
 		VkDeviceMemory vertexBufferMemory;
 
-		constantBufferMVP mvp;
 		uint32_t indiciesCount;
-	
-		Transform transform;
-		uint32_t texture_index;
+		//16 bit unless the mesh has too many vertices and was not split
+		VkIndexType indexType;
+		//lods[0] is the full mesh, all of them share the vertex buffer
+		std::vector<MeshLod> lods;
+		glm::vec3 boundsCenter;
+		float boundsRadius;
+		//of lods[0], empty for small meshes. meshletOffset is where they start in meshletBuffer
+		std::vector<Meshlet> meshlets;
+		uint32_t meshletOffset;
+		//triangles of lods[0] in model space before quantization, null when the import did not build one
+		std::shared_ptr<const MeshBvh> bvh;
+
+		VertexLayout layout;
+		//takes the unorm positions back to model space, identity for the float layout
+		glm::mat4 dequantize;
+
+		uint64_t contentHash;
+		uint32_t references;
+	};
+
+	//names a model for as long as it is in the scene, a removed model's handle is caught by its generation
+	struct ModelHandle {
+		uint32_t slot;
+		uint32_t generation;
+	};
+
+	/* every model in the scene as parallel arrays, one entry per model packed together in the order they were added,
+		with the last one moved into the gap when one is removed. each pass over the models only touches the arrays it needs.
+		handles go through slots, which keep pointing at the same model as it moves and are reused once it is gone.
+		models can be attached to another, whose transform and spin they then follow*/
+	struct ModelStorage {
+		//relative to the parent
+		std::vector<Transform> transforms;
+		//static models never spin, their rotation.x is an angle instead of a speed
+		std::vector<uint8_t> isStatic;
+		std::vector<Mesh*> meshes;
+		std::vector<uint32_t> textureIndices;
+		//what is pushed for the draws, updateModels writes it for the models in view
+		std::vector<constantBufferMVP> mvps;
+		//level of the mesh's lods picked for this frame by updateModels
+		std::vector<uint32_t> lods;
+		//where cull.comp writes each model's draws in drawCommandBuffers, ~0u when it has none
+		std::vector<uint32_t> drawCommandOffsets;
+		//its bounds in spatialGrid, whose values are slots
+		std::vector<uint32_t> spatialHandles;
+		//what it was loaded from, for reports
+		std::vector<std::string> names;
+
+		//the hierarchy is linked through slots, ~0u where there is no parent, child or next sibling
+		std::vector<uint32_t> parents;
+		std::vector<uint32_t> firstChildren;
+		std::vector<uint32_t> nextSiblings;
+		//the world transform of the parent as it was last frame, identity for models with no parent
+		std::vector<glm::mat4> parentWorlds;
+		//set when the parentWorlds under a model are out of date, its slot is then in dirtyModels
+		std::vector<uint8_t> dirty;
+		std::vector<uint32_t> dirtyModels;
+		//slots of the spinning models with children, their subtrees are brought up to date every frame
+		std::vector<uint32_t> animatedParents;
+
+		std::vector<uint32_t> slots;
+		//the other way, ~0u for a free slot
+		std::vector<uint32_t> slotIndices;
+		std::vector<uint32_t> slotGenerations;
+		std::vector<uint32_t> freeSlots;
+
+		size_t size() const { return transforms.size(); }
 	};
 
 	struct Texture {
@@ -108,6 +320,160 @@ private:
 
 		uint32_t height;
 		uint32_t width;
+		uint32_t mipLevels;
+		VkFormat format;
+		//the highest resolution level that has been uploaded, the image view starts here
+		uint32_t residentMip;
+
+		//where it is reloaded from after being evicted, while evicted imageView is the placeholder's
+		std::string sourcePath;
+		VkDeviceSize memorySize;
+		uint64_t lastUsedFrame;
+		bool resident;
+
+		uint64_t contentHash;
+		uint32_t references;
+	};
+
+	//cpu side results of parsing, these do not need a device so they are produced on worker threads
+	//what parseModel does to a mesh after reading it
+	struct MeshImportOptions {
+		//reorder triangles and vertices for the vertex cache and overdraw
+		bool optimize = true;
+		//upload as PackedVertex where the uvs allow it
+		bool quantize = true;
+		//cut meshes with more vertices than 16 bit indices reach into ranges that each fit, instead of using 32 bit indices
+		bool split = true;
+		//simplified levels drawn for instances that are small on screen
+		bool generateLods = true;
+		//split the full detail level of large meshes into meshlets that can be culled on their own
+		bool buildMeshlets = true;
+		//a bvh over the full detail triangles for picking and other ray queries
+		bool buildBvh = true;
+	};
+
+	//cull.comp's Meshlet, std430
+	struct GpuMeshlet {
+		glm::vec4 sphere;
+		glm::vec4 cone;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		int32_t vertexOffset;
+		uint32_t padding;
+	};
+
+	//cull.comp's push constants, in the model space of the mesh
+	struct CullParams {
+		glm::vec4 planes[6];
+		glm::vec4 eye;
+		uint32_t meshletOffset;
+		uint32_t meshletCount;
+		uint32_t commandOffset;
+		uint32_t padding;
+	};
+
+	struct MeshData {
+		std::vector<Vertex> verticies;
+		std::vector<uint32_t> indicies;
+		//post transform cache behaviour of the obj's own order and of the order it is drawn in
+		VertexCacheStats cacheStatsBefore;
+		VertexCacheStats cacheStatsAfter;
+
+		//every lod's indices follow the one before in indicies, they count from the firstVertex of their range
+		//and are narrowed to 16 bits when they are uploaded
+		VkIndexType indexType;
+		std::vector<MeshLod> lods;
+		//in the model space of the obj, before any quantization
+		glm::vec3 boundsCenter;
+		float boundsRadius;
+		std::vector<Meshlet> meshlets;
+		std::shared_ptr<const MeshBvh> bvh;
+
+		//filled in instead of being uploaded from verticies when the layout is quantized
+		VertexLayout layout;
+		std::vector<PackedVertex> packedVerticies;
+		glm::mat4 dequantize;
+		//largest distance any quantized position or uv ended up from the original, and what rounding allows
+		float positionError;
+		float positionErrorBound;
+		float texCoordError;
+		float texCoordErrorBound;
+	};
+
+	/* pixels is null once the mips have been built on the cpu or read from a .dds, everything is in mipChain then.
+		ktx2 files are only mapped, their levels are read from the mapping while they are copied into the staging ring*/
+	struct ImageData {
+		unsigned char* pixels;
+		int width;
+		int height;
+		MipChain mipChain;
+		std::unique_ptr<KtxTexture> ktx;
+		VkFormat format;
+	};
+
+	struct StagingRing {
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		unsigned char* mapped;
+		VkDeviceSize size;
+		VkDeviceSize head;
+	};
+
+	/* the levels of a texture that are still to come. source keeps the file mapping or mip chain alive,
+		data and levels point into it. nextRow is how many block rows of the level above residentMip are in*/
+	struct TextureStream {
+		Texture* texture;
+		ImageData source;
+		const unsigned char* data;
+		std::vector<MipLevel> levels;
+		uint32_t nextRow;
+	};
+
+	/* a host visible copy of one frame. copying is set while the gpu may still be writing it,
+		which is over once the fence of frameInFlight has been waited on. the slot is free again once encoding is done*/
+	struct ReadbackSlot {
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		unsigned char* mapped;
+		uint64_t frame;
+		size_t frameInFlight;
+		bool copying;
+		std::future<void> encoding;
+	};
+
+	//an image view, and for an evicted texture its image and memory, kept until no descriptor set points at the view
+	struct RetiredImage {
+		VkImageView view;
+		VkImage image;
+		VkDeviceMemory memory;
+	};
+
+	//where updateModels looks from
+	struct Camera {
+		glm::vec3 eye;
+		glm::vec3 target;
+		glm::vec3 up;
+		//vertical, in degrees
+		float fieldOfView;
+	};
+
+	//what multiview.vert indexes by gl_ViewIndex, one per swap chain image
+	struct ViewUniforms {
+		glm::mat4 view[MULTIVIEW_MAX_VIEWS];
+		glm::mat4 proj[MULTIVIEW_MAX_VIEWS];
+	};
+
+	//static objects never move, so they can be merged with others that share their texture when the scene is loaded
+	struct SceneObject {
+		std::string modelPath;
+		std::string texturePath;
+		//relative to the parent when there is one
+		Transform transform;
+		bool isStatic = false;
+		//place of an earlier object in sceneObjects it is attached to
+		uint32_t parent = SCENE_NO_PARENT;
+		//objects in a hierarchy are never merged into static batches, their parts have to stay apart to move together
+		bool hasChildren = false;
 	};
 
 
@@ -162,6 +528,7 @@ private:
 	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 	void createSwapChain();
+	void createHeadlessImages();
 	void createImageViews();
 	void createGraphicsPipeline();
 	VkShaderModule createShaderModule(const std::vector<char>& code);
@@ -173,8 +540,8 @@ private:
 	void createSyncObjects();
 	void recreateSwapChain();
 	void cleanupSwapChain();
-	void createVertexBuffer(const std::vector<Vertex>& verticies, VkBuffer& vertexBuffer, VkDeviceMemory& vertexBufferMemory);
-	void createIndexBuffer(const std::vector<uint32_t>& indicies, VkBuffer& indexBuffer, VkDeviceMemory& indexBufferMemory);
+	void createVertexBuffer(const void* verticies, VkDeviceSize bufferSize, VkBuffer& vertexBuffer, VkDeviceMemory& vertexBufferMemory);
+	void createIndexBuffer(const std::vector<uint32_t>& indicies, VkIndexType indexType, VkBuffer& indexBuffer, VkDeviceMemory& indexBufferMemory);
 
 	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
@@ -182,34 +549,114 @@ private:
 	
 	void createDescriptorSetLayout();
 	void updateModels();
+	//static objects never spin, their rotation.x is an angle instead of a speed
+	static glm::mat4 transformMatrix(const Transform& transform, bool isStatic, float time);
 	void createDescriptorPool();
 	void createDescriptorSets();
 	Texture* loadTexture(std::string texturePath);
 	void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
-																	VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+																	VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, uint32_t arrayLayers = 1);
 	VkCommandBuffer beginSingleTimeCommands();
 	void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
+	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels, uint32_t baseMipLevel = 0);
 	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
 	void createTextureImageView(Texture* texture);
-	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
+	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, uint32_t baseMipLevel = 0, uint32_t layerCount = 1);
 	void createTextureSampler();
 	void createDepthResources();
 	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 	VkFormat findDepthFormat();
-	Model* loadModel(std::string modelPath);
+	ModelHandle addModel(Mesh* mesh, uint32_t textureIndex, const Transform& transform, bool isStatic, const std::string& name);
+	void removeModel(ModelHandle handle);
+	uint32_t modelIndex(ModelHandle handle) const;
 	void loadModels();
+	void loadStaticBatches();
+	void instantiateSceneObjects(size_t count);
+	bool isBatched(const SceneObject& sceneObject) const;
 	void generateMipmaps(VkImage image, VkFormat imageFormat ,int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+	void createMipGenPipeline();
+	void destroyMipGenPipeline();
+	bool canGenerateMipmapsCompute(VkFormat format, uint32_t mipLevels);
+	void generateMipmapsCompute(VkImage image, VkFormat format, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+	void recordComputeMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkDescriptorSet descriptorSet, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+	void createMeshletCulling();
+	void updateMeshletCulling();
+	void createMeshletBuffers();
+	void destroyMeshletBuffers();
+	void destroyMeshletCulling();
+	bool usesMeshletCulling(uint32_t model);
+	void recordMeshletCulling(int imageIndex);
+	void checkMultiview();
+	void runSoftware();
+	void createViewBuffers();
+	void createFrameReadback();
+	void openFrameStream(bool bgra);
+	void destroyFrameReadback();
+	void recordFrameReadback(int imageIndex);
+	void collectFrameReadback(size_t frameInFlight);
+	void finishFrameReadback();
 	VkSampleCountFlagBits getMaxUsableSampleCount();
 	void createColorResources();
 	void allocateCommandBuffers();
-	void setModelTransform(Model* model, Transform transform);
-	void setModelLocation(Model* model, glm::vec3 location);
-	void setModelRotation(Model* model, glm::vec3 rotation);
-	void setModelScale(Model* model, glm::vec3 scale);
-
-	void freeModel(Model* model);
-	void freeTexture(uint32_t index);
+	void setModelTransform(ModelHandle handle, Transform transform);
+	void setModelLocation(ModelHandle handle, glm::vec3 location);
+	void setModelRotation(ModelHandle handle, glm::vec3 rotation);
+	void setModelScale(ModelHandle handle, glm::vec3 scale);
+	//the model keeps its transform, which from then on is relative to the parent. no parent makes it a root again
+	void setModelParent(ModelHandle handle, std::optional<ModelHandle> parent);
+	void modelTransformChanged(uint32_t model);
+	void markModelDirty(uint32_t model);
+	void updateHierarchy(float time);
+	void updateModelBounds(uint32_t model);
+	void updateSceneBvh();
+
+	Mesh* acquireMesh(const std::string& modelPath);
+	Mesh* acquireMesh(uint64_t hash, const MeshData& meshData, const std::string& name);
+	void releaseMesh(Mesh* mesh);
+	uint32_t acquireTexture(const std::string& texturePath);
+	void releaseTexture(uint32_t index);
+	uint64_t assetContentHash(const std::string& path);
+	bool claimAssetHash(const std::string& path, uint64_t hash);
+	std::string assetHashOwner(uint64_t hash);
+	void dropDecodedAsset(const std::string& path);
+
+	static MeshData parseModel(const std::string& modelPath, const MeshImportOptions& options, ThreadPool* pool = nullptr);
+	static void processMesh(MeshData& meshData, const MeshImportOptions& options, ThreadPool* pool = nullptr);
+	static void optimizeMesh(MeshData& meshData);
+	static void generateLods(MeshData& meshData, bool optimize);
+	static void splitMesh(MeshData& meshData);
+	static void quantizeMesh(MeshData& meshData);
+	void updateStatisticsQueryPool();
+	void reportVertexInvocations(uint32_t imageIndex);
+	static ImageData decodeTexture(const std::string& texturePath);
+	ImageData prepareImage(const std::string& texturePath, bool checkDeviceSupport = false);
+	static VkFormat blockFormatToVulkan(BlockFormat format);
+	bool isSampledFormatSupported(VkFormat format);
+	void uploadTexture(Texture* texture, ImageData imageData);
+	void uploadLevels(Texture* texture, const unsigned char* data, const std::vector<MipLevel>& levels, VkFormat format, uint32_t firstLevel = 0);
+	static void texelBlockInfo(VkFormat format, uint32_t& blockDimension, uint32_t& blockBytes);
+	void createStagingRing(StagingRing& ring, VkDeviceSize size);
+	void destroyStagingRing(StagingRing& ring);
+	static uint32_t allocateStagingRows(StagingRing& ring, VkDeviceSize rowPitch, uint32_t rowsWanted, VkDeviceSize& offset);
+	static uint32_t firstResidentLevel(const std::vector<MipLevel>& levels);
+	void recordTextureStreaming(VkCommandBuffer commandBuffer);
+	bool streamNextLevel(VkCommandBuffer commandBuffer, StagingRing& staging, TextureStream& stream);
+	void updateTextureDescriptors(uint32_t imageIndex);
+	void destroyRetiredImages();
+	void flushStagingCopies(VkImage image, std::vector<VkBufferImageCopy>& regions);
+	void createPlaceholderTexture();
+	void updateTextureResidency();
+	void queryTextureBudget(VkDeviceSize& budget, VkDeviceSize& usage);
+	void evictTexture(Texture* texture);
+	void requestTextureReload(Texture* texture);
+	static bool isInstanceExtensionAvailable(const char* name);
+	bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char* name);
+	void startAssetDecoding();
+	MeshData takeDecodedMesh(const std::string& modelPath);
+	ImageData takeDecodedImage(const std::string& texturePath);
+	void recordAssetTiming(const std::string& name, double milliseconds);
+	void markStartupPhase(const std::string& name);
+	void printStartupReport();
 
 
 	VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, 
@@ -253,10 +700,12 @@ private:
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
 	std::vector<VkImageView> swapChainImageViews;
+	//headless runs own their images, a swapchain's belong to it
+	std::vector<VkDeviceMemory> headlessImagesMemory;
 
 	VkRenderPass renderPass;
 	VkPipelineLayout pipelineLayout;
-	VkPipeline graphicsPipeline;
+	std::array<VkPipeline, VERTEX_LAYOUT_COUNT> graphicsPipelines;
 	VkCommandPool commandPool;
 
 	std::vector<VkSemaphore> imageAvailableSemaphores;
@@ -265,8 +714,28 @@ private:
 	std::vector<VkFence> imagesInFlight;
 	size_t currentFrame = 0;
 
+	//the ViewUniforms of each swap chain image when multiview is on, kept mapped
 	std::vector<VkBuffer> uniformBuffers;
 	std::vector<VkDeviceMemory> uniformBuffersMemory;
+	std::vector<void*> uniformBuffersMapped;
+	ViewUniforms viewUniforms = {};
+
+	/* every model's bounds, kept up to date as they are added and moved. spinning models are bounded for the whole turn
+		so only a new transform, theirs or a parent's, moves them, and updateModels finds what is in view without going through the rest*/
+	SpatialGrid spatialGrid;
+	//places in models of the ones updateModels found in view, in order. only these are updated and drawn
+	std::vector<uint32_t> visibleModels;
+	/* the subtrees updateHierarchy goes through this frame one after another, each in breadth first order so every model comes
+		after its parent. hierarchyStarts has where each begins and one more for the end*/
+	std::vector<uint32_t> hierarchyOrder;
+	std::vector<size_t> hierarchyStarts;
+	//the animation time of the last frame
+	float modelTime = 0.0f;
+
+	//every model as it was in the last frame, in the order they are stored. only brought up to date when rays are cast
+	SceneBvh sceneBvh;
+	std::vector<BvhInstance> bvhInstances;
+	uint64_t sceneBvhFrame = ~0ull;
 
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkDescriptorPool descriptorPool;
@@ -275,9 +744,87 @@ private:
 	std::vector<VkCommandBuffer> commandBuffers;
 	std::vector<VkDescriptorSet> descriptorSets;
 
-	uint32_t mipLevels;
-
 	VkSampler textureSampler;
+	StagingRing stagingRing;
+
+	//one per frame in flight, only reused once the fence for that frame has been waited on
+	bool useTextureStreaming = true;
+	std::vector<StagingRing> streamingStaging;
+	std::vector<TextureStream> textureStreams;
+	//the views each descriptor set was last written with, and old views that some set may still point at
+	std::vector<std::array<VkImageView, TEXTURES_USED>> descriptorSetViews;
+	std::vector<RetiredImage> retiredImages;
+
+	/* textures that have not been drawn for a while are evicted when the heap is over budget and reloaded from their
+		source path when they are next drawn. textureMemoryBudget overrides the budget, 0 means work it out from the device*/
+	uint64_t frameNumber = 0;
+	Texture* placeholderTexture = nullptr;
+	VkDeviceSize textureMemoryBudget = 0;
+	bool getPhysicalDeviceProperties2Enabled = false;
+	bool memoryBudgetSupported = false;
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR getPhysicalDeviceMemoryProperties2 = nullptr;
+	uint32_t textureHeapIndex = 0;
+	std::unordered_map<Texture*, std::future<ImageData>> pendingReloads;
+
+	MipFilter cpuMipFilter = MipFilter::Kaiser;
+
+	/* mips the cpu does not build are made by mipgen.comp in one dispatch when the format can be a storage image,
+		the blit chain is only used when it cannot or the shader has not been compiled*/
+	bool useComputeMipmaps = true;
+	VkDescriptorSetLayout mipGenSetLayout;
+	VkPipelineLayout mipGenPipelineLayout;
+	VkPipeline mipGenPipeline = VK_NULL_HANDLE;
+	VkDescriptorPool mipGenDescriptorPool;
+	VkBuffer mipGenCounterBuffer;
+	VkDeviceMemory mipGenCounterMemory;
+
+	MeshImportOptions meshImport;
+	//merge small static objects that share a texture into one model per cell when the scene is loaded
+	bool useStaticBatching = true;
+
+	/* full detail draws of meshes with meshlets go through cull.comp, which writes an indirect draw per meshlet
+		with no instances for the ones outside the frustum or facing away. without multiDrawIndirect or shaders/cull.spv
+		every mesh is drawn directly*/
+	bool useMeshletCulling = true;
+	bool multiDrawIndirectSupported = false;
+	VkDescriptorSetLayout cullSetLayout;
+	VkPipelineLayout cullPipelineLayout;
+	VkPipeline cullPipeline = VK_NULL_HANDLE;
+	VkDescriptorPool cullDescriptorPool;
+	std::vector<VkDescriptorSet> cullDescriptorSets;
+	uint32_t maxDrawIndirectCount = 0;
+	//every mesh's meshlets back to back, meshletCount of the meshletCapacity are in use
+	VkBuffer meshletBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory meshletBufferMemory;
+	uint32_t meshletCount = 0;
+	uint32_t meshletCapacity = 0;
+	//one per swap chain image, filled and drawn from by its command buffer
+	std::vector<VkBuffer> drawCommandBuffers;
+	std::vector<VkDeviceMemory> drawCommandBufferMemory;
+	uint32_t drawCommandCapacity = 0;
+	//set when models are placed or removed, updateMeshletCulling then hands out drawCommandOffsets again
+	bool meshletCullingOutOfDate = false;
+
+	/* vertex shader invocations of every draw, one query per model slot per swap chain image.
+		only there when the device has pipelineStatisticsQuery, printed once for the first frame that comes back*/
+	bool pipelineStatisticsSupported = false;
+	VkQueryPool statisticsQueryPool = VK_NULL_HANDLE;
+	uint32_t statisticsSlotCount = 0;
+	//the models each image's last frame drew, only their queries were written
+	std::vector<std::vector<ModelHandle>> statisticsQueried;
+	bool vertexInvocationsReported = false;
+
+	//ring the frames are copied back through when captureDirectory is set
+	std::vector<ReadbackSlot> readbackSlots;
+	size_t nextReadbackSlot = 0;
+	uint64_t droppedFrames = 0;
+	//a pool of one keeps the stream's frames in order
+	FILE* streamFile = nullptr;
+	std::unique_ptr<ThreadPool> streamWriter;
+
+	//use textures/name.bc7.dds etc when --compress-textures has made them, textureCompressionBC is what the device allows
+	bool useCompressedTextures = true;
+	bool textureCompressionBC = false;
 
 	VkImage depthImage;
 	VkDeviceMemory depthImageMemory;
@@ -288,9 +835,49 @@ private:
 	VkDeviceMemory colorImageMemory;
 	VkImageView colorImageView;
 
-	std::vector<Model*> modelsArray;
-	Texture* textureArray[TEXTURES_USED];
+	ModelStorage models;
+	Texture* textureArray[TEXTURES_USED] = {};
+
+	//what loadModels puts in the scene, the paths are also used to start decoding early
+	std::vector<SceneObject> sceneObjects = {
+		{ "models/tire.obj", "textures/Tire_Red_Color.png", { glm::vec3(2.5f,0.0f,0.0f), glm::vec3(60.0f,0.0f,0.0f), glm::vec3(0.05f,0.05f,0.05f) } },
+		{ "models/crypto.obj", "textures/crypto.png", { glm::vec3(0.0f,0.0f,0.0f), glm::vec3(60.0f,0.0f,0.0f), glm::vec3(0.04f,0.04f,0.04f) } },
+		{ "models/earth.obj", "textures/earth_night.png", { glm::vec3(-2.5f,0.0f,0.0f), glm::vec3(60.0f,0.0f,0.0f), glm::vec3(0.2f,0.2f,0.2f) } },
+	};
+
+	//batch runs draw frame n from cameraPoses[n - 1]
+	Camera camera = { glm::vec3(0.0f, 7.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), 45.0f };
+	std::vector<Camera> cameraPoses;
+
+	//how far loadModels and the frames after it have got through sceneObjects
+	size_t nextSceneObject = 0;
+	//the model each placed object became, for attaching the objects after it
+	std::vector<ModelHandle> sceneObjectModels;
+	bool sceneInstantiated = false;
+	double sceneFileMilliseconds = 0.0;
+
+	//startup task graph, decoding runs on the pool while the main thread sets up vulkan
+	std::unordered_map<std::string, std::future<MeshData>> pendingMeshes;
+	std::unordered_map<std::string, std::future<ImageData>> pendingImages;
+
+	/* assets on the gpu keyed by a hash of their file, so the same file under two paths is only decoded and uploaded once.
+		the workers hash each file before decoding it, only the first path seen with a hash is decoded*/
+	std::unordered_map<uint64_t, Mesh*> meshCache;
+	std::unordered_map<uint64_t, Texture*> textureCache;
+	std::unordered_map<std::string, uint64_t> assetPathHashes;
+	std::unordered_map<uint64_t, std::string> assetHashOwners;
+	std::mutex assetHashesMutex;
+
+	std::chrono::high_resolution_clock::time_point startupStart;
+	std::chrono::high_resolution_clock::time_point lastStartupMark;
+	std::vector<std::pair<std::string, double>> startupPhases;
+	std::vector<std::pair<std::string, double>> assetTimings;
+	std::mutex assetTimingsMutex;
+	bool firstFrameReported = false;
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+
+	//declared last so the workers are joined before anything they write to is destroyed
+	ThreadPool workerPool;
 };
 
 
@@ -1,13 +1,172 @@
 #include "VulkanRenderer.h"
+#include "TextureCompression.h"
 //#include "DX11.h"
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
+#include <chrono>
+
+/* offline step, Simple_Graphics --compress-textures <bc1|bc3|bc7|all> <texture>...
+	writes name.bc7.dds etc next to each texture, loadTexture uses those over the png when the device can*/
+static int compressTextures(int argc, char* argv[]) {
+	if (argc < 4) {
+		std::cerr << "usage: " << argv[0] << " --compress-textures <bc1|bc3|bc7|all> <texture>..." << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::string formatName = argv[2];
+	std::vector<BlockFormat> formats;
+
+	if (formatName == "bc1" || formatName == "all") {
+		formats.push_back(BlockFormat::BC1);
+	}
+	if (formatName == "bc3" || formatName == "all") {
+		formats.push_back(BlockFormat::BC3);
+	}
+	if (formatName == "bc7" || formatName == "all") {
+		formats.push_back(BlockFormat::BC7);
+	}
+
+	if (formats.empty()) {
+		std::cerr << "unknown block format " << formatName << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	//the blocks of each level are spread over every core
+	ThreadPool pool;
+
+	for (int i = 3; i < argc; i++) {
+		for (BlockFormat format : formats) {
+			auto start = std::chrono::high_resolution_clock::now();
+			compressTextureFile(argv[i], format, MipFilter::Kaiser, pool);
+			auto end = std::chrono::high_resolution_clock::now();
+
+			std::cout << compressedTexturePath(argv[i], format) << " "
+				<< std::chrono::duration<double, std::milli>(end - start).count() << "ms" << std::endl;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/* offline step, Simple_Graphics --generate-scene <file> <count> [--binary] [--static]
+	writes a grid of count instances of the stock models, for trying out big scenes with --scene and --bench-scene*/
+static int generateScene(int argc, char* argv[]) {
+	if (argc < 4) {
+		std::cerr << "usage: " << argv[0] << " --generate-scene <file> <count> [--binary] [--static]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	bool binary = false;
+	bool isStatic = false;
+
+	for (int i = 4; i < argc; i++) {
+		std::string option = argv[i];
+
+		if (option == "--binary") {
+			binary = true;
+		}
+		else if (option == "--static") {
+			isStatic = true;
+		}
+		else {
+			std::cerr << "unknown option " << option << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	SceneDescription scene = generateGridScene({ "models/tire.obj", "models/crypto.obj", "models/earth.obj" },
+		{ "textures/Tire_Red_Color.png", "textures/crypto.png", "textures/earth_night.png" },
+		static_cast<uint32_t>(std::stoul(argv[3])), isStatic);
+
+	if (binary) {
+		writeSceneBinary(argv[2], scene);
+	}
+	else {
+		writeSceneText(argv[2], scene);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc > 1 && std::string(argv[1]) == "--compress-textures") {
+		try {
+			return compressTextures(argc, argv);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc > 1 && std::string(argv[1]) == "--generate-scene") {
+		try {
+			return generateScene(argc, argv);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
 
-int main() {
 	VulkanRenderer app;
 	//D3DRenderer app;
 	try {
+		/* --scene <file> draws that instead of the built in scene, --bench-scene <file> also closes once all of it is on screen.
+			--headless <frames> draws that many frames offscreen without opening a window.
+			--capture <dir> writes every frame to dir as a png, --capture-raw <dir> as raw rgba8.
+			--views <file> draws one headless frame per camera pose in the file, - reads them from stdin.
+			--multiview <n> draws n views in each headless frame with one pass.
+			--stream <pipe> writes raw frames to a named pipe, - is stdout, --drop-frames leaves frames out when that falls behind.
+			--software draws the headless frames on the cpu instead of with vulkan.
+			--gpu-mipmaps makes the mips of uncompressed textures on the gpu instead of the worker threads*/
+		for (int i = 1; i < argc; i++) {
+			std::string option = argv[i];
+
+			if (option == "--drop-frames") {
+				app.dropFramesWhenBehind = true;
+				continue;
+			}
+			if (option == "--software") {
+				app.software = true;
+				continue;
+			}
+			if (option == "--gpu-mipmaps") {
+				app.useCpuMipmaps = false;
+				continue;
+			}
+
+			if (i + 1 >= argc) {
+				throw std::runtime_error(option + " needs a value!");
+			}
+
+			if (option == "--scene" || option == "--bench-scene") {
+				app.loadSceneFile(argv[++i]);
+				app.benchmarkScene = option == "--bench-scene";
+			}
+			else if (option == "--headless") {
+				app.headless = true;
+				app.headlessFrames = std::stoull(argv[++i]);
+			}
+			else if (option == "--multiview") {
+				app.viewCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+			}
+			else if (option == "--views") {
+				app.loadCameraPoses(argv[++i]);
+			}
+			else if (option == "--stream") {
+				app.streamPath = argv[++i];
+			}
+			else if (option == "--capture" || option == "--capture-raw") {
+				app.captureDirectory = argv[++i];
+				app.captureRaw = option == "--capture-raw";
+			}
+			else {
+				throw std::runtime_error("unknown option " + option + "!");
+			}
+		}
+
 		app.run();
 	}
 	catch (const std::exception& e) {
@@ -0,0 +1,26 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_multiview : enable
+
+//one view and projection for each view of the pass, MULTIVIEW_MAX_VIEWS long
+layout(binding = 1) uniform Views {
+    mat4 view[4];
+    mat4 proj[4];
+} views;
+
+//view and proj are left in so the fragment shader's push constant stays where it is, they are not used
+layout(push_constant) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inTexCoord;
+
+layout(location = 0) out vec2 fragTexCoord;
+
+void main() {
+    gl_Position = views.proj[gl_ViewIndex] * views.view[gl_ViewIndex] * ubo.model * vec4(inPosition, 1.0);
+    fragTexCoord = inTexCoord;
+}